@@ -13,7 +13,9 @@ STATIC const float		 GameClient::WORLD_HEIGHT = 18.0f;
 STATIC const float		 GameClient::IT_PLAYER_SPEED_MULTIPLIER = 1.1f;
 STATIC const float		 GameClient::MAX_SECONDS_BETWEEN_PACKET_SENDS = 1.f;
 STATIC const float		 GameClient::OBJECT_CONTACT_DISTANCE = 10.f;
-STATIC const float		 GameClient::SECONDS_TO_WAIT_BEFORE_RESENDS = 1.f;
+STATIC const float		 GameClient::SECONDS_BETWEEN_TIME_SYNCS = 1.f;
+STATIC const float		 GameClient::SECONDS_BETWEEN_TIME_SYNCS_UNTIL_SYNCHRONIZED = 0.1f;
+STATIC const float		 GameClient::SECONDS_BETWEEN_NETWORK_REPORTS = 5.f;
 
 
 #pragma region Input Functions
@@ -111,52 +113,135 @@ float GameClient::TransformKeyInputIntoAngle( bool upKeyIsPressed, bool rightKey
 
 #pragma region Game Helper Functions
 //-----------------------------------------------------------------------------------------------
-void GameClient::AcknowledgePacket(  const MainPacketType& packet )
+//Nothing is sent here; the packet is acknowledged in the header of whatever goes to the server next.
+//Called as packets arrive, so time in the jitter buffer doesn't hold up acknowledgements and cause resends.
+void GameClient::AcknowledgePacket( const MainPacketType& packet )
 {
-	MainPacketType ackPacket;
-	ackPacket.type = TYPE_Ack;
+	m_receivedPackets.RecordReceivedPacket( packet.number );
+}
 
-	if( m_localEntity != nullptr )
-		ackPacket.clientID = m_localEntity->GetID();
-	else
-		ackPacket.clientID = 0;
-	ackPacket.number = 0;
-	ackPacket.timestamp = packet.timestamp;
+//-----------------------------------------------------------------------------------------------
+//Plays out one part of a snapshot: the players in its deltas take on their state in the whole snapshot.
+//A snapshot that never finished arriving isn't in the history, and its parts are dropped.
+void GameClient::ApplyRoomSnapshotPart( const MainPacketType& snapshotHeader, const RoomSnapshotPacket& snapshot )
+{
+	const RoomState* roomState = m_snapshotHistory.Find( snapshot.sequence );
+	if( roomState == nullptr )
+		return;
 
-	ackPacket.data.acknowledged.type = packet.type;
-	ackPacket.data.acknowledged.number = packet.number;
-	SendPacketToServer( ackPacket );
+	UpdateEntitiesFromSnapshot( *roomState, snapshot, snapshotHeader.timestamp );
 }
 
 //-----------------------------------------------------------------------------------------------
-void GameClient::ClearResendingPacket()
+//Builds the room's state from the snapshot's baseline plus the parts' deltas as they arrive. Once every part
+//	is in, the state is kept and acknowledged, so the server can send deltas against it.
+void GameClient::AssembleRoomSnapshotPart( const MainPacketType& snapshotHeader, const RoomSnapshotPacket& snapshot )
 {
-	delete m_packetToResend;
-	m_packetToResend = nullptr;
+	if( snapshot.sequence != m_assembledSequence )
+	{
+		//Whatever was being assembled lost a part; a snapshot that never completes is never acknowledged
+		const RoomState* baseline = nullptr;
+		if( snapshot.baselineSequence != SNAPSHOT_None )
+		{
+			baseline = m_snapshotHistory.Find( snapshot.baselineSequence );
+			if( baseline == nullptr )
+			{
+				printf( "WARNING: Received room snapshot against a baseline we don't have!\n" );
+				m_assembledSequence = SNAPSHOT_None;
+				return;
+			}
+		}
+
+		m_assembledSequence = snapshot.sequence;
+		m_numberOfAssembledParts = 0;
+		m_assembledPartNumbers.clear();
+		if( baseline != nullptr )
+			m_assembledRoomState = *baseline;
+		else
+			m_assembledRoomState.clear();
+	}
+
+	for( unsigned int i = 0; i < snapshot.numberOfPlayers; ++i )
+	{
+		const PlayerStateDelta& playerDelta = snapshot.players[ i ];
+		if( playerDelta.changedFields == DELTA_None )
+			m_assembledRoomState.erase( playerDelta.id );
+		else
+			ApplyPlayerStateDelta( playerDelta, m_assembledRoomState[ playerDelta.id ] );
+	}
+
+	++m_numberOfAssembledParts;
+	m_assembledPartNumbers.push_back( snapshotHeader.number );
+	if( m_numberOfAssembledParts < snapshot.numberOfParts )
+		return;
+
+	//The server takes an acknowledged part to mean the whole snapshot arrived, so none are acknowledged until then
+	m_snapshotHistory.Store( m_assembledSequence, m_assembledRoomState );
+	for( unsigned int i = 0; i < m_assembledPartNumbers.size(); ++i )
+	{
+		m_receivedPackets.RecordReceivedPacket( m_assembledPartNumbers[ i ] );
+	}
+	m_assembledSequence = SNAPSHOT_None;
 }
 
 //-----------------------------------------------------------------------------------------------
-void GameClient::HandleIncomingPacket( const MainPacketType& packet )
+//Everything sent this frame goes to the server packed into as few datagrams as possible.
+void GameClient::FlushPacketsToServer()
 {
-	switch( packet.type )
+	for( unsigned int i = 0; i < m_outgoingMessages.GetNumberOfDatagrams(); ++i )
 	{
-	case TYPE_Ack:
+		m_outgoingMessages.GetDatagramSegments( i, m_datagramSegments );
+		int queueResult = m_outputSocket.QueueSegmentsForSend( &m_datagramSegments[ 0 ], static_cast< unsigned int >( m_datagramSegments.size() ), m_serverAddress, m_serverPort );
+		if( queueResult < 0 )
 		{
-			HandleServerAcknowledgement( packet );
-			ClearResendingPacket();
+			int errorCode = WSAGetLastError();
+			printf( "Unable to send packet to server at %s:%i. Error Code:%i.\n", m_serverAddress.c_str(), m_serverPort, errorCode );
+			exit( -6 );
 		}
-		break;
+	}
+
+	int flushResult = m_outputSocket.FlushSendQueue();
+	if( flushResult < 0 )
+	{
+		int errorCode = WSAGetLastError();
+		printf( "Unable to send packet to server at %s:%i. Error Code:%i.\n", m_serverAddress.c_str(), m_serverPort, errorCode );
+		exit( -6 );
+	}
+	m_outgoingMessages.Clear();
+}
+
+//-----------------------------------------------------------------------------------------------
+InputSequence GameClient::GetNextInputSequence()
+{
+	++m_lastInputSequence;
+	if( m_lastInputSequence == INPUT_None )
+		++m_lastInputSequence;
+	return m_lastInputSequence;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Our own clock until the first TimeSync reply comes back.
+double GameClient::GetServerTimeSeconds() const
+{
+	return m_serverClock.GetServerTimeSeconds( GetCurrentTimeSeconds() );
+}
+
+//-----------------------------------------------------------------------------------------------
+//snapshot is only filled in for TYPE_RoomSnapshot packets.
+void GameClient::HandleIncomingPacket( const MainPacketType& packet, const RoomSnapshotPacket& snapshot )
+{
+	switch( packet.type )
+	{
 	case TYPE_Nack:
 		{
 			HandleServerRefusal( packet );
-			ClearResendingPacket();
 		}
 		break;
-	case TYPE_GameUpdate:
+	case TYPE_RoomSnapshot:
 		if( m_currentState == STATE_InGame )
-			UpdateEntityFromPacket( packet );
+			ApplyRoomSnapshotPart( packet, snapshot );
 		else
-			printf( "WARNING: Received game update while not in-game!\n" );
+			printf( "WARNING: Received room snapshot while not in-game!\n" );
 		break;
 	case TYPE_LobbyUpdate:
 		if( m_currentState == STATE_InLobby )
@@ -165,12 +250,9 @@ void GameClient::HandleIncomingPacket( const MainPacketType& packet )
 	case TYPE_GameReset:
 		if( m_currentState == STATE_WaitingForGameStart || m_currentState == STATE_InGame )
 			ResetGame( packet );
-		ClearResendingPacket();
 		break;
 	case TYPE_Fire:
-		m_currentWorld->HandleFireEventFromPlayer( m_currentWorld->FindPlayerWithID( packet.data.gunfire.instigatorID ) );
-		if( packet.clientID == m_myClientID )
-			ClearResendingPacket();
+		m_currentWorld->HandleFireEventFromPlayer( m_currentWorld->FindPlayerWithID( packet.data.gunfire.instigatorID ), packet.data.gunfire.viewTimestamp );
 		break;
 	case TYPE_Hit:
 		{
@@ -202,56 +284,73 @@ void GameClient::HandleIncomingPacket( const MainPacketType& packet )
 }
 
 //-----------------------------------------------------------------------------------------------
+//Runs for every packet as it arrives, since any header from the server can acknowledge the packets we're resending.
+//	Each header covers the latest of ours the server received and the ACKNOWLEDGED_BITS before it.
 void GameClient::HandleServerAcknowledgement( const MainPacketType& packet )
 {
-	if( m_packetToResend == nullptr )
+	if( m_unacknowledgedPackets.GetNumberOfPackets() == 0 )
 		return;
 
-	if( ( packet.data.acknowledged.type != m_packetToResend->type ) ||
-		( packet.data.acknowledged.number != m_packetToResend->number ) )
+	double currentTimeSeconds = GetCurrentTimeSeconds();
+	for( PacketNumber i = 0; i <= ReceivedPacketWindow::ACKNOWLEDGED_BITS && i < packet.acknowledgedNumber; ++i )
 	{
-		//We aren't getting acknowledgment of what we are expecting
-		return;
-	}
+		PacketNumber acknowledgedNumber = packet.acknowledgedNumber - i;
+		if( !IsPacketAcknowledged( packet, acknowledgedNumber ) )
+			continue;
 
-	switch( m_packetToResend->type )
-	{
-	case TYPE_CreateRoom:
-	case TYPE_JoinRoom:
+		UnacknowledgedPacketBuffer::UnacknowledgedPacket* unackedPacket = m_unacknowledgedPackets.Find( acknowledgedNumber );
+		if( unackedPacket == nullptr )
+			continue;
+
+		//An ack for a resent packet could be for either copy, so only packets sent once are timed
+		if( unackedPacket->numberOfResends == 0 )
+			m_roundTripTime.AddSample( currentTimeSeconds - unackedPacket->sendTimeSeconds );
+
+		if( acknowledgedNumber == m_pendingRoomRequestNumber )
 		{
-			if( m_packetToResend->data.joining.room == ROOM_Lobby )
+			if( m_pendingRoomRequestRoom == ROOM_Lobby )
 				m_currentState = STATE_InLobby;
 			else
 				m_currentState = STATE_WaitingForGameStart;
+
+			//The new room's snapshots count from the start and have no baseline yet
+			m_snapshotHistory.Clear();
+			m_assembledSequence = SNAPSHOT_None;
 		}
-		ClearResendingPacket();
-		break;
-	default:
-		break;
+		RemoveUnacknowledgedPacket( acknowledgedNumber );
 	}
 }
 
 //-----------------------------------------------------------------------------------------------
 void GameClient::HandleServerRefusal( const MainPacketType& packet )
 {
-	if( m_packetToResend == nullptr )
-		return;
-	if( ( packet.data.acknowledged.type != m_packetToResend->type ) ||
-		( packet.data.acknowledged.number != m_packetToResend->number ) )
+	UnacknowledgedPacketBuffer::UnacknowledgedPacket* refusedPacket = m_unacknowledgedPackets.Find( packet.data.refused.number );
+	if( refusedPacket == nullptr || refusedPacket->header.type != packet.data.refused.type )
 	{
-		//We aren't getting acknowledgment of what we are expecting
+		//We aren't getting a refusal of anything we're waiting on
 		return;
 	}
 
-	switch( m_packetToResend->type )
-	{
-	case TYPE_CreateRoom:
-	case TYPE_JoinRoom:
+	if( packet.data.refused.number == m_pendingRoomRequestNumber )
 		m_currentState = STATE_InLobby;
-	default:
-		break;
+	RemoveUnacknowledgedPacket( packet.data.refused.number );
+}
+
+//-----------------------------------------------------------------------------------------------
+//One-way times need the server's clock, so until it's synchronized only the round trip is reported.
+void GameClient::PrintNetworkReport() const
+{
+	if( !m_serverClock.IsSynchronized() )
+	{
+		printf( "Network: %.0fms round trip, still synchronizing with the server's clock.\n", m_roundTripTime.GetSmoothedSeconds() * 1000.0 );
+		return;
 	}
-	ClearResendingPacket();
+
+	printf( "Network: %.0fms round trip (best %.0fms). Server clock %+.1fms from ours, drifting %.0f parts per million.\n",
+		m_roundTripTime.GetSmoothedSeconds() * 1000.0, m_serverClock.GetMinimumRoundTripSeconds() * 1000.0,
+		m_serverClock.GetOffsetSeconds( GetCurrentTimeSeconds() ) * 1000.0, m_serverClock.GetDriftRate() * 1000000.0 );
+	printf( "\t Snapshots arrive %.0fms after they're sent. Other players are drawn %.0fms behind the server.\n",
+		m_snapshotLatencySeconds * 1000.0, ( GetServerTimeSeconds() - m_renderTimestamp ) * 1000.0 );
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -265,7 +364,7 @@ void GameClient::ProcessNetworkQueue()
 	int numberOfBytesInNetworkQueue = m_outputSocket.GetNumberOfBytesInNetworkQueue();
 	while( numberOfBytesInNetworkQueue > 0 )
 	{
-		int receiveResult = m_outputSocket.ReceiveBuffer( ( char* )&receivedPacket, sizeof( MainPacketType ), receivedIPAddress, receivedPort );
+		int receiveResult = m_outputSocket.ReceiveBuffer( m_receivedDatagramBytes, Network::MAXIMUM_DATAGRAM_PAYLOAD_BYTES, receivedIPAddress, receivedPort );
 		if( receiveResult < 0 )
 		{
 			int errorCode = WSAGetLastError();
@@ -278,22 +377,57 @@ void GameClient::ProcessNetworkQueue()
 		else
 		{
 			//printf( "Received packet from %s:%i.\n", receivedIPAddress.c_str(), receivedPort );
-			m_packetQueue.insert( receivedPacket );
+			//The server packs several messages into each datagram
+			double arrivalTimeSeconds = GetCurrentTimeSeconds();
+			const char* message = nullptr;
+			unsigned int messageBytes = 0;
+			Network::IncomingMessageReader messageReader( m_receivedDatagramBytes, receiveResult );
+			while( messageReader.ReadNextMessage( message, messageBytes ) )
+			{
+				if( messageBytes > 0 && static_cast< unsigned char >( message[ 0 ] ) == TYPE_RoomSnapshot )
+				{
+					QueueRoomSnapshot( message, messageBytes, arrivalTimeSeconds );
+					continue;
+				}
+
+				if( !DeserializePacket( message, messageBytes, receivedPacket ) )
+				{
+					printf( "WARNING: Received malformed packet from server!\n" );
+					continue;
+				}
+
+				//Acknowledgements are handled on arrival, both ways; only what the packet carries waits to play out
+				HandleServerAcknowledgement( receivedPacket );
+				if( receivedPacket.IsGuaranteed() )
+					AcknowledgePacket( receivedPacket );
+
+				//Time spent in the jitter buffer would count as network delay, so TimeSync replies are timed now
+				if( receivedPacket.type == TYPE_TimeSync )
+				{
+					m_serverClock.AddSample( receivedPacket.data.timeSync.originTimestamp, receivedPacket.data.timeSync.receiveTimestamp, receivedPacket.timestamp, arrivalTimeSeconds );
+					continue;
+				}
+				m_jitterBuffer.Insert( receivedPacket, nullptr, arrivalTimeSeconds ); //Ack packets only add a transit sample
+			}
 		}
 
 		numberOfBytesInNetworkQueue = m_outputSocket.GetNumberOfBytesInNetworkQueue();
 	}
 }
 //-----------------------------------------------------------------------------------------------
+//Handles every packet whose playout time has come, in packet number order.
 void GameClient::ProcessPacketQueue()
 {
-	std::set< MainPacketType, FinalPacketComparer >::iterator packet;
-	for( packet = m_packetQueue.begin(); packet != m_packetQueue.end(); ++packet )
+	double currentTimeSeconds = GetCurrentTimeSeconds();
+	const JitterBuffer::BufferedPacket* bufferedPacket = m_jitterBuffer.PopNextDuePacket( currentTimeSeconds );
+	for( ; bufferedPacket != nullptr; bufferedPacket = m_jitterBuffer.PopNextDuePacket( currentTimeSeconds ) )
 	{
+		const MainPacketType* packet = &bufferedPacket->header;
+
 		//Check for badly timed packets
 		if( m_currentState == STATE_WaitingToJoinServer || m_currentState == STATE_InLobby )
 		{
-			if( packet->type != TYPE_Ack && packet->type != TYPE_LobbyUpdate )
+			if( packet->type != TYPE_Nack && packet->type != TYPE_LobbyUpdate )
 			{
 				printf( "WARNING: Received invalid packet from server while waiting for room entry!!\n" );
 				continue;
@@ -314,13 +448,12 @@ void GameClient::ProcessPacketQueue()
 		}
 
 
-		HandleIncomingPacket( *packet );
+		HandleIncomingPacket( *packet, bufferedPacket->snapshot );
 		
 
-		//Acknowledge and update packet numbers
+		//Update packet numbers; the packet was acknowledged when it arrived
 		if( packet->IsGuaranteed() )
 		{
-			AcknowledgePacket( *packet );
 			m_lastReceivedPacketNumber = packet->number;
 
 			if( m_lastReceivedGuaranteedPacketNumber > m_lastReceivedPacketNumber )
@@ -331,7 +464,101 @@ void GameClient::ProcessPacketQueue()
 			m_lastReceivedPacketNumber = packet->number;
 		}
 	}
-	m_packetQueue.clear();
+}
+
+//-----------------------------------------------------------------------------------------------
+//Snapshots are assembled and acknowledged as their parts arrive. Each part then waits in the jitter buffer
+//	for its turn to update the players in it.
+void GameClient::QueueRoomSnapshot( const char* message, unsigned int messageBytes, double arrivalTimeSeconds )
+{
+	MainPacketType snapshotHeader;
+	RoomSnapshotPacket snapshot;
+	if( !DeserializeRoomSnapshot( message, messageBytes, snapshotHeader, snapshot ) )
+	{
+		printf( "WARNING: Received malformed room snapshot from server!\n" );
+		return;
+	}
+
+	HandleServerAcknowledgement( snapshotHeader );
+
+	//How long it was on its way is only measurable once we know the server's clock
+	if( m_serverClock.IsSynchronized() )
+	{
+		double latencySeconds = m_serverClock.GetServerTimeSeconds( arrivalTimeSeconds ) - snapshotHeader.timestamp;
+		if( m_snapshotLatencySeconds == 0.0 )
+			m_snapshotLatencySeconds = latencySeconds;
+		else
+			m_snapshotLatencySeconds += ( latencySeconds - m_snapshotLatencySeconds ) / 16.0;
+	}
+
+	AssembleRoomSnapshotPart( snapshotHeader, snapshot );
+	m_jitterBuffer.Insert( snapshotHeader, &snapshot, arrivalTimeSeconds );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Rewinds our tank to the server's state, which has every input of ours through serverState.inputSequence
+//	applied, then replays the moves we predicted after it.
+void GameClient::ReconcileLocalEntity( const GameUpdatePacket& serverState )
+{
+	m_predictedMoves.DiscardThrough( serverState.inputSequence );
+
+	FloatVector2 reconciledPosition( serverState.xPosition, serverState.yPosition );
+	float reconciledOrientationDegrees = serverState.orientationDegrees;
+	for( unsigned int i = 0; i < m_predictedMoves.GetNumberOfMoves(); ++i )
+	{
+		const PredictedMoveBuffer::PredictedMove& move = m_predictedMoves.GetMove( i );
+		reconciledPosition += move.displacement;
+		reconciledOrientationDegrees = move.orientationDegrees;
+	}
+
+	m_localEntity->SetClientPosition( reconciledPosition.x, reconciledPosition.y );
+	m_localEntity->SetClientOrientation( reconciledOrientationDegrees );
+}
+
+//-----------------------------------------------------------------------------------------------
+void GameClient::RemoveUnacknowledgedPacket( PacketNumber number )
+{
+	m_unacknowledgedPackets.Remove( number );
+	if( number == m_pendingRoomRequestNumber )
+		m_pendingRoomRequestNumber = 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Every guaranteed packet has its own resend time, from the round-trip estimate, and goes out again with a fresh
+//	header when it passes. Each resend of the same packet waits twice as long, and after
+//	MAXIMUM_GUARANTEED_PACKET_RESENDS the packet is dropped.
+void GameClient::ResendUnacknowledgedPacketsToServer()
+{
+	if( m_unacknowledgedPackets.GetNumberOfPackets() == 0 )
+		return;
+
+	double currentTimeSeconds = GetCurrentTimeSeconds();
+	for( PacketNumber number = m_unacknowledgedPackets.GetOldestNumber(); number <= m_unacknowledgedPackets.GetNewestNumber(); ++number )
+	{
+		UnacknowledgedPacketBuffer::UnacknowledgedPacket* unackedPacket = m_unacknowledgedPackets.Find( number );
+		if( unackedPacket == nullptr || currentTimeSeconds < unackedPacket->resendTimeSeconds )
+			continue;
+
+		if( unackedPacket->numberOfResends >= MAXIMUM_GUARANTEED_PACKET_RESENDS )
+		{
+			printf( "WARNING: Gave up on packet %i to the server after %i resends.\n", number, MAXIMUM_GUARANTEED_PACKET_RESENDS );
+			RemoveUnacknowledgedPacket( number );
+			continue;
+		}
+
+		++unackedPacket->numberOfResends;
+		unackedPacket->header.timestamp = currentTimeSeconds;
+		unackedPacket->sendTimeSeconds = currentTimeSeconds;
+		unackedPacket->resendTimeSeconds = currentTimeSeconds + m_roundTripTime.GetBackedOffTimeoutSeconds( unackedPacket->numberOfResends );
+		m_receivedPackets.WriteAcknowledgements( unackedPacket->header );
+
+		char serializedPacket[ FINAL_PACKET_HEADER_WIRE_BYTES + MAXIMUM_FIXED_BODY_WIRE_BYTES ];
+		Network::ByteWriter packetWriter( serializedPacket, FINAL_PACKET_HEADER_WIRE_BYTES + MAXIMUM_FIXED_BODY_WIRE_BYTES );
+		WritePacketHeader( packetWriter, unackedPacket->header );
+		packetWriter.WriteBytes( unackedPacket->body, unackedPacket->bodyBytes );
+		if( !m_outgoingMessages.AppendMessage( serializedPacket, packetWriter.GetNumberOfBytesWritten() ) )
+			printf( "WARNING: Packet %i is too big for a datagram and can't be resent.\n", number );
+	}
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -352,6 +579,12 @@ void GameClient::ResetGame( const MainPacketType& resetPacket )
 	m_localEntity->SetServerOrientation( resetPacket.data.reset.orientationDegrees );
 	m_localEntity->SetHealth( World::MAX_HEALTH );
 	m_localEntity->SetScore( 0 );
+	m_localEntity->SetLocallyPredicted( true );
+
+	//The server starts our input sequence over with the game
+	m_predictedMoves.Clear();
+	m_lastInputSequence = INPUT_None;
+	m_stopInputsToSend = 0;
 
 	m_currentState = STATE_InGame;
 }
@@ -380,6 +613,29 @@ void GameClient::RespawnPlayer( const MainPacketType& respawnPacket )
 
 	respawnedEntity->SetHealth( 1 );
 	respawnedEntity->SetScore( 0 );
+
+	//Moves predicted before we died would carry over to the new spawn point
+	if( playerThatShouldBeDead != nullptr && playerThatShouldBeDead == m_localEntity )
+	{
+		m_localEntity = respawnedEntity;
+		m_localEntity->SetLocallyPredicted( true );
+		m_predictedMoves.Clear();
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+//Only for when nothing else is going to the server; an Ack has no body and no number of its own.
+void GameClient::SendAcknowledgementToServer()
+{
+	MainPacketType ackPacket;
+	ackPacket.type = TYPE_Ack;
+
+	if( m_localEntity != nullptr )
+		ackPacket.clientID = m_localEntity->GetID();
+	else
+		ackPacket.clientID = 0;
+	ackPacket.number = 0;
+	SendPacketToServer( ackPacket );
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -399,48 +655,64 @@ void GameClient::SendEntityTouchedIt( Entity*, Entity* )
 //-----------------------------------------------------------------------------------------------
 void GameClient::SendJoinRequestToServer( RoomID roomToJoin )
 {
-	MainPacketType* joinPacket = new MainPacketType();
-	joinPacket->type = TYPE_JoinRoom;
-	joinPacket->clientID = 0;
-	joinPacket->number = 0;
-
-	joinPacket->data.joining.room = roomToJoin;
-	SendPacketToServer( *joinPacket );
-	m_packetToResend = joinPacket;
+	MainPacketType joinPacket;
+	joinPacket.type = TYPE_JoinRoom;
+	joinPacket.clientID = 0;
+	joinPacket.number = GetNextPacketNumber();
+
+	joinPacket.data.joining.room = roomToJoin;
+	SendPacketToServer( joinPacket );
+	m_pendingRoomRequestNumber = joinPacket.number;
+	m_pendingRoomRequestRoom = roomToJoin;
 }
 
 //-----------------------------------------------------------------------------------------------
+//Guaranteed packets are also kept, with their own resend time, until the server acknowledges them.
 void GameClient::SendPacketToServer( MainPacketType& packet )
 {
 	packet.timestamp = GetCurrentTimeSeconds();
+	m_receivedPackets.WriteAcknowledgements( packet );
 
-	int sendResult = m_outputSocket.SendBuffer( ( char* )&packet, sizeof( MainPacketType ), m_serverAddress.c_str(), m_serverPort );
-	if( sendResult < 0 )
+	//Goes out with everything else this frame when FlushPacketsToServer runs
+	char serializedPacket[ MAXIMUM_PACKET_WIRE_BYTES ];
+	unsigned int serializedBytes = SerializePacket( packet, serializedPacket, MAXIMUM_PACKET_WIRE_BYTES );
+	if( !m_outgoingMessages.AppendMessage( serializedPacket, serializedBytes ) )
 	{
-		int errorCode = WSAGetLastError();
-		printf( "Unable to send packet to server at %s:%i. Error Code:%i.\n", m_serverAddress, m_serverPort, errorCode );
-		exit( -6 );
+		printf( "WARNING: Dropped a %i-byte packet too big for a datagram.\n", serializedBytes );
+		return;
+	}
+
+	if( packet.IsGuaranteed() )
+	{
+		double resendTimeSeconds = packet.timestamp + m_roundTripTime.GetRetransmissionTimeoutSeconds();
+		unsigned int bodyBytes = serializedBytes - FINAL_PACKET_HEADER_WIRE_BYTES;
+		InsertResult insertResult = m_unacknowledgedPackets.Insert( packet, serializedPacket + FINAL_PACKET_HEADER_WIRE_BYTES, bodyBytes, packet.timestamp, resendTimeSeconds );
+		if( insertResult == INSERT_BodyTooBig )
+			printf( "WARNING: Guaranteed packet %i has a %i-byte body, too big to keep; it won't be resent.\n", packet.number, bodyBytes );
+		else if( insertResult == INSERT_PushedOutOlderPacket )
+			printf( "WARNING: The server never acknowledged a guaranteed packet from %i packets ago; it won't be resent.\n", UnacknowledgedPacketBuffer::CAPACITY );
 	}
 }
 
 //-----------------------------------------------------------------------------------------------
 void GameClient::SendRoomCreationRequestToServer( RoomID roomToCreate )
 {
-	MainPacketType* createPacket = new MainPacketType();
-	createPacket->type = TYPE_CreateRoom;
-	createPacket->clientID = 0;
-	createPacket->number = 0;
+	MainPacketType createPacket;
+	createPacket.type = TYPE_CreateRoom;
+	createPacket.clientID = 0;
+	createPacket.number = GetNextPacketNumber();
 
-	createPacket->data.creating.room = roomToCreate;
+	createPacket.data.creating.room = roomToCreate;
 
-	SendPacketToServer( *createPacket );
-	m_packetToResend = createPacket;
+	SendPacketToServer( createPacket );
+	m_pendingRoomRequestNumber = createPacket.number;
+	m_pendingRoomRequestRoom = roomToCreate;
 }
 
 //-----------------------------------------------------------------------------------------------
 void GameClient::SendServerRoomRequestBasedOnStatus( RoomID room )
 {
-	if( m_packetToResend != nullptr )
+	if( m_pendingRoomRequestNumber != 0 )
 		return;
 
 	if( m_playersInRoom[ room - 1 ] == 0 ) //Remember: Rooms are 1 indexed!
@@ -450,67 +722,70 @@ void GameClient::SendServerRoomRequestBasedOnStatus( RoomID room )
 }
 
 //-----------------------------------------------------------------------------------------------
-void GameClient::SendUpdatedPositionsToServer( float deltaSeconds )
+//Sends the controls as an Input and moves our tank one step by them right away.
+void GameClient::SendInputToServer( const TankControlWrapper& controls )
 {
-	FloatVector2 currentPlayerPosition;
-	MainPacketType updatePacket;
-	updatePacket.type = TYPE_GameUpdate;
-	updatePacket.number = m_lastSentPacketNumber;
-	++m_lastSentPacketNumber;
-	if( m_localEntity != nullptr )
-		updatePacket.clientID = m_localEntity->GetID();
-	else
+	bool isMoving = controls.tankMovementMagnitude > 0.f;
+
+	MainPacketType inputPacket;
+	inputPacket.type = TYPE_Input;
+	inputPacket.clientID = m_localEntity->GetID();
+	inputPacket.number = GetNextPacketNumber();
+	inputPacket.timestamp = GetCurrentTimeSeconds();
+
+	InputPacket& input = inputPacket.data.input;
+	input.sequence = GetNextInputSequence();
+	input.movementHeadingDegrees = controls.tankMovementHeading;
+	input.movementMagnitude = controls.tankMovementMagnitude;
+	RoundInputToWireSteps( input );
+
+	//Move now instead of a round trip from now; ReconcileLocalEntity replays this until the server has applied it
+	FloatVector2 movement = World::GetTankMovementForInput( input.movementHeadingDegrees, input.movementMagnitude, m_localEntity->IsIt() );
+	float orientationDegrees = isMoving ? input.movementHeadingDegrees : m_localEntity->GetCurrentOrientation();
+	m_predictedMoves.Add( input.sequence, movement, orientationDegrees );
+
+	FloatVector2 newPosition = m_localEntity->GetCurrentPosition() + movement;
+	m_localEntity->SetClientPosition( newPosition.x, newPosition.y );
+	m_localEntity->SetClientOrientation( orientationDegrees );
+
+	SendPacketToServer( inputPacket );
+	m_secondsSinceLastSentUpdate = 0.f;
+	if( isMoving )
+		m_stopInputsToSend = STOP_INPUT_REPEATS;
+	else if( m_stopInputsToSend > 0 )
+		--m_stopInputsToSend;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Inputs go out at World::INPUTS_PER_SECOND however fast we draw frames, since each moves the tank one step.
+//	They're sent every step the tank is driven, for STOP_INPUT_REPEATS steps after it stops so the server
+//	zeroes its velocity even if some are lost, and otherwise every MAX_SECONDS_BETWEEN_PACKET_SENDS to keep us connected.
+void GameClient::SendInputsToServer( float deltaSeconds )
+{
+	if( m_localEntity == nullptr )
 		return;
-	updatePacket.timestamp = GetCurrentTimeSeconds();
 
-	if( m_tankInputs[ 0 ].tankMovementMagnitude > 0.f )
-	{
-		float orientationRadians = ConvertDegreesToRadians( m_tankInputs[ 0 ].tankMovementHeading );
-		FloatVector2 deltaVelocity( cos( orientationRadians ), -sin( orientationRadians ) );
-		deltaVelocity *= m_tankInputs[ 0 ].tankMovementMagnitude * 10.f;
-
-		if( m_localEntity->IsIt() )
-			deltaVelocity *= .9f; //It player is slower than the rest.
-
-		FloatVector2 currentPosition = m_localEntity->GetCurrentPosition();
-		currentPosition.x += deltaVelocity.x;
-		currentPosition.y += deltaVelocity.y;
-		updatePacket.data.updatedGame.xPosition = currentPosition.x;
-		updatePacket.data.updatedGame.yPosition = currentPosition.y;
-		updatePacket.data.updatedGame.xVelocity = deltaVelocity.x;
-		updatePacket.data.updatedGame.yVelocity = deltaVelocity.y;
-		updatePacket.data.updatedGame.orientationDegrees = m_tankInputs[ 0 ].tankMovementHeading;
-
-		SendPacketToServer( updatePacket );
-		m_secondsSinceLastSentUpdate = 0.f;
-	}
-	else if( m_secondsSinceLastSentUpdate > MAX_SECONDS_BETWEEN_PACKET_SENDS )
+	const TankControlWrapper& controls = m_tankInputs[ 0 ];
+	bool isMoving = controls.tankMovementMagnitude > 0.f;
+	unsigned int dueInputs = m_inputClock.TakeDueSteps( deltaSeconds );
+	for( unsigned int i = 0; i < dueInputs; ++i )
 	{
-		FloatVector2 currentPosition = m_localEntity->GetCurrentPosition();
-		updatePacket.data.updatedGame.xPosition = currentPosition.x;
-		updatePacket.data.updatedGame.yPosition = currentPosition.y;
-		FloatVector2 currentVelocity = m_localEntity->GetCurrentVelocity();
-		updatePacket.data.updatedGame.xVelocity = currentVelocity.x;
-		updatePacket.data.updatedGame.yVelocity = currentVelocity.y;
-
-		float currentOrientation = m_localEntity->GetCurrentOrientation();
-		updatePacket.data.updatedGame.orientationDegrees = currentOrientation;
-
-		SendPacketToServer( updatePacket );
-		m_secondsSinceLastSentUpdate = 0.f;
+		if( isMoving || m_stopInputsToSend > 0 || m_secondsSinceLastSentUpdate > MAX_SECONDS_BETWEEN_PACKET_SENDS )
+			SendInputToServer( controls );
 	}
 
 	if( m_tankInputs[ 0 ].isShooting )
 	{
-		MainPacketType* firePacket = new MainPacketType();
-		firePacket->type = TYPE_Fire;
-		firePacket->number = 0;
-		firePacket->clientID = m_myClientID;
-		firePacket->timestamp = GetCurrentTimeSeconds();
-		firePacket->data.gunfire.instigatorID = m_myClientID;
-
-		SendPacketToServer( *firePacket );
-		m_packetToResend = firePacket;
+		//Each shot is resent on its own, so a lost one doesn't hold up the next
+		MainPacketType firePacket;
+		firePacket.type = TYPE_Fire;
+		firePacket.number = GetNextPacketNumber();
+		firePacket.clientID = m_myClientID;
+		firePacket.timestamp = GetCurrentTimeSeconds();
+		firePacket.data.gunfire.instigatorID = m_myClientID;
+		firePacket.data.gunfire.viewTimestamp = m_renderTimestamp; //The server rewinds the other players to where we saw them
+
+		SendPacketToServer( firePacket );
 		m_secondsSinceLastSentUpdate = 0.f;
 	}
 
@@ -518,31 +793,78 @@ void GameClient::SendUpdatedPositionsToServer( float deltaSeconds )
 }
 
 //-----------------------------------------------------------------------------------------------
-void GameClient::UpdateEntityFromPacket( const MainPacketType& packet )
+//Asks every SECONDS_BETWEEN_TIME_SYNCS, and faster until the clock is synchronized. Requests aren't guaranteed;
+//	a lost one just leaves a gap until the next. Runs last thing before the flush, so the request's time is
+//	as close as we can get to when it actually goes out.
+void GameClient::SendTimeSyncRequestToServer( float deltaSeconds )
 {
-	Entity* updatingEntity = m_currentWorld->FindPlayerWithID( packet.clientID );
+	if( m_currentState == STATE_WaitingToJoinServer )
+		return;
 
-	if( updatingEntity == nullptr )
+	m_secondsUntilTimeSync -= deltaSeconds;
+	if( m_secondsUntilTimeSync > 0.f )
+		return;
+
+	MainPacketType timeSyncPacket;
+	timeSyncPacket.type = TYPE_TimeSync;
+	timeSyncPacket.clientID = m_myClientID;
+	timeSyncPacket.number = GetNextPacketNumber();
+	timeSyncPacket.data.timeSync.originTimestamp = GetCurrentTimeSeconds();
+	timeSyncPacket.data.timeSync.receiveTimestamp = 0.0;
+	SendPacketToServer( timeSyncPacket );
+
+	if( m_serverClock.IsSynchronized() )
+		m_secondsUntilTimeSync = SECONDS_BETWEEN_TIME_SYNCS;
+	else
+		m_secondsUntilTimeSync = SECONDS_BETWEEN_TIME_SYNCS_UNTIL_SYNCHRONIZED;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Only players in the snapshot part's deltas are updated; remote ones get one more state to interpolate through.
+//	A player is left out only while its quantized state hasn't changed, and extrapolation from its last state covers that.
+//Our own player is reconciled with the server's state instead.
+void GameClient::UpdateEntitiesFromSnapshot( const RoomState& roomState, const RoomSnapshotPacket& snapshot, double timestamp )
+{
+	GameUpdatePacket playerState;
+	for( unsigned int i = 0; i < snapshot.numberOfPlayers; ++i )
 	{
-		Entity* newEntity = new Entity();
-		m_currentWorld->AddNewPlayer( newEntity );
-		newEntity->SetID( packet.clientID );
-		newEntity->SetClientPosition( packet.data.updatedGame.xPosition, packet.data.updatedGame.yPosition );
-		newEntity->SetClientVelocity( packet.data.updatedGame.xVelocity, packet.data.updatedGame.yVelocity );
-		newEntity->SetClientAcceleration( packet.data.updatedGame.xAcceleration, packet.data.updatedGame.yAcceleration );
-		newEntity->SetClientOrientation( packet.data.updatedGame.orientationDegrees );
-
-		updatingEntity = newEntity;
-		printf( "Adding new player: ID:%i", packet.clientID );
-	}
+		RoomState::const_iterator player = roomState.find( snapshot.players[ i ].id );
+		if( player == roomState.end() )
+			continue; //Left the room
+
+		DequantizeGameUpdate( player->second, playerState );
+		Entity* updatingEntity = m_currentWorld->FindPlayerWithID( player->first );
 
-	updatingEntity->SetServerPosition( packet.data.updatedGame.xPosition, packet.data.updatedGame.yPosition );
-	updatingEntity->SetServerVelocity( packet.data.updatedGame.xVelocity, packet.data.updatedGame.yVelocity );
-	updatingEntity->SetServerAcceleration( packet.data.updatedGame.xAcceleration, packet.data.updatedGame.yAcceleration );
-	updatingEntity->SetServerOrientation( packet.data.updatedGame.orientationDegrees );
+		if( updatingEntity == nullptr )
+		{
+			Entity* newEntity = new Entity();
+			m_currentWorld->AddNewPlayer( newEntity );
+			newEntity->SetID( player->first );
+			newEntity->SetClientPosition( playerState.xPosition, playerState.yPosition );
+			newEntity->SetClientVelocity( playerState.xVelocity, playerState.yVelocity );
+			newEntity->SetClientAcceleration( playerState.xAcceleration, playerState.yAcceleration );
+			newEntity->SetClientOrientation( playerState.orientationDegrees );
+			updatingEntity = newEntity;
+			printf( "Adding new player: ID:%i", player->first );
+		}
 
-	updatingEntity->SetHealth( packet.data.updatedGame.health );
-	updatingEntity->SetScore( packet.data.updatedGame.score );
+		if( updatingEntity == m_localEntity )
+		{
+			updatingEntity->SetServerPosition( playerState.xPosition, playerState.yPosition );
+			updatingEntity->SetServerVelocity( playerState.xVelocity, playerState.yVelocity );
+			updatingEntity->SetServerAcceleration( playerState.xAcceleration, playerState.yAcceleration );
+			updatingEntity->SetServerOrientation( playerState.orientationDegrees );
+			ReconcileLocalEntity( playerState );
+		}
+		else
+		{
+			updatingEntity->AddServerState( timestamp, FloatVector2( playerState.xPosition, playerState.yPosition ), FloatVector2( playerState.xVelocity, playerState.yVelocity ),
+											FloatVector2( playerState.xAcceleration, playerState.yAcceleration ), playerState.orientationDegrees );
+		}
+
+		updatingEntity->SetHealth( playerState.health );
+		updatingEntity->SetScore( playerState.score );
+	}
 }
 #pragma endregion
 
@@ -554,10 +876,23 @@ GameClient::GameClient( unsigned int screenWidth, unsigned int screenHeight )
 	, m_tankInputs( 1 )
 	, m_currentState( STATE_WaitingToJoinServer )
 	, m_currentWorld( nullptr )
+	, m_lastSentPacketNumber( 0 )
 	, m_lastReceivedGuaranteedPacketNumber( 0 )
 	, m_lastReceivedPacketNumber( 0 )
 	, m_keyboard( new Keyboard() )
-	, m_packetToResend( nullptr )
+	, m_pendingRoomRequestNumber( 0 )
+	, m_pendingRoomRequestRoom( ROOM_None )
+	, m_assembledSequence( SNAPSHOT_None )
+	, m_numberOfAssembledParts( 0 )
+	, m_localEntity( nullptr )
+	, m_inputClock( World::INPUTS_PER_SECOND, MAXIMUM_INPUTS_PER_FRAME )
+	, m_lastInputSequence( INPUT_None )
+	, m_stopInputsToSend( 0 )
+	, m_secondsUntilTimeSync( 0.f )
+	, m_snapshotLatencySeconds( 0.0 )
+	, m_secondsSinceNetworkReport( 0.f )
+	, m_isReportingNetwork( false )
+	, m_renderTimestamp( 0.0 )
 {
 	m_controllers.push_back( Xbox::Controller::ONE );
 }
@@ -694,7 +1029,7 @@ void GameClient::Update( double timeSpentLastFrameSeconds )
 	case STATE_WaitingToJoinServer:
 		{
 			printf( "Sending join packet to server @%s:%i.\n", m_serverAddress.c_str(), m_serverPort );
-			if( m_packetToResend == nullptr )
+			if( m_pendingRoomRequestNumber == 0 )
 				SendJoinRequestToServer( ROOM_Lobby );
 
 			ProcessPacketQueue();
@@ -727,7 +1062,7 @@ void GameClient::Update( double timeSpentLastFrameSeconds )
 				MainPacketType keepAlivePacket;
 				keepAlivePacket.clientID = m_myClientID;
 				keepAlivePacket.type = TYPE_KeepAlive;
-				keepAlivePacket.number = 0;
+				keepAlivePacket.number = GetNextPacketNumber();
 				SendPacketToServer( keepAlivePacket );
 
 				secondsSinceLastResentPacket = 0.f;
@@ -746,11 +1081,34 @@ void GameClient::Update( double timeSpentLastFrameSeconds )
 		{
 			ProcessPacketQueue();
 			HandleInput( deltaSeconds );
-			SendUpdatedPositionsToServer( deltaSeconds );
+			SendInputsToServer( deltaSeconds );
 
 			if( m_currentWorld != nullptr )
+			{
 				m_currentWorld->Update( deltaSeconds );
 
+				//Remote players are drawn INTERPOLATION_DELAY_SECONDS behind the snapshots playing out now.
+				//	Playout follows the server's timestamps, so this is a time on the server's clock.
+				m_renderTimestamp = m_jitterBuffer.GetPlayoutTimestamp( GetCurrentTimeSeconds() ) - World::INTERPOLATION_DELAY_SECONDS;
+				m_currentWorld->InterpolatePlayers( m_renderTimestamp );
+			}
+
+			//F1 turns the network report on and off; it's off to start with
+			if( m_keyboard->KeyIsPressed( Keyboard::FUNCTION_1 ) )
+			{
+				m_isReportingNetwork = !m_isReportingNetwork;
+				m_secondsSinceNetworkReport = SECONDS_BETWEEN_NETWORK_REPORTS;
+			}
+			if( m_isReportingNetwork )
+			{
+				m_secondsSinceNetworkReport += deltaSeconds;
+				if( m_secondsSinceNetworkReport >= SECONDS_BETWEEN_NETWORK_REPORTS )
+				{
+					PrintNetworkReport();
+					m_secondsSinceNetworkReport = 0.f;
+				}
+			}
+
 			//check for touches
 // 			bool localPlayerTouchedFlag = m_currentWorld->PlayerIsTouchingObjective( m_localEntity );
 // 			if( localPlayerTouchedFlag )
@@ -758,28 +1116,20 @@ void GameClient::Update( double timeSpentLastFrameSeconds )
 // 				SendEntityTouchedIt( m_localEntity, m_localEntity );
 // 				m_currentState = STATE_InLobby;
 // 			}
-
-			ClearResendingPacket();
 		}
 		break;
 	default:
 		break;
 	}
 
-	//Resend "Guaranteed" client packets in situations when we need them.
-	static const float SECONDS_BEFORE_PACKETS_RESENT = 1.5f;
-	if( m_packetToResend != nullptr )
-	{
-		if( m_secondsSinceLastResentPacket > SECONDS_BEFORE_PACKETS_RESENT )
-		{
-			SendPacketToServer( *m_packetToResend );
-			m_secondsSinceLastResentPacket = 0.f;
-		}
-		m_secondsSinceLastResentPacket += deltaSeconds;
-	}
-	else
-		m_secondsSinceLastResentPacket = 0.f;
+	ResendUnacknowledgedPacketsToServer();
+
+	//Whatever we received this frame still needs acknowledging if nothing else went out
+	if( m_receivedPackets.HasUnsentAcknowledgements() )
+		SendAcknowledgementToServer();
 
+	SendTimeSyncRequestToServer( deltaSeconds );
+	FlushPacketsToServer();
 	m_keyboard->Update();
 }
 
@@ -2,18 +2,26 @@
 #define INCLUDED_GAME_CLIENT_HPP
 
 //-----------------------------------------------------------------------------------------------
-#include <map>
-#include <set>
 #include <vector>
 #include "../../../Common/Engine/Font/BitmapFont.hpp"
 #include "../../../Common/Engine/Input/Keyboard.hpp"
 #include "../../../Common/Engine/Input/Xbox.hpp"
 #include "../../../Common/Engine/Math/FloatVector2.hpp"
+#include "../../../Common/Engine/ClockSynchronizer.hpp"
 #include "../../../Common/Engine/Color.hpp"
+#include "../../../Common/Engine/MessageFraming.hpp"
+#include "../../../Common/Engine/RoundTripEstimator.hpp"
 #include "../../../Common/Engine/UDPSocket.hpp"
 #include "../../../Common/Game/FinalPacket.hpp"
+#include "../../../Common/Game/FinalPacketSerialization.hpp"
+#include "../../../Common/Game/FixedStepClock.hpp"
 #include "../../../Common/Game/Entity.hpp"
+#include "../../../Common/Game/JitterBuffer.hpp"
+#include "../../../Common/Game/ReceivedPacketWindow.hpp"
+#include "../../../Common/Game/SnapshotHistory.hpp"
+#include "../../../Common/Game/UnacknowledgedPacketBuffer.hpp"
 #include "../../../Common/Game/World.hpp"
+#include "PredictedMoveBuffer.hpp"
 #include "TankControlWrapper.h"
 
 struct MaterialComponent;
@@ -33,7 +41,12 @@ class GameClient
 	static const float		  IT_PLAYER_SPEED_MULTIPLIER;
 	static const float		  MAX_SECONDS_BETWEEN_PACKET_SENDS;
 	static const float		  OBJECT_CONTACT_DISTANCE;
-	static const float		  SECONDS_TO_WAIT_BEFORE_RESENDS;
+	static const float		  SECONDS_BETWEEN_TIME_SYNCS;
+	static const float		  SECONDS_BETWEEN_TIME_SYNCS_UNTIL_SYNCHRONIZED;
+	static const float		  SECONDS_BETWEEN_NETWORK_REPORTS;
+	static const unsigned int MAXIMUM_GUARANTEED_PACKET_RESENDS = 8;
+	static const unsigned int MAXIMUM_INPUTS_PER_FRAME = 4; //A slower frame loses the rest of its time, as the server would refuse it anyway
+	static const unsigned int STOP_INPUT_REPEATS = 4; //Inputs aren't guaranteed, so a lost stop would leave the server driving our tank
 	static const unsigned int MAX_NUMBER_OF_ROOMS = 8;
 
 	FloatVector2						m_screenSize;
@@ -50,15 +63,36 @@ class GameClient
 	unsigned int			m_lastSentPacketNumber;
 	unsigned int			m_lastReceivedPacketNumber;
 	unsigned int			m_lastReceivedGuaranteedPacketNumber;
-	MainPacketType*			m_packetToResend;
-	std::set< MainPacketType, FinalPacketComparer > m_packetQueue;
+	UnacknowledgedPacketBuffer m_unacknowledgedPackets; //Every guaranteed packet we sent that the server hasn't acknowledged
+	Network::RoundTripEstimator m_roundTripTime; //Sets how long each of those waits before a resend
+	Network::ClockSynchronizer m_serverClock; //Puts the server's timestamps on our clock
+	float					m_secondsUntilTimeSync;
+	double					m_snapshotLatencySeconds; //Smoothed time from the server sending a snapshot to it arriving
+	float					m_secondsSinceNetworkReport;
+	bool					m_isReportingNetwork;
+	PacketNumber			m_pendingRoomRequestNumber; //The JoinRoom or CreateRoom waiting on an answer, or 0
+	RoomID					m_pendingRoomRequestRoom;
+	ReceivedPacketWindow	m_receivedPackets; //Acknowledged in the header of everything we send
+	JitterBuffer			m_jitterBuffer; //What the server's packets do in the game waits here until their playout time
+	SnapshotHistory			m_snapshotHistory; //Snapshots we acknowledged, which the server sends deltas against
+	RoomState				m_assembledRoomState; //The snapshot whose parts are still arriving
+	SnapshotSequence		m_assembledSequence;
+	unsigned int			m_numberOfAssembledParts;
+	std::vector< PacketNumber > m_assembledPartNumbers; //Acknowledged together once the last part is in
+	Network::OutgoingMessageBuffer m_outgoingMessages;
+	std::vector< Network::BufferSegment > m_datagramSegments;
+	char					m_receivedDatagramBytes[ Network::MAXIMUM_DATAGRAM_PAYLOAD_BYTES ];
 
 	State			m_currentState;
 	World*			m_currentWorld;
 	ClientID		m_myClientID;
 	Entity*			m_localEntity;
+	PredictedMoveBuffer m_predictedMoves; //Moves of m_localEntity the server hasn't applied yet
+	FixedStepClock	m_inputClock; //Paces Inputs at World::INPUTS_PER_SECOND
+	InputSequence	m_lastInputSequence;
+	unsigned int	m_stopInputsToSend; //Left to send since the tank last stopped
+	double			m_renderTimestamp; //Server time remote players were last drawn at, or 0 before the first frame in game
 	float			m_secondsSinceLastSentUpdate;
-	float			m_secondsSinceLastResentPacket;
 	unsigned int	m_playersInRoom[ MAX_NUMBER_OF_ROOMS ];
 
 	//Input Functions
@@ -67,21 +101,34 @@ class GameClient
 
 	//Game Helper Functions
 	void AcknowledgePacket( const MainPacketType& packet );
-	void ClearResendingPacket();
-	void HandleIncomingPacket( const MainPacketType& packet );
+	void ApplyRoomSnapshotPart( const MainPacketType& snapshotHeader, const RoomSnapshotPacket& snapshot );
+	void AssembleRoomSnapshotPart( const MainPacketType& snapshotHeader, const RoomSnapshotPacket& snapshot );
+	void FlushPacketsToServer();
+	InputSequence GetNextInputSequence();
+	PacketNumber GetNextPacketNumber() { return ++m_lastSentPacketNumber; }
+	double GetServerTimeSeconds() const;
+	void HandleIncomingPacket( const MainPacketType& packet, const RoomSnapshotPacket& snapshot );
 	void HandleServerAcknowledgement( const MainPacketType& packet );
 	void HandleServerRefusal( const MainPacketType& packet );
+	void PrintNetworkReport() const;
 	void ProcessNetworkQueue();
 	void ProcessPacketQueue();
+	void QueueRoomSnapshot( const char* message, unsigned int messageBytes, double arrivalTimeSeconds );
+	void ReconcileLocalEntity( const GameUpdatePacket& serverState );
+	void RemoveUnacknowledgedPacket( PacketNumber number );
+	void ResendUnacknowledgedPacketsToServer();
 	void ResetGame( const MainPacketType& resetPacket );
 	void RespawnPlayer( const MainPacketType& respawnPacket );
+	void SendAcknowledgementToServer();
 	void SendEntityTouchedIt( Entity* touchingEntity, Entity* itEntity );
+	void SendInputToServer( const TankControlWrapper& controls );
+	void SendInputsToServer( float deltaSeconds );
 	void SendJoinRequestToServer( RoomID roomToJoin = ROOM_Lobby );
 	void SendPacketToServer( MainPacketType& packet );
 	void SendRoomCreationRequestToServer( RoomID roomToCreate );
 	void SendServerRoomRequestBasedOnStatus( RoomID room );
-	void SendUpdatedPositionsToServer( float deltaSeconds );
-	void UpdateEntityFromPacket( const MainPacketType& packet );
+	void SendTimeSyncRequestToServer( float deltaSeconds );
+	void UpdateEntitiesFromSnapshot( const RoomState& roomState, const RoomSnapshotPacket& snapshot, double timestamp );
 	void UpdateLobbyStatus( const MainPacketType& packet );
 
 public:
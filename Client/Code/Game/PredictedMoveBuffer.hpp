@@ -0,0 +1,75 @@
+#pragma once
+#ifndef INCLUDED_PREDICTED_MOVE_BUFFER_HPP
+#define INCLUDED_PREDICTED_MOVE_BUFFER_HPP
+
+#include "../../../Common/Engine/Math/FloatVector2.hpp"
+#include "../../../Common/Game/FinalPacket.hpp"
+
+//-----------------------------------------------------------------------------------------------
+//The moves we applied to our own tank ahead of the server, oldest first, in a fixed ring.
+//When a snapshot says which of our inputs the server has applied, those moves are discarded and the
+//	rest are replayed on top of the server's position, so a correction never undoes input still in flight.
+class PredictedMoveBuffer
+{
+public:
+	static const unsigned int CAPACITY = 64; //A second of Inputs at World::INPUTS_PER_SECOND; longer round trips drop the oldest moves
+
+	struct PredictedMove
+	{
+		InputSequence sequence;
+		FloatVector2 displacement;
+		float orientationDegrees;
+	};
+
+	PredictedMoveBuffer() { Clear(); }
+
+	void Add( InputSequence sequence, const FloatVector2& displacement, float orientationDegrees );
+	void Clear();
+	void DiscardThrough( InputSequence sequence );
+	const PredictedMove& GetMove( unsigned int index ) const { return m_moves[ ( m_oldestMove + index ) % CAPACITY ]; }
+	unsigned int GetNumberOfMoves() const { return m_numberOfMoves; }
+
+private:
+	PredictedMove m_moves[ CAPACITY ];
+	unsigned int m_oldestMove;
+	unsigned int m_numberOfMoves;
+};
+
+
+
+//-----------------------------------------------------------------------------------------------
+//Sequences have to go up from one move to the next.
+inline void PredictedMoveBuffer::Add( InputSequence sequence, const FloatVector2& displacement, float orientationDegrees )
+{
+	if( m_numberOfMoves == CAPACITY )
+	{
+		m_oldestMove = ( m_oldestMove + 1 ) % CAPACITY;
+		--m_numberOfMoves;
+	}
+
+	PredictedMove& newMove = m_moves[ ( m_oldestMove + m_numberOfMoves ) % CAPACITY ];
+	newMove.sequence = sequence;
+	newMove.displacement = displacement;
+	newMove.orientationDegrees = orientationDegrees;
+	++m_numberOfMoves;
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void PredictedMoveBuffer::Clear()
+{
+	m_oldestMove = 0;
+	m_numberOfMoves = 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Drops every move up to and including sequence, which the server has already applied.
+inline void PredictedMoveBuffer::DiscardThrough( InputSequence sequence )
+{
+	while( m_numberOfMoves > 0 && !IsInputSequenceNewer( m_moves[ m_oldestMove ].sequence, sequence ) )
+	{
+		m_oldestMove = ( m_oldestMove + 1 ) % CAPACITY;
+		--m_numberOfMoves;
+	}
+}
+
+#endif //INCLUDED_PREDICTED_MOVE_BUFFER_HPP
@@ -0,0 +1,149 @@
+#pragma once
+#ifndef INCLUDED_BIT_STREAM_HPP
+#define INCLUDED_BIT_STREAM_HPP
+
+#include <math.h>
+
+//-----------------------------------------------------------------------------------------------
+//Bit-granular reading and writing, most significant bit first, for fields that don't need whole bytes.
+//Floats are sent as fixed-point: ( value - minimum ) * stepsPerUnit, rounded and clamped to the bit count.
+namespace Network
+{
+	//-----------------------------------------------------------------------------------------------
+	//Values outside what the bits can hold are clamped to the nearest end of the range.
+	inline unsigned int QuantizeFixedPoint( float value, float minimum, float stepsPerUnit, unsigned int numberOfBits )
+	{
+		float maximumStep = static_cast< float >( ( 1ULL << numberOfBits ) - 1 );
+		float step = floorf( ( value - minimum ) * stepsPerUnit + 0.5f );
+		if( !( step >= 0.f ) ) //Also catches NaN
+			step = 0.f;
+		if( step > maximumStep )
+			step = maximumStep;
+
+		return static_cast< unsigned int >( step );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline float DequantizeFixedPoint( unsigned int step, float minimum, float stepsPerUnit )
+	{
+		return minimum + static_cast< float >( step ) / stepsPerUnit;
+	}
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//Writes into a caller-owned buffer. Writing past the end sets HasOverflowed and stops writing.
+	class BitWriter
+	{
+	public:
+		BitWriter( char* buffer, unsigned int bufferBytes )
+			: m_buffer( reinterpret_cast< unsigned char* >( buffer ) )
+			, m_bufferBits( bufferBytes * 8 )
+			, m_bitsWritten( 0 )
+			, m_hasOverflowed( false )
+		{ }
+
+		void WriteBits( unsigned int value, unsigned int numberOfBits );
+		void WriteBool( bool value ) { WriteBits( value ? 1 : 0, 1 ); }
+		void WriteFixedPoint( float value, float minimum, float stepsPerUnit, unsigned int numberOfBits );
+
+		unsigned int GetNumberOfBitsWritten() const { return m_bitsWritten; }
+		unsigned int GetNumberOfBytesWritten() const { return ( m_bitsWritten + 7 ) / 8; } //The last byte is zero-padded
+		bool HasOverflowed() const { return m_hasOverflowed; }
+
+	private:
+		unsigned char* m_buffer;
+		unsigned int m_bufferBits;
+		unsigned int m_bitsWritten;
+		bool m_hasOverflowed;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//Reads back what a BitWriter wrote. Reading past the end sets IsMalformed and returns zeroes.
+	class BitReader
+	{
+	public:
+		BitReader( const char* buffer, unsigned int bufferBytes )
+			: m_buffer( reinterpret_cast< const unsigned char* >( buffer ) )
+			, m_bufferBits( bufferBytes * 8 )
+			, m_bitsRead( 0 )
+			, m_isMalformed( false )
+		{ }
+
+		unsigned int ReadBits( unsigned int numberOfBits );
+		bool ReadBool() { return ReadBits( 1 ) != 0; }
+		float ReadFixedPoint( float minimum, float stepsPerUnit, unsigned int numberOfBits );
+
+		unsigned int GetNumberOfBytesRead() const { return ( m_bitsRead + 7 ) / 8; } //Counts the partly read last byte
+		bool IsMalformed() const { return m_isMalformed; }
+
+	private:
+		const unsigned char* m_buffer;
+		unsigned int m_bufferBits;
+		unsigned int m_bitsRead;
+		bool m_isMalformed;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//Writes the low numberOfBits (1-32) of value.
+	inline void BitWriter::WriteBits( unsigned int value, unsigned int numberOfBits )
+	{
+		if( m_hasOverflowed || m_bitsWritten + numberOfBits > m_bufferBits )
+		{
+			m_hasOverflowed = true;
+			return;
+		}
+
+		for( int bit = static_cast< int >( numberOfBits ) - 1; bit >= 0; --bit )
+		{
+			unsigned int byteIndex = m_bitsWritten / 8;
+			unsigned int bitInByte = 7 - ( m_bitsWritten % 8 );
+			if( bitInByte == 7 )
+				m_buffer[ byteIndex ] = 0; //Starting a fresh byte; the caller's buffer may hold anything
+
+			if( ( value >> bit ) & 1 )
+				m_buffer[ byteIndex ] |= static_cast< unsigned char >( 1 << bitInByte );
+			++m_bitsWritten;
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline void BitWriter::WriteFixedPoint( float value, float minimum, float stepsPerUnit, unsigned int numberOfBits )
+	{
+		WriteBits( QuantizeFixedPoint( value, minimum, stepsPerUnit, numberOfBits ), numberOfBits );
+	}
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	inline unsigned int BitReader::ReadBits( unsigned int numberOfBits )
+	{
+		if( m_isMalformed || m_bitsRead + numberOfBits > m_bufferBits )
+		{
+			m_isMalformed = true;
+			return 0;
+		}
+
+		unsigned int value = 0;
+		for( unsigned int i = 0; i < numberOfBits; ++i )
+		{
+			unsigned int byteIndex = m_bitsRead / 8;
+			unsigned int bitInByte = 7 - ( m_bitsRead % 8 );
+			value = ( value << 1 ) | ( ( m_buffer[ byteIndex ] >> bitInByte ) & 1 );
+			++m_bitsRead;
+		}
+		return value;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline float BitReader::ReadFixedPoint( float minimum, float stepsPerUnit, unsigned int numberOfBits )
+	{
+		return DequantizeFixedPoint( ReadBits( numberOfBits ), minimum, stepsPerUnit );
+	}
+}
+
+#endif //INCLUDED_BIT_STREAM_HPP
@@ -0,0 +1,209 @@
+#pragma once
+#ifndef INCLUDED_BYTE_STREAM_HPP
+#define INCLUDED_BYTE_STREAM_HPP
+
+#include <string.h>
+
+//-----------------------------------------------------------------------------------------------
+//Fixed-order (big-endian) reading and writing of plain values, so struct padding and host byte order
+//	never reach the wire. Floats and doubles go out as their IEEE-754 bit patterns.
+namespace Network
+{
+	//-----------------------------------------------------------------------------------------------
+	//Writes into a caller-owned buffer. Writing past the end sets HasOverflowed and stops writing.
+	class ByteWriter
+	{
+	public:
+		ByteWriter( char* buffer, unsigned int bufferBytes )
+			: m_buffer( reinterpret_cast< unsigned char* >( buffer ) )
+			, m_bufferBytes( bufferBytes )
+			, m_bytesWritten( 0 )
+			, m_hasOverflowed( false )
+		{ }
+
+		void WriteUnsignedChar( unsigned char value );
+		void WriteUnsignedInt( unsigned int value );
+		void WriteUnsignedLongLong( unsigned long long value );
+		void WriteFloat( float value );
+		void WriteDouble( double value );
+		void WriteBytes( const char* bytes, unsigned int numberOfBytes );
+
+		unsigned int GetNumberOfBytesWritten() const { return m_bytesWritten; }
+		bool HasOverflowed() const { return m_hasOverflowed; }
+
+	private:
+		bool ReserveBytes( unsigned int numberOfBytes );
+
+		unsigned char* m_buffer;
+		unsigned int m_bufferBytes;
+		unsigned int m_bytesWritten;
+		bool m_hasOverflowed;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//Reads back what a ByteWriter wrote. Reading past the end sets IsMalformed and returns zeroes.
+	class ByteReader
+	{
+	public:
+		ByteReader( const char* buffer, unsigned int bufferBytes )
+			: m_buffer( reinterpret_cast< const unsigned char* >( buffer ) )
+			, m_bufferBytes( bufferBytes )
+			, m_bytesRead( 0 )
+			, m_isMalformed( false )
+		{ }
+
+		unsigned char ReadUnsignedChar();
+		unsigned int ReadUnsignedInt();
+		unsigned long long ReadUnsignedLongLong();
+		float ReadFloat();
+		double ReadDouble();
+		void SkipBytes( unsigned int numberOfBytes ) { ConsumeBytes( numberOfBytes ); }
+
+		const char* GetRemainingBytes() const { return reinterpret_cast< const char* >( m_buffer + m_bytesRead ); }
+		unsigned int GetNumberOfBytesLeft() const { return m_bufferBytes - m_bytesRead; }
+		bool IsMalformed() const { return m_isMalformed; }
+		void MarkMalformed() { m_isMalformed = true; } //For callers that decode GetRemainingBytes themselves
+
+	private:
+		bool ConsumeBytes( unsigned int numberOfBytes );
+
+		const unsigned char* m_buffer;
+		unsigned int m_bufferBytes;
+		unsigned int m_bytesRead;
+		bool m_isMalformed;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	inline void ByteWriter::WriteUnsignedChar( unsigned char value )
+	{
+		if( !ReserveBytes( 1 ) )
+			return;
+
+		m_buffer[ m_bytesWritten - 1 ] = value;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline void ByteWriter::WriteUnsignedInt( unsigned int value )
+	{
+		if( !ReserveBytes( 4 ) )
+			return;
+
+		unsigned char* bytes = m_buffer + m_bytesWritten - 4;
+		bytes[ 0 ] = static_cast< unsigned char >( value >> 24 );
+		bytes[ 1 ] = static_cast< unsigned char >( value >> 16 );
+		bytes[ 2 ] = static_cast< unsigned char >( value >> 8 );
+		bytes[ 3 ] = static_cast< unsigned char >( value );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline void ByteWriter::WriteUnsignedLongLong( unsigned long long value )
+	{
+		WriteUnsignedInt( static_cast< unsigned int >( value >> 32 ) );
+		WriteUnsignedInt( static_cast< unsigned int >( value ) );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline void ByteWriter::WriteFloat( float value )
+	{
+		unsigned int valueBits = 0;
+		memcpy( &valueBits, &value, sizeof( float ) );
+		WriteUnsignedInt( valueBits );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline void ByteWriter::WriteDouble( double value )
+	{
+		unsigned long long valueBits = 0;
+		memcpy( &valueBits, &value, sizeof( double ) );
+		WriteUnsignedLongLong( valueBits );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline void ByteWriter::WriteBytes( const char* bytes, unsigned int numberOfBytes )
+	{
+		if( !ReserveBytes( numberOfBytes ) )
+			return;
+
+		memcpy( m_buffer + m_bytesWritten - numberOfBytes, bytes, numberOfBytes );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline bool ByteWriter::ReserveBytes( unsigned int numberOfBytes )
+	{
+		if( m_hasOverflowed || m_bytesWritten + numberOfBytes > m_bufferBytes )
+		{
+			m_hasOverflowed = true;
+			return false;
+		}
+
+		m_bytesWritten += numberOfBytes;
+		return true;
+	}
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	inline unsigned char ByteReader::ReadUnsignedChar()
+	{
+		if( !ConsumeBytes( 1 ) )
+			return 0;
+
+		return m_buffer[ m_bytesRead - 1 ];
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline unsigned int ByteReader::ReadUnsignedInt()
+	{
+		if( !ConsumeBytes( 4 ) )
+			return 0;
+
+		const unsigned char* bytes = m_buffer + m_bytesRead - 4;
+		return ( static_cast< unsigned int >( bytes[ 0 ] ) << 24 ) | ( static_cast< unsigned int >( bytes[ 1 ] ) << 16 ) |
+			   ( static_cast< unsigned int >( bytes[ 2 ] ) << 8 ) | static_cast< unsigned int >( bytes[ 3 ] );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline unsigned long long ByteReader::ReadUnsignedLongLong()
+	{
+		unsigned long long highBits = ReadUnsignedInt();
+		unsigned long long lowBits = ReadUnsignedInt();
+		return ( highBits << 32 ) | lowBits;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline float ByteReader::ReadFloat()
+	{
+		unsigned int valueBits = ReadUnsignedInt();
+		float value = 0.f;
+		memcpy( &value, &valueBits, sizeof( float ) );
+		return value;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline double ByteReader::ReadDouble()
+	{
+		unsigned long long valueBits = ReadUnsignedLongLong();
+		double value = 0.0;
+		memcpy( &value, &valueBits, sizeof( double ) );
+		return value;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline bool ByteReader::ConsumeBytes( unsigned int numberOfBytes )
+	{
+		if( m_isMalformed || numberOfBytes > m_bufferBytes - m_bytesRead )
+		{
+			m_isMalformed = true;
+			return false;
+		}
+
+		m_bytesRead += numberOfBytes;
+		return true;
+	}
+}
+
+#endif //INCLUDED_BYTE_STREAM_HPP
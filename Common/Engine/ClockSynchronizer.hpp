@@ -0,0 +1,140 @@
+#pragma once
+#ifndef INCLUDED_CLOCK_SYNCHRONIZER_HPP
+#define INCLUDED_CLOCK_SYNCHRONIZER_HPP
+
+//-----------------------------------------------------------------------------------------------
+//Maps our clock onto the server's from request/reply exchanges the way NTP does it (RFC 5905). Each exchange
+//	gives the round trip less the server's time holding the request, and an offset that is only off by half
+//	the difference between the two legs. Queueing delay makes the legs unequal, so the estimate comes from the
+//	exchange with the shortest round trip in the last WINDOW_SAMPLES. The best exchanges in the older and
+//	newer halves of the window also give how fast the offset drifts, which carries it between exchanges.
+namespace Network
+{
+	static const double MAXIMUM_CLOCK_DRIFT = 0.0005; //Seconds per second; quartz clocks are usually within a fifth of this
+	static const double MINIMUM_DRIFT_BASELINE_SECONDS = 4.0; //Closer exchanges measure their own noise instead of drift
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	class ClockSynchronizer
+	{
+	public:
+		static const unsigned int WINDOW_SAMPLES = 16;
+		static const unsigned int SAMPLES_BEFORE_SYNCHRONIZED = 4;
+
+		ClockSynchronizer() { Reset(); }
+
+		void AddSample( double originTimestamp, double serverReceiveTimestamp, double serverTransmitTimestamp, double arrivalTimestamp );
+		double GetDriftRate() const { return m_driftRate; }
+		double GetMinimumRoundTripSeconds() const { return m_minimumRoundTripSeconds; }
+		double GetOffsetSeconds( double localTimeSeconds ) const;
+		double GetServerTimeSeconds( double localTimeSeconds ) const { return localTimeSeconds + GetOffsetSeconds( localTimeSeconds ); }
+		bool IsSynchronized() const { return m_numberOfSamples >= SAMPLES_BEFORE_SYNCHRONIZED; }
+		void Reset();
+
+	private:
+		struct Sample
+		{
+			double localTimeSeconds; //Halfway through the exchange, by our clock
+			double offsetSeconds; //Server time minus ours
+			double roundTripSeconds;
+		};
+
+		const Sample& GetSample( unsigned int index ) const { return m_samples[ ( m_oldestSample + index ) % WINDOW_SAMPLES ]; } //0 is the oldest
+		unsigned int FindBestSample( unsigned int firstIndex, unsigned int endIndex ) const;
+		void UpdateEstimate();
+
+		Sample m_samples[ WINDOW_SAMPLES ];
+		unsigned int m_oldestSample;
+		unsigned int m_numberOfSamples;
+		double m_offsetSeconds; //At m_offsetLocalTimeSeconds
+		double m_offsetLocalTimeSeconds;
+		double m_driftRate;
+		double m_minimumRoundTripSeconds;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//originTimestamp and arrivalTimestamp are by our clock; the other two are by the server's.
+	inline void ClockSynchronizer::AddSample( double originTimestamp, double serverReceiveTimestamp, double serverTransmitTimestamp, double arrivalTimestamp )
+	{
+		double roundTripSeconds = ( arrivalTimestamp - originTimestamp ) - ( serverTransmitTimestamp - serverReceiveTimestamp );
+		if( !( roundTripSeconds >= 0.0 ) ) //Also catches NaN
+			return;
+
+		if( m_numberOfSamples == WINDOW_SAMPLES )
+		{
+			m_oldestSample = ( m_oldestSample + 1 ) % WINDOW_SAMPLES;
+			--m_numberOfSamples;
+		}
+
+		Sample& newSample = m_samples[ ( m_oldestSample + m_numberOfSamples ) % WINDOW_SAMPLES ];
+		newSample.localTimeSeconds = 0.5 * ( originTimestamp + arrivalTimestamp );
+		newSample.offsetSeconds = 0.5 * ( ( serverReceiveTimestamp - originTimestamp ) + ( serverTransmitTimestamp - arrivalTimestamp ) );
+		newSample.roundTripSeconds = roundTripSeconds;
+		++m_numberOfSamples;
+
+		UpdateEstimate();
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Returns the index of the sample with the shortest round trip from firstIndex up to endIndex.
+	inline unsigned int ClockSynchronizer::FindBestSample( unsigned int firstIndex, unsigned int endIndex ) const
+	{
+		unsigned int bestIndex = firstIndex;
+		for( unsigned int index = firstIndex + 1; index < endIndex; ++index )
+		{
+			if( GetSample( index ).roundTripSeconds < GetSample( bestIndex ).roundTripSeconds )
+				bestIndex = index;
+		}
+		return bestIndex;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Zero until the first exchange comes back, so our own clock stands in for the server's.
+	inline double ClockSynchronizer::GetOffsetSeconds( double localTimeSeconds ) const
+	{
+		return m_offsetSeconds + m_driftRate * ( localTimeSeconds - m_offsetLocalTimeSeconds );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline void ClockSynchronizer::Reset()
+	{
+		m_oldestSample = 0;
+		m_numberOfSamples = 0;
+		m_offsetSeconds = 0.0;
+		m_offsetLocalTimeSeconds = 0.0;
+		m_driftRate = 0.0;
+		m_minimumRoundTripSeconds = 0.0;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Drift is smoothed over several windows, since each half's best exchange is still a little off.
+	inline void ClockSynchronizer::UpdateEstimate()
+	{
+		const Sample& bestSample = GetSample( FindBestSample( 0, m_numberOfSamples ) );
+		m_offsetSeconds = bestSample.offsetSeconds;
+		m_offsetLocalTimeSeconds = bestSample.localTimeSeconds;
+		m_minimumRoundTripSeconds = bestSample.roundTripSeconds;
+
+		if( m_numberOfSamples < SAMPLES_BEFORE_SYNCHRONIZED )
+			return;
+
+		unsigned int halfOfSamples = m_numberOfSamples / 2;
+		const Sample& olderSample = GetSample( FindBestSample( 0, halfOfSamples ) );
+		const Sample& newerSample = GetSample( FindBestSample( halfOfSamples, m_numberOfSamples ) );
+		double baselineSeconds = newerSample.localTimeSeconds - olderSample.localTimeSeconds;
+		if( baselineSeconds < MINIMUM_DRIFT_BASELINE_SECONDS )
+			return;
+
+		double measuredDriftRate = ( newerSample.offsetSeconds - olderSample.offsetSeconds ) / baselineSeconds;
+		if( measuredDriftRate > MAXIMUM_CLOCK_DRIFT )
+			measuredDriftRate = MAXIMUM_CLOCK_DRIFT;
+		else if( measuredDriftRate < -MAXIMUM_CLOCK_DRIFT )
+			measuredDriftRate = -MAXIMUM_CLOCK_DRIFT;
+		m_driftRate += 0.25 * ( measuredDriftRate - m_driftRate );
+	}
+}
+
+#endif //INCLUDED_CLOCK_SYNCHRONIZER_HPP
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef INCLUDED_DATAGRAM_SOCKET_HPP
+#define INCLUDED_DATAGRAM_SOCKET_HPP
+
+#include <string>
+#include "Socket.hpp"
+
+//-----------------------------------------------------------------------------------------------
+namespace Network
+{
+	//-----------------------------------------------------------------------------------------------
+	//An IPv4 address and port packed into 48 bits: ( address << 16 ) | port, both in host byte order.
+	typedef unsigned long long EndpointKey;
+
+	//-----------------------------------------------------------------------------------------------
+	inline EndpointKey MakeEndpointKey( const sockaddr_in& address )
+	{
+		return ( static_cast< EndpointKey >( ntohl( address.sin_addr.s_addr ) ) << 16 ) | ntohs( address.sin_port );
+	}
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//One piece of a datagram handed to DatagramSocket::QueueSegmentsForSend; the pieces go out back to back.
+	struct BufferSegment
+	{
+		const char* bytes;
+		unsigned int numberOfBytes;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//Describes one datagram filled in by DatagramSocket::ReceiveBufferBatch.
+	struct ReceivedDatagram
+	{
+		int numberOfBytes;
+		sockaddr_in senderAddress;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//The batched receive/queued send interface the game server talks to.
+	//UDPSocket implements it with plain socket calls (epoll, recvmmsg and sendmmsg on Linux);
+	//	IOUringSocket implements it on top of an io_uring instance.
+	ABSTRACT class DatagramSocket
+	{
+	public:
+		static const unsigned int MAXIMUM_DATAGRAMS_PER_BATCH = 64;
+
+		virtual ~DatagramSocket() { }
+
+		virtual int Initialize() = 0;
+		virtual int EnablePortSharing() = 0;
+		virtual int Bind( const std::string& address, const std::string& portNumber ) = 0;
+		virtual int ReceiveBufferBatch( char* buffers, int bufferLength, unsigned int numberOfBuffers, ReceivedDatagram* out_receivedDatagrams ) = 0;
+		virtual int QueueBufferForSend( const char* buffer, int bufferLength, const sockaddr_in& receiverAddress ) = 0;
+		virtual int QueueSegmentsForSend( const BufferSegment* segments, unsigned int numberOfSegments, const sockaddr_in& receiverAddress ) = 0;
+		virtual int FlushSendQueue() = 0;
+		virtual int WaitForIncomingData( int timeoutMilliseconds ) = 0;
+		virtual int GetReadinessDescriptor() const = 0; //Pollable descriptor that turns readable when datagrams arrive, or -1 if there is none
+		virtual int GetLastSendErrorCode() const = 0; //Why the last FlushSendQueue that returned a negative value failed
+		virtual int SetFunctionsToNonbindingMode() = 0;
+		virtual int Cleanup() = 0;
+	};
+}
+
+#endif //INCLUDED_DATAGRAM_SOCKET_HPP
@@ -0,0 +1,190 @@
+#pragma once
+#ifndef INCLUDED_ENDPOINT_TABLE_HPP
+#define INCLUDED_ENDPOINT_TABLE_HPP
+
+#include "DatagramSocket.hpp"
+
+//-----------------------------------------------------------------------------------------------
+namespace Network
+{
+	//-----------------------------------------------------------------------------------------------
+	//Open-addressing (linear probing) hash table keyed by EndpointKey.
+	//Lookups touch one contiguous array and never allocate; the table only allocates when it grows.
+	//Removal shifts later entries of the probe run back, so there are no tombstones to clean up.
+	template< typename ValueType >
+	class EndpointTable
+	{
+		static const EndpointKey EMPTY_KEY = ~0ULL; //Packed endpoints only use 48 bits, so this is never a real key
+		static const unsigned int MINIMUM_CAPACITY = 16;
+
+	public:
+		EndpointTable( unsigned int initialCapacity = 64 );
+		~EndpointTable() { delete[] m_slots; }
+
+		ValueType* Find( EndpointKey key ) const;
+		void Insert( EndpointKey key, const ValueType& value );
+		bool Remove( EndpointKey key );
+		void Clear();
+
+		unsigned int GetSize() const { return m_numberOfEntries; }
+
+	private:
+		struct Slot
+		{
+			EndpointKey key;
+			ValueType value;
+		};
+
+		EndpointTable( const EndpointTable& );
+		EndpointTable& operator=( const EndpointTable& );
+
+		static unsigned int HashEndpointKey( EndpointKey key );
+		void Grow();
+
+		Slot* m_slots;
+		unsigned int m_capacityMask;
+		unsigned int m_numberOfEntries;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	template< typename ValueType >
+	EndpointTable< ValueType >::EndpointTable( unsigned int initialCapacity )
+		: m_slots( nullptr )
+		, m_capacityMask( 0 )
+		, m_numberOfEntries( 0 )
+	{
+		unsigned int capacity = MINIMUM_CAPACITY;
+		while( capacity < initialCapacity )
+			capacity <<= 1;
+
+		m_slots = new Slot[ capacity ];
+		m_capacityMask = capacity - 1;
+		Clear();
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Returns a pointer to the stored value, or nullptr if the key isn't in the table.
+	template< typename ValueType >
+	ValueType* EndpointTable< ValueType >::Find( EndpointKey key ) const
+	{
+		unsigned int slotIndex = HashEndpointKey( key ) & m_capacityMask;
+		while( m_slots[ slotIndex ].key != EMPTY_KEY )
+		{
+			if( m_slots[ slotIndex ].key == key )
+				return &m_slots[ slotIndex ].value;
+
+			slotIndex = ( slotIndex + 1 ) & m_capacityMask;
+		}
+		return nullptr;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	template< typename ValueType >
+	void EndpointTable< ValueType >::Insert( EndpointKey key, const ValueType& value )
+	{
+		ValueType* existingValue = Find( key );
+		if( existingValue != nullptr )
+		{
+			*existingValue = value;
+			return;
+		}
+
+		//Keep the load factor under one half so probe runs stay short
+		if( ( m_numberOfEntries + 1 ) * 2 > m_capacityMask + 1 )
+			Grow();
+
+		unsigned int slotIndex = HashEndpointKey( key ) & m_capacityMask;
+		while( m_slots[ slotIndex ].key != EMPTY_KEY )
+		{
+			slotIndex = ( slotIndex + 1 ) & m_capacityMask;
+		}
+
+		m_slots[ slotIndex ].key = key;
+		m_slots[ slotIndex ].value = value;
+		++m_numberOfEntries;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Returns true if the key was in the table.
+	template< typename ValueType >
+	bool EndpointTable< ValueType >::Remove( EndpointKey key )
+	{
+		unsigned int slotIndex = HashEndpointKey( key ) & m_capacityMask;
+		while( m_slots[ slotIndex ].key != key )
+		{
+			if( m_slots[ slotIndex ].key == EMPTY_KEY )
+				return false;
+
+			slotIndex = ( slotIndex + 1 ) & m_capacityMask;
+		}
+
+		//Walk the rest of the probe run and pull back any entry that the hole would otherwise hide
+		unsigned int holeIndex = slotIndex;
+		unsigned int nextIndex = ( holeIndex + 1 ) & m_capacityMask;
+		while( m_slots[ nextIndex ].key != EMPTY_KEY )
+		{
+			unsigned int homeIndex = HashEndpointKey( m_slots[ nextIndex ].key ) & m_capacityMask;
+			unsigned int distanceFromHomeToNext = ( nextIndex - homeIndex ) & m_capacityMask;
+			unsigned int distanceFromHomeToHole = ( holeIndex - homeIndex ) & m_capacityMask;
+			if( distanceFromHomeToHole < distanceFromHomeToNext )
+			{
+				m_slots[ holeIndex ] = m_slots[ nextIndex ];
+				holeIndex = nextIndex;
+			}
+			nextIndex = ( nextIndex + 1 ) & m_capacityMask;
+		}
+
+		m_slots[ holeIndex ].key = EMPTY_KEY;
+		m_slots[ holeIndex ].value = ValueType();
+		--m_numberOfEntries;
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	template< typename ValueType >
+	void EndpointTable< ValueType >::Clear()
+	{
+		for( unsigned int i = 0; i <= m_capacityMask; ++i )
+		{
+			m_slots[ i ].key = EMPTY_KEY;
+			m_slots[ i ].value = ValueType();
+		}
+		m_numberOfEntries = 0;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//The 64-bit finalizer from MurmurHash3; spreads nearby addresses and ports across the table.
+	template< typename ValueType >
+	STATIC unsigned int EndpointTable< ValueType >::HashEndpointKey( EndpointKey key )
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return static_cast< unsigned int >( key );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	template< typename ValueType >
+	void EndpointTable< ValueType >::Grow()
+	{
+		Slot* oldSlots = m_slots;
+		unsigned int oldCapacity = m_capacityMask + 1;
+
+		m_slots = new Slot[ oldCapacity * 2 ];
+		m_capacityMask = ( oldCapacity * 2 ) - 1;
+		Clear();
+
+		for( unsigned int i = 0; i < oldCapacity; ++i )
+		{
+			if( oldSlots[ i ].key != EMPTY_KEY )
+				Insert( oldSlots[ i ].key, oldSlots[ i ].value );
+		}
+		delete[] oldSlots;
+	}
+}
+
+#endif //INCLUDED_ENDPOINT_TABLE_HPP
@@ -31,6 +31,11 @@
 #elif defined( _WIN64 )
 	#define ARCHITECTURE_64BIT
 	#define PLATFORM_WINDOWS
+#elif defined( __linux__ )
+	#define PLATFORM_UNIX
+	#define PLATFORM_LINUX
+#elif defined( __unix__ ) || defined( __APPLE__ )
+	#define PLATFORM_UNIX
 #endif
 
 #endif //INCLUDED_ENGINE_MACROS_HPP
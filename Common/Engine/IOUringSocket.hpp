@@ -0,0 +1,630 @@
+#pragma once
+#ifndef INCLUDED_IO_URING_SOCKET_HPP
+#define INCLUDED_IO_URING_SOCKET_HPP
+
+#include "DatagramSocket.hpp"
+
+#if defined( PLATFORM_LINUX )
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+//-----------------------------------------------------------------------------------------------
+namespace Network
+{
+	//-----------------------------------------------------------------------------------------------
+	//A UDP socket driven entirely through io_uring.
+	//	Receives: one multishot recvmsg stays armed on the socket, and the kernel fills buffers from a
+	//		provided-buffer ring, so datagrams arrive without any receive syscalls.
+	//	Sends: each queued datagram becomes a sendmsg SQE; FlushSendQueue submits them all with one io_uring_enter.
+	//Needs Linux 6.0 or newer (provided-buffer rings and multishot recvmsg). Initialize fails on older kernels.
+	class IOUringSocket : public DatagramSocket
+	{
+		static const unsigned int SUBMISSION_QUEUE_ENTRIES = 1024;
+		static const unsigned int COMPLETION_QUEUE_ENTRIES = 4 * SUBMISSION_QUEUE_ENTRIES;
+		static const unsigned int RECEIVE_BUFFER_COUNT = 512; //Must be a power of two
+		static const unsigned int RECEIVE_BUFFER_BYTES = 2048;
+		static const unsigned short RECEIVE_BUFFER_GROUP_ID = 0;
+		static const unsigned int SEND_SLOT_COUNT = 1024;
+		static const unsigned int MAXIMUM_DATAGRAM_BYTES = 1500;
+		static const unsigned long long USER_DATA_Receive = ~0ULL;
+
+	public:
+		IOUringSocket();
+		~IOUringSocket();
+
+		int Initialize();
+		int EnablePortSharing();
+		int Bind( const std::string& address, const std::string& portNumber );
+		int ReceiveBufferBatch( char* buffers, int bufferLength, unsigned int numberOfBuffers, ReceivedDatagram* out_receivedDatagrams );
+		int QueueBufferForSend( const char* buffer, int bufferLength, const sockaddr_in& receiverAddress );
+		int QueueSegmentsForSend( const BufferSegment* segments, unsigned int numberOfSegments, const sockaddr_in& receiverAddress );
+		int FlushSendQueue();
+		int WaitForIncomingData( int timeoutMilliseconds );
+		int SetFunctionsToNonbindingMode();
+		int Cleanup();
+
+		bool IsInitialized() const { return m_isInitialized; }
+		int GetReadinessDescriptor() const { return m_completionEventID; }
+		int GetLastSendErrorCode() const { return m_lastSendErrorCode; }
+
+	private:
+		//A send stays in its slot until the kernel posts its completion.
+		struct SendSlot
+		{
+			msghdr header;
+			iovec ioVector;
+			sockaddr_in receiverAddress;
+			char data[ MAXIMUM_DATAGRAM_BYTES ];
+		};
+
+		int EnterRing( unsigned int minimumCompletions, int timeoutMilliseconds );
+		int ArmMultishotReceive();
+		io_uring_sqe* GetNextSubmissionEntry();
+		void PublishReceiveBuffer( unsigned short bufferID );
+		void ReapCompletions();
+
+		SOCKET m_socketID;
+		int m_ringID;
+		int m_completionEventID; //eventfd the kernel signals whenever it posts a completion
+		bool m_isInitialized;
+
+		//Submission ring
+		void* m_submissionRingMemory;
+		size_t m_submissionRingBytes;
+		unsigned int* m_submissionHead;
+		unsigned int* m_submissionTail;
+		unsigned int* m_submissionArray;
+		unsigned int m_submissionMask;
+		io_uring_sqe* m_submissionEntries;
+		size_t m_submissionEntriesBytes;
+		unsigned int m_localSubmissionTail;
+		unsigned int m_numberOfUnsubmittedEntries;
+
+		//Completion ring
+		void* m_completionRingMemory;
+		size_t m_completionRingBytes;
+		unsigned int* m_completionHead;
+		unsigned int* m_completionTail;
+		unsigned int m_completionMask;
+		io_uring_cqe* m_completionEntries;
+
+		//Provided receive buffers, and the ones the kernel has filled that we haven't handed out yet
+		io_uring_buf_ring* m_receiveBufferRing;
+		size_t m_receiveBufferRingBytes;
+		char* m_receiveBuffers;
+		unsigned short m_receiveBufferRingTail;
+		msghdr m_receiveMessageTemplate;
+		bool m_multishotReceiveIsArmed;
+		unsigned short m_filledReceiveBuffers[ RECEIVE_BUFFER_COUNT ];
+		unsigned int m_filledReceiveBufferLengths[ RECEIVE_BUFFER_COUNT ];
+		unsigned int m_firstFilledReceiveBuffer;
+		unsigned int m_numberOfFilledReceiveBuffers;
+
+		//Sends
+		SendSlot* m_sendSlots;
+		unsigned int m_freeSendSlots[ SEND_SLOT_COUNT ];
+		unsigned int m_numberOfFreeSendSlots;
+		bool m_sendErrorOccurred;
+		int m_lastSendErrorCode; //From the most recent failed send or submission
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	inline IOUringSocket::IOUringSocket()
+		: m_socketID( INVALID_SOCKET )
+		, m_ringID( -1 )
+		, m_completionEventID( -1 )
+		, m_isInitialized( false )
+		, m_submissionRingMemory( nullptr )
+		, m_submissionRingBytes( 0 )
+		, m_submissionEntries( nullptr )
+		, m_submissionEntriesBytes( 0 )
+		, m_localSubmissionTail( 0 )
+		, m_numberOfUnsubmittedEntries( 0 )
+		, m_completionRingMemory( nullptr )
+		, m_completionRingBytes( 0 )
+		, m_receiveBufferRing( nullptr )
+		, m_receiveBufferRingBytes( 0 )
+		, m_receiveBuffers( nullptr )
+		, m_receiveBufferRingTail( 0 )
+		, m_multishotReceiveIsArmed( false )
+		, m_firstFilledReceiveBuffer( 0 )
+		, m_numberOfFilledReceiveBuffers( 0 )
+		, m_sendSlots( nullptr )
+		, m_numberOfFreeSendSlots( 0 )
+		, m_sendErrorOccurred( false )
+		, m_lastSendErrorCode( 0 )
+	{
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline IOUringSocket::~IOUringSocket()
+	{
+		Cleanup();
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline int IOUringSocket::Initialize()
+	{
+		if ( ( m_socketID = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP ) ) == SOCKET_ERROR )
+		{
+			printf( "Failed to initialize socket. Error Code: %d\n", GetLastSocketErrorCode() );
+			return -2;
+		}
+
+		io_uring_params ringParameters;
+		memset( &ringParameters, 0, sizeof( io_uring_params ) );
+		ringParameters.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+		ringParameters.cq_entries = COMPLETION_QUEUE_ENTRIES;
+
+		m_ringID = static_cast< int >( syscall( __NR_io_uring_setup, SUBMISSION_QUEUE_ENTRIES, &ringParameters ) );
+		if( m_ringID < 0 )
+		{
+			printf( "Failed to create io_uring instance. Error Code: %d\n", GetLastSocketErrorCode() );
+			Cleanup();
+			return -3;
+		}
+
+		//Map the submission ring, completion ring, and submission entry array
+		m_submissionRingBytes = ringParameters.sq_off.array + ( ringParameters.sq_entries * sizeof( unsigned int ) );
+		m_completionRingBytes = ringParameters.cq_off.cqes + ( ringParameters.cq_entries * sizeof( io_uring_cqe ) );
+		bool ringsShareMapping = ( ringParameters.features & IORING_FEAT_SINGLE_MMAP ) != 0;
+		if( ringsShareMapping && m_completionRingBytes > m_submissionRingBytes )
+			m_submissionRingBytes = m_completionRingBytes;
+
+		m_submissionRingMemory = mmap( nullptr, m_submissionRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringID, IORING_OFF_SQ_RING );
+		if( m_submissionRingMemory == MAP_FAILED )
+		{
+			m_submissionRingMemory = nullptr;
+			Cleanup();
+			return -4;
+		}
+
+		if( ringsShareMapping )
+		{
+			m_completionRingMemory = m_submissionRingMemory;
+		}
+		else
+		{
+			m_completionRingMemory = mmap( nullptr, m_completionRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringID, IORING_OFF_CQ_RING );
+			if( m_completionRingMemory == MAP_FAILED )
+			{
+				m_completionRingMemory = nullptr;
+				Cleanup();
+				return -4;
+			}
+		}
+
+		m_submissionEntriesBytes = ringParameters.sq_entries * sizeof( io_uring_sqe );
+		void* submissionEntryMemory = mmap( nullptr, m_submissionEntriesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringID, IORING_OFF_SQES );
+		if( submissionEntryMemory == MAP_FAILED )
+		{
+			Cleanup();
+			return -4;
+		}
+		m_submissionEntries = static_cast< io_uring_sqe* >( submissionEntryMemory );
+
+		char* submissionRing = static_cast< char* >( m_submissionRingMemory );
+		m_submissionHead  = reinterpret_cast< unsigned int* >( submissionRing + ringParameters.sq_off.head );
+		m_submissionTail  = reinterpret_cast< unsigned int* >( submissionRing + ringParameters.sq_off.tail );
+		m_submissionArray = reinterpret_cast< unsigned int* >( submissionRing + ringParameters.sq_off.array );
+		m_submissionMask  = *reinterpret_cast< unsigned int* >( submissionRing + ringParameters.sq_off.ring_mask );
+		m_localSubmissionTail = *m_submissionTail;
+
+		char* completionRing = static_cast< char* >( m_completionRingMemory );
+		m_completionHead	= reinterpret_cast< unsigned int* >( completionRing + ringParameters.cq_off.head );
+		m_completionTail	= reinterpret_cast< unsigned int* >( completionRing + ringParameters.cq_off.tail );
+		m_completionMask	= *reinterpret_cast< unsigned int* >( completionRing + ringParameters.cq_off.ring_mask );
+		m_completionEntries = reinterpret_cast< io_uring_cqe* >( completionRing + ringParameters.cq_off.cqes );
+
+		//Register the provided-buffer ring the multishot receive pulls from
+		m_receiveBufferRingBytes = RECEIVE_BUFFER_COUNT * sizeof( io_uring_buf );
+		void* bufferRingMemory = mmap( nullptr, m_receiveBufferRingBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+		if( bufferRingMemory == MAP_FAILED )
+		{
+			Cleanup();
+			return -5;
+		}
+		m_receiveBufferRing = static_cast< io_uring_buf_ring* >( bufferRingMemory );
+		m_receiveBuffers = new char[ RECEIVE_BUFFER_COUNT * RECEIVE_BUFFER_BYTES ];
+
+		io_uring_buf_reg bufferRingRegistration;
+		memset( &bufferRingRegistration, 0, sizeof( io_uring_buf_reg ) );
+		bufferRingRegistration.ring_addr = reinterpret_cast< unsigned long long >( m_receiveBufferRing );
+		bufferRingRegistration.ring_entries = RECEIVE_BUFFER_COUNT;
+		bufferRingRegistration.bgid = RECEIVE_BUFFER_GROUP_ID;
+		if( syscall( __NR_io_uring_register, m_ringID, IORING_REGISTER_PBUF_RING, &bufferRingRegistration, 1 ) < 0 )
+		{
+			printf( "Failed to register io_uring receive buffers. Error Code: %d\n", GetLastSocketErrorCode() );
+			Cleanup();
+			return -6;
+		}
+
+		m_receiveBufferRingTail = 0;
+		for( unsigned short i = 0; i < RECEIVE_BUFFER_COUNT; ++i )
+		{
+			PublishReceiveBuffer( i );
+		}
+		__atomic_store_n( &m_receiveBufferRing->tail, m_receiveBufferRingTail, __ATOMIC_RELEASE );
+
+		//The kernel lays out each received datagram as io_uring_recvmsg_out, then the address, then the payload
+		memset( &m_receiveMessageTemplate, 0, sizeof( msghdr ) );
+		m_receiveMessageTemplate.msg_namelen = sizeof( sockaddr_in );
+
+		m_sendSlots = new SendSlot[ SEND_SLOT_COUNT ];
+		for( unsigned int i = 0; i < SEND_SLOT_COUNT; ++i )
+		{
+			m_freeSendSlots[ i ] = SEND_SLOT_COUNT - 1 - i;
+		}
+		m_numberOfFreeSendSlots = SEND_SLOT_COUNT;
+
+		//Lets an event loop sleep in epoll until the ring has something for us
+		m_completionEventID = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+		if( m_completionEventID < 0 || syscall( __NR_io_uring_register, m_ringID, IORING_REGISTER_EVENTFD, &m_completionEventID, 1 ) < 0 )
+		{
+			printf( "Failed to register io_uring completion event. Error Code: %d\n", GetLastSocketErrorCode() );
+			Cleanup();
+			return -7;
+		}
+
+		m_isInitialized = true;
+		return 0;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Lets several sockets (and rings) bind the same port; must be called before Bind.
+	inline int IOUringSocket::EnablePortSharing()
+	{
+		int optionValue = 1;
+		return setsockopt( m_socketID, SOL_SOCKET, SO_REUSEPORT, &optionValue, sizeof( optionValue ) );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline int IOUringSocket::Bind( const std::string& address, const std::string& portNumber )
+	{
+		sockaddr_in socketAddress;
+		memset( &socketAddress, 0, sizeof( sockaddr_in ) );
+		socketAddress.sin_family = AF_INET;
+		socketAddress.sin_port = htons( (unsigned short)strtoul( portNumber.c_str(), 0, 0 ) );
+
+		if( address.compare( "0.0.0.0" ) == 0 )
+			socketAddress.sin_addr.s_addr = INADDR_ANY;
+		else
+			socketAddress.sin_addr.s_addr = inet_addr( address.c_str() );
+
+		int bindingResult = bind( m_socketID, (struct sockaddr *) &socketAddress, sizeof( sockaddr_in ) );
+		if( bindingResult < 0 )
+			return bindingResult;
+
+		return ArmMultishotReceive();
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Hands out datagrams the kernel has already written into provided buffers. The only syscalls are
+	//	clearing the completion event and, when needed, re-arming the multishot receive.
+	inline int IOUringSocket::ReceiveBufferBatch( char* buffers, int bufferLength, unsigned int numberOfBuffers, ReceivedDatagram* out_receivedDatagrams )
+	{
+		//Clear the completion event before reaping, so anything posted after this point signals it again
+		eventfd_t numberOfSignals = 0;
+		if( m_completionEventID >= 0 )
+			eventfd_read( m_completionEventID, &numberOfSignals );
+
+		ReapCompletions();
+
+		unsigned int numberOfDatagrams = 0;
+		while( numberOfDatagrams < numberOfBuffers && m_numberOfFilledReceiveBuffers > 0 )
+		{
+			unsigned short bufferID = m_filledReceiveBuffers[ m_firstFilledReceiveBuffer ];
+			unsigned int bufferBytesUsed = m_filledReceiveBufferLengths[ m_firstFilledReceiveBuffer ];
+			m_firstFilledReceiveBuffer = ( m_firstFilledReceiveBuffer + 1 ) & ( RECEIVE_BUFFER_COUNT - 1 );
+			--m_numberOfFilledReceiveBuffers;
+
+			const char* receiveBuffer = m_receiveBuffers + ( bufferID * RECEIVE_BUFFER_BYTES );
+			const io_uring_recvmsg_out* messageInfo = reinterpret_cast< const io_uring_recvmsg_out* >( receiveBuffer );
+			const char* senderAddress = receiveBuffer + sizeof( io_uring_recvmsg_out );
+			const char* payload = senderAddress + m_receiveMessageTemplate.msg_namelen + m_receiveMessageTemplate.msg_controllen;
+
+			unsigned int payloadBytesInBuffer = bufferBytesUsed - static_cast< unsigned int >( payload - receiveBuffer );
+			unsigned int payloadBytes = ( messageInfo->payloadlen < payloadBytesInBuffer ) ? messageInfo->payloadlen : payloadBytesInBuffer;
+			if( payloadBytes > static_cast< unsigned int >( bufferLength ) )
+				payloadBytes = static_cast< unsigned int >( bufferLength );
+
+			ReceivedDatagram& datagram = out_receivedDatagrams[ numberOfDatagrams ];
+			memcpy( &datagram.senderAddress, senderAddress, sizeof( sockaddr_in ) );
+			memcpy( buffers + ( numberOfDatagrams * bufferLength ), payload, payloadBytes );
+			datagram.numberOfBytes = static_cast< int >( payloadBytes );
+			++numberOfDatagrams;
+
+			PublishReceiveBuffer( bufferID );
+		}
+
+		if( numberOfDatagrams > 0 )
+			__atomic_store_n( &m_receiveBufferRing->tail, m_receiveBufferRingTail, __ATOMIC_RELEASE );
+
+		if( !m_multishotReceiveIsArmed && ArmMultishotReceive() < 0 )
+			return -1;
+
+		return static_cast< int >( numberOfDatagrams );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Copies the datagram into a send slot and prepares its SQE. Nothing is submitted until FlushSendQueue.
+	inline int IOUringSocket::QueueBufferForSend( const char* buffer, int bufferLength, const sockaddr_in& receiverAddress )
+	{
+		if( bufferLength <= 0 )
+			return -1;
+
+		BufferSegment wholeDatagram;
+		wholeDatagram.bytes = buffer;
+		wholeDatagram.numberOfBytes = static_cast< unsigned int >( bufferLength );
+		return QueueSegmentsForSend( &wholeDatagram, 1, receiverAddress );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Gathers the segments into a send slot. Unlike UDPSocket this copies, since the kernel reads
+	//	the slot whenever the send completes, long after the caller has moved on.
+	inline int IOUringSocket::QueueSegmentsForSend( const BufferSegment* segments, unsigned int numberOfSegments, const sockaddr_in& receiverAddress )
+	{
+		unsigned int bufferLength = 0;
+		for( unsigned int i = 0; i < numberOfSegments; ++i )
+		{
+			bufferLength += segments[ i ].numberOfBytes;
+		}
+		if( bufferLength == 0 || bufferLength > MAXIMUM_DATAGRAM_BYTES )
+			return -1;
+
+		if( m_numberOfFreeSendSlots == 0 )
+		{
+			//Every slot is still in flight; push what we have and collect finished sends.
+			EnterRing( 1, 0 );
+			ReapCompletions();
+			if( m_numberOfFreeSendSlots == 0 )
+				return 0; //Dropped, same as a full socket buffer would
+		}
+
+		--m_numberOfFreeSendSlots;
+		unsigned int slotIndex = m_freeSendSlots[ m_numberOfFreeSendSlots ];
+		SendSlot& slot = m_sendSlots[ slotIndex ];
+
+		unsigned int gatheredBytes = 0;
+		for( unsigned int i = 0; i < numberOfSegments; ++i )
+		{
+			memcpy( slot.data + gatheredBytes, segments[ i ].bytes, segments[ i ].numberOfBytes );
+			gatheredBytes += segments[ i ].numberOfBytes;
+		}
+		slot.receiverAddress = receiverAddress;
+		slot.ioVector.iov_base = slot.data;
+		slot.ioVector.iov_len = bufferLength;
+		memset( &slot.header, 0, sizeof( msghdr ) );
+		slot.header.msg_name = &slot.receiverAddress;
+		slot.header.msg_namelen = sizeof( sockaddr_in );
+		slot.header.msg_iov = &slot.ioVector;
+		slot.header.msg_iovlen = 1;
+
+		io_uring_sqe* sendEntry = GetNextSubmissionEntry();
+		sendEntry->opcode = IORING_OP_SENDMSG;
+		sendEntry->fd = m_socketID;
+		sendEntry->addr = reinterpret_cast< unsigned long long >( &slot.header );
+		sendEntry->len = 1;
+		sendEntry->user_data = slotIndex;
+		return 0;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Submits every queued send with one io_uring_enter. Returns a negative value if the submission
+	//	or any earlier send failed (GetLastSendErrorCode says why).
+	inline int IOUringSocket::FlushSendQueue()
+	{
+		unsigned int numberOfEntriesToSubmit = m_numberOfUnsubmittedEntries;
+		if( numberOfEntriesToSubmit > 0 && EnterRing( 0, 0 ) < 0 )
+		{
+			m_lastSendErrorCode = GetLastSocketErrorCode();
+			return -1;
+		}
+
+		ReapCompletions();
+		if( m_sendErrorOccurred )
+		{
+			m_sendErrorOccurred = false;
+			return -1;
+		}
+		return static_cast< int >( numberOfEntriesToSubmit );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Sleeps in io_uring_enter until a completion arrives or the timeout passes (-1 waits forever).
+	//Returns the number of datagrams waiting to be handed out.
+	inline int IOUringSocket::WaitForIncomingData( int timeoutMilliseconds )
+	{
+		ReapCompletions();
+		if( m_numberOfFilledReceiveBuffers == 0 )
+		{
+			if( EnterRing( 1, timeoutMilliseconds ) < 0 && GetLastSocketErrorCode() != ETIME && GetLastSocketErrorCode() != EINTR )
+				return -1;
+			ReapCompletions();
+		}
+		return static_cast< int >( m_numberOfFilledReceiveBuffers );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline int IOUringSocket::SetFunctionsToNonbindingMode()
+	{
+		//io_uring never blocks the caller, but keep the socket itself consistent with UDPSocket.
+		int socketFlags = fcntl( m_socketID, F_GETFL, 0 );
+		if( socketFlags < 0 )
+			return socketFlags;
+
+		return fcntl( m_socketID, F_SETFL, socketFlags | O_NONBLOCK );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline int IOUringSocket::Cleanup()
+	{
+		if( m_ringID >= 0 )
+			close( m_ringID ); //Closing the ring cancels the multishot receive and any sends in flight
+		m_ringID = -1;
+
+		if( m_completionEventID >= 0 )
+			close( m_completionEventID );
+		m_completionEventID = -1;
+
+		if( m_submissionEntries != nullptr )
+			munmap( m_submissionEntries, m_submissionEntriesBytes );
+		if( m_completionRingMemory != nullptr && m_completionRingMemory != m_submissionRingMemory )
+			munmap( m_completionRingMemory, m_completionRingBytes );
+		if( m_submissionRingMemory != nullptr )
+			munmap( m_submissionRingMemory, m_submissionRingBytes );
+		if( m_receiveBufferRing != nullptr )
+			munmap( m_receiveBufferRing, m_receiveBufferRingBytes );
+		m_submissionEntries = nullptr;
+		m_completionRingMemory = nullptr;
+		m_submissionRingMemory = nullptr;
+		m_receiveBufferRing = nullptr;
+
+		delete[] m_receiveBuffers;
+		m_receiveBuffers = nullptr;
+		delete[] m_sendSlots;
+		m_sendSlots = nullptr;
+
+		if( m_socketID != INVALID_SOCKET )
+			close( m_socketID );
+		m_socketID = INVALID_SOCKET;
+
+		m_multishotReceiveIsArmed = false;
+		m_isInitialized = false;
+		return 0;
+	}
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	inline int IOUringSocket::EnterRing( unsigned int minimumCompletions, int timeoutMilliseconds )
+	{
+		__atomic_store_n( m_submissionTail, m_localSubmissionTail, __ATOMIC_RELEASE );
+
+		unsigned int enterFlags = 0;
+		io_uring_getevents_arg waitArguments;
+		__kernel_timespec waitTimeout;
+		void* enterArgument = nullptr;
+		size_t enterArgumentSize = 0;
+		if( minimumCompletions > 0 )
+		{
+			enterFlags |= IORING_ENTER_GETEVENTS;
+			if( timeoutMilliseconds >= 0 )
+			{
+				waitTimeout.tv_sec = timeoutMilliseconds / 1000;
+				waitTimeout.tv_nsec = ( timeoutMilliseconds % 1000 ) * 1000000LL;
+
+				memset( &waitArguments, 0, sizeof( io_uring_getevents_arg ) );
+				waitArguments.ts = reinterpret_cast< unsigned long long >( &waitTimeout );
+				enterFlags |= IORING_ENTER_EXT_ARG;
+				enterArgument = &waitArguments;
+				enterArgumentSize = sizeof( io_uring_getevents_arg );
+			}
+		}
+
+		int enterResult = static_cast< int >( syscall( __NR_io_uring_enter, m_ringID, m_numberOfUnsubmittedEntries, minimumCompletions, enterFlags, enterArgument, enterArgumentSize ) );
+		if( enterResult > 0 )
+			m_numberOfUnsubmittedEntries -= static_cast< unsigned int >( enterResult );
+		return enterResult;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline int IOUringSocket::ArmMultishotReceive()
+	{
+		io_uring_sqe* receiveEntry = GetNextSubmissionEntry();
+		receiveEntry->opcode = IORING_OP_RECVMSG;
+		receiveEntry->fd = m_socketID;
+		receiveEntry->addr = reinterpret_cast< unsigned long long >( &m_receiveMessageTemplate );
+		receiveEntry->len = 1;
+		receiveEntry->flags = IOSQE_BUFFER_SELECT;
+		receiveEntry->buf_group = RECEIVE_BUFFER_GROUP_ID;
+		receiveEntry->ioprio = IORING_RECV_MULTISHOT;
+		receiveEntry->user_data = USER_DATA_Receive;
+
+		if( EnterRing( 0, 0 ) < 0 )
+			return -1;
+
+		m_multishotReceiveIsArmed = true;
+		return 0;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline io_uring_sqe* IOUringSocket::GetNextSubmissionEntry()
+	{
+		unsigned int submissionHead = __atomic_load_n( m_submissionHead, __ATOMIC_ACQUIRE );
+		if( m_localSubmissionTail - submissionHead > m_submissionMask )
+			EnterRing( 0, 0 ); //The ring is full, so hand what's there to the kernel first
+
+		unsigned int entryIndex = m_localSubmissionTail & m_submissionMask;
+		io_uring_sqe* submissionEntry = &m_submissionEntries[ entryIndex ];
+		memset( submissionEntry, 0, sizeof( io_uring_sqe ) );
+		m_submissionArray[ entryIndex ] = entryIndex;
+
+		++m_localSubmissionTail;
+		++m_numberOfUnsubmittedEntries;
+		return submissionEntry;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Returns a receive buffer to the kernel. The caller publishes the new ring tail once per batch.
+	inline void IOUringSocket::PublishReceiveBuffer( unsigned short bufferID )
+	{
+		//Index the ring as a plain array: in C++ the header's flexible 'bufs' member does not start at offset 0.
+		io_uring_buf* ringEntries = reinterpret_cast< io_uring_buf* >( m_receiveBufferRing );
+		io_uring_buf& ringEntry = ringEntries[ m_receiveBufferRingTail & ( RECEIVE_BUFFER_COUNT - 1 ) ];
+		ringEntry.addr = reinterpret_cast< unsigned long long >( m_receiveBuffers + ( bufferID * RECEIVE_BUFFER_BYTES ) );
+		ringEntry.len = RECEIVE_BUFFER_BYTES;
+		ringEntry.bid = bufferID;
+		++m_receiveBufferRingTail;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Drains the completion ring: finished sends free their slots, received datagrams wait for ReceiveBufferBatch.
+	inline void IOUringSocket::ReapCompletions()
+	{
+		unsigned int completionHead = *m_completionHead;
+		unsigned int completionTail = __atomic_load_n( m_completionTail, __ATOMIC_ACQUIRE );
+
+		while( completionHead != completionTail )
+		{
+			const io_uring_cqe& completion = m_completionEntries[ completionHead & m_completionMask ];
+			++completionHead;
+
+			if( completion.user_data != USER_DATA_Receive )
+			{
+				if( completion.res < 0 && completion.res != -EAGAIN )
+				{
+					m_sendErrorOccurred = true;
+					m_lastSendErrorCode = -completion.res;
+				}
+
+				m_freeSendSlots[ m_numberOfFreeSendSlots ] = static_cast< unsigned int >( completion.user_data );
+				++m_numberOfFreeSendSlots;
+				continue;
+			}
+
+			if( ( completion.flags & IORING_CQE_F_MORE ) == 0 )
+				m_multishotReceiveIsArmed = false; //Usually -ENOBUFS; re-armed after buffers are handed back
+
+			if( completion.res < 0 || ( completion.flags & IORING_CQE_F_BUFFER ) == 0 )
+				continue;
+
+			unsigned int filledIndex = ( m_firstFilledReceiveBuffer + m_numberOfFilledReceiveBuffers ) & ( RECEIVE_BUFFER_COUNT - 1 );
+			m_filledReceiveBuffers[ filledIndex ] = static_cast< unsigned short >( completion.flags >> IORING_CQE_BUFFER_SHIFT );
+			m_filledReceiveBufferLengths[ filledIndex ] = static_cast< unsigned int >( completion.res );
+			++m_numberOfFilledReceiveBuffers;
+		}
+
+		__atomic_store_n( m_completionHead, completionHead, __ATOMIC_RELEASE );
+	}
+}
+
+#endif //PLATFORM_LINUX
+#endif //INCLUDED_IO_URING_SOCKET_HPP
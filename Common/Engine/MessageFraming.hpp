@@ -0,0 +1,287 @@
+#pragma once
+#ifndef INCLUDED_MESSAGE_FRAMING_HPP
+#define INCLUDED_MESSAGE_FRAMING_HPP
+
+#include <string.h>
+#include <vector>
+#include "DatagramSocket.hpp"
+
+//-----------------------------------------------------------------------------------------------
+//A datagram carries any number of messages, each framed as a 2-byte big-endian length followed by that many bytes.
+namespace Network
+{
+	static const unsigned int MAXIMUM_DATAGRAM_PAYLOAD_BYTES = 1200; //Fits the 1280-byte IPv6 minimum MTU after IP/UDP headers
+	static const unsigned int MESSAGE_LENGTH_PREFIX_BYTES = 2;
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//Packs messages for one receiver into as few datagrams as possible. Messages never span datagrams.
+	//A message can borrow its body from shared memory (see SharedMessageArena), so a payload going to
+	//	a whole room is written once and each receiver's datagram only points at it.
+	class OutgoingMessageBuffer
+	{
+	public:
+		OutgoingMessageBuffer() { }
+
+		bool AppendMessage( const char* message, unsigned int numberOfBytes );
+		bool AppendMessageWithSharedBody( const char* header, unsigned int headerBytes, const char* sharedBody, unsigned int bodyBytes );
+		void Clear();
+
+		unsigned int GetNumberOfDatagrams() const { return static_cast< unsigned int >( m_datagrams.size() ); }
+		void GetDatagramSegments( unsigned int datagramIndex, std::vector< BufferSegment >& out_segments ) const;
+		bool IsEmpty() const { return m_datagrams.empty(); }
+
+	private:
+		//Either a stretch of m_ownedBytes (sharedBytes is null) or borrowed memory that must outlive the flush
+		struct OutgoingSegment
+		{
+			const char* sharedBytes;
+			unsigned int ownedOffset;
+			unsigned int numberOfBytes;
+		};
+
+		struct OutgoingDatagram
+		{
+			unsigned int firstSegment;
+			unsigned int numberOfSegments;
+			unsigned int numberOfBytes;
+		};
+
+		void AppendOwnedBytes( const char* bytes, unsigned int numberOfBytes );
+		void AppendSharedBytes( const char* bytes, unsigned int numberOfBytes );
+
+		std::vector< char > m_ownedBytes;
+		std::vector< OutgoingSegment > m_segments;
+		std::vector< OutgoingDatagram > m_datagrams;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//Bump allocator for message bodies shared by many OutgoingMessageBuffers. Blocks never move,
+	//	so pointers stay good until Reset, which the owner calls once every buffer pointing here is flushed.
+	class SharedMessageArena
+	{
+	public:
+		static const unsigned int BLOCK_BYTES = 16384;
+
+		SharedMessageArena() : m_currentBlock( 0 ), m_bytesUsedInCurrentBlock( 0 ) { }
+		~SharedMessageArena();
+
+		char* Allocate( unsigned int numberOfBytes );
+		void Reset() { m_currentBlock = 0; m_bytesUsedInCurrentBlock = 0; }
+
+	private:
+		SharedMessageArena( const SharedMessageArena& );
+		SharedMessageArena& operator=( const SharedMessageArena& );
+
+		std::vector< char* > m_blocks;
+		unsigned int m_currentBlock;
+		unsigned int m_bytesUsedInCurrentBlock;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//Walks the messages in one received datagram. Stops at the first frame that runs past the end.
+	class IncomingMessageReader
+	{
+	public:
+		IncomingMessageReader( const char* datagram, int numberOfBytes );
+
+		bool ReadNextMessage( const char*& out_message, unsigned int& out_numberOfBytes );
+		bool IsMalformed() const { return m_isMalformed; }
+
+	private:
+		const char* m_datagram;
+		unsigned int m_numberOfBytes;
+		unsigned int m_readOffset;
+		bool m_isMalformed;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//Returns false if the message is too big to fit in any datagram.
+	inline bool OutgoingMessageBuffer::AppendMessage( const char* message, unsigned int numberOfBytes )
+	{
+		return AppendMessageWithSharedBody( message, numberOfBytes, nullptr, 0 );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Frames header + sharedBody as one message. The header is copied; the body is only pointed at,
+	//	so it has to stay untouched until this buffer has been sent and cleared.
+	//Returns false if the message is too big to fit in any datagram.
+	inline bool OutgoingMessageBuffer::AppendMessageWithSharedBody( const char* header, unsigned int headerBytes, const char* sharedBody, unsigned int bodyBytes )
+	{
+		unsigned int messageBytes = headerBytes + bodyBytes;
+		unsigned int framedBytes = MESSAGE_LENGTH_PREFIX_BYTES + messageBytes;
+		if( framedBytes > MAXIMUM_DATAGRAM_PAYLOAD_BYTES )
+			return false;
+
+		if( m_datagrams.empty() || m_datagrams.back().numberOfBytes + framedBytes > MAXIMUM_DATAGRAM_PAYLOAD_BYTES )
+		{
+			OutgoingDatagram newDatagram;
+			newDatagram.firstSegment = static_cast< unsigned int >( m_segments.size() );
+			newDatagram.numberOfSegments = 0;
+			newDatagram.numberOfBytes = 0;
+			m_datagrams.push_back( newDatagram );
+		}
+
+		char lengthPrefix[ MESSAGE_LENGTH_PREFIX_BYTES ];
+		lengthPrefix[ 0 ] = static_cast< char >( ( messageBytes >> 8 ) & 0xFF );
+		lengthPrefix[ 1 ] = static_cast< char >( messageBytes & 0xFF );
+		AppendOwnedBytes( lengthPrefix, MESSAGE_LENGTH_PREFIX_BYTES );
+		AppendOwnedBytes( header, headerBytes );
+		AppendSharedBytes( sharedBody, bodyBytes );
+
+		m_datagrams.back().numberOfBytes += framedBytes;
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Keeps the allocations so a steady stream of messages stops allocating after the first few ticks.
+	inline void OutgoingMessageBuffer::Clear()
+	{
+		m_ownedBytes.clear();
+		m_segments.clear();
+		m_datagrams.clear();
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Fills out_segments with the pieces of one datagram, in order, ready for DatagramSocket::QueueSegmentsForSend.
+	//The pieces point into this buffer, so it must not be appended to or cleared until they have been sent.
+	inline void OutgoingMessageBuffer::GetDatagramSegments( unsigned int datagramIndex, std::vector< BufferSegment >& out_segments ) const
+	{
+		out_segments.clear();
+
+		const OutgoingDatagram& datagram = m_datagrams[ datagramIndex ];
+		for( unsigned int i = 0; i < datagram.numberOfSegments; ++i )
+		{
+			const OutgoingSegment& segment = m_segments[ datagram.firstSegment + i ];
+
+			BufferSegment outgoingSegment;
+			outgoingSegment.bytes = ( segment.sharedBytes != nullptr ) ? segment.sharedBytes : &m_ownedBytes[ segment.ownedOffset ];
+			outgoingSegment.numberOfBytes = segment.numberOfBytes;
+			out_segments.push_back( outgoingSegment );
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Owned bytes that follow each other in the same datagram stay one segment.
+	inline void OutgoingMessageBuffer::AppendOwnedBytes( const char* bytes, unsigned int numberOfBytes )
+	{
+		if( numberOfBytes == 0 )
+			return;
+
+		unsigned int ownedOffset = static_cast< unsigned int >( m_ownedBytes.size() );
+		m_ownedBytes.insert( m_ownedBytes.end(), bytes, bytes + numberOfBytes );
+
+		OutgoingDatagram& datagram = m_datagrams.back();
+		if( datagram.numberOfSegments > 0 )
+		{
+			OutgoingSegment& lastSegment = m_segments.back();
+			if( lastSegment.sharedBytes == nullptr && lastSegment.ownedOffset + lastSegment.numberOfBytes == ownedOffset )
+			{
+				lastSegment.numberOfBytes += numberOfBytes;
+				return;
+			}
+		}
+
+		OutgoingSegment newSegment;
+		newSegment.sharedBytes = nullptr;
+		newSegment.ownedOffset = ownedOffset;
+		newSegment.numberOfBytes = numberOfBytes;
+		m_segments.push_back( newSegment );
+		++datagram.numberOfSegments;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline void OutgoingMessageBuffer::AppendSharedBytes( const char* bytes, unsigned int numberOfBytes )
+	{
+		if( numberOfBytes == 0 )
+			return;
+
+		OutgoingSegment newSegment;
+		newSegment.sharedBytes = bytes;
+		newSegment.ownedOffset = 0;
+		newSegment.numberOfBytes = numberOfBytes;
+		m_segments.push_back( newSegment );
+		++m_datagrams.back().numberOfSegments;
+	}
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	inline SharedMessageArena::~SharedMessageArena()
+	{
+		for( unsigned int i = 0; i < m_blocks.size(); ++i )
+		{
+			delete[] m_blocks[ i ];
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Returns null if numberOfBytes is bigger than a block.
+	inline char* SharedMessageArena::Allocate( unsigned int numberOfBytes )
+	{
+		if( numberOfBytes > BLOCK_BYTES )
+			return nullptr;
+
+		if( m_blocks.empty() )
+			m_blocks.push_back( new char[ BLOCK_BYTES ] );
+
+		if( m_bytesUsedInCurrentBlock + numberOfBytes > BLOCK_BYTES )
+		{
+			++m_currentBlock;
+			m_bytesUsedInCurrentBlock = 0;
+			if( m_currentBlock == m_blocks.size() )
+				m_blocks.push_back( new char[ BLOCK_BYTES ] );
+		}
+
+		char* allocatedBytes = m_blocks[ m_currentBlock ] + m_bytesUsedInCurrentBlock;
+		m_bytesUsedInCurrentBlock += numberOfBytes;
+		return allocatedBytes;
+	}
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	inline IncomingMessageReader::IncomingMessageReader( const char* datagram, int numberOfBytes )
+		: m_datagram( datagram )
+		, m_numberOfBytes( ( numberOfBytes > 0 ) ? static_cast< unsigned int >( numberOfBytes ) : 0 )
+		, m_readOffset( 0 )
+		, m_isMalformed( false )
+	{
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Returns false once the datagram is used up, or if the next frame is truncated (see IsMalformed).
+	inline bool IncomingMessageReader::ReadNextMessage( const char*& out_message, unsigned int& out_numberOfBytes )
+	{
+		if( m_isMalformed || m_readOffset == m_numberOfBytes )
+			return false;
+
+		if( m_readOffset + MESSAGE_LENGTH_PREFIX_BYTES > m_numberOfBytes )
+		{
+			m_isMalformed = true;
+			return false;
+		}
+
+		const unsigned char* lengthPrefix = reinterpret_cast< const unsigned char* >( m_datagram + m_readOffset );
+		unsigned int messageBytes = ( static_cast< unsigned int >( lengthPrefix[ 0 ] ) << 8 ) | lengthPrefix[ 1 ];
+		if( m_readOffset + MESSAGE_LENGTH_PREFIX_BYTES + messageBytes > m_numberOfBytes )
+		{
+			m_isMalformed = true;
+			return false;
+		}
+
+		out_message = m_datagram + m_readOffset + MESSAGE_LENGTH_PREFIX_BYTES;
+		out_numberOfBytes = messageBytes;
+		m_readOffset += MESSAGE_LENGTH_PREFIX_BYTES + messageBytes;
+		return true;
+	}
+}
+
+#endif //INCLUDED_MESSAGE_FRAMING_HPP
@@ -0,0 +1,97 @@
+#pragma once
+#ifndef INCLUDED_ROUND_TRIP_ESTIMATOR_HPP
+#define INCLUDED_ROUND_TRIP_ESTIMATOR_HPP
+
+#include <math.h>
+
+//-----------------------------------------------------------------------------------------------
+//Smoothed round-trip time and its variance, updated from each acknowledged packet the way TCP does it
+//	(RFC 6298): the retransmission timeout is the smoothed time plus four times the variance.
+namespace Network
+{
+	static const double INITIAL_RETRANSMISSION_TIMEOUT_SECONDS = 1.0; //Until the first sample arrives
+	static const double MINIMUM_RETRANSMISSION_TIMEOUT_SECONDS = 0.1; //A few ticks, so an ack waiting for the next packet isn't counted as lost
+	static const double MAXIMUM_RETRANSMISSION_TIMEOUT_SECONDS = 4.0; //Also caps backoff; shorter than the server's client timeout
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	class RoundTripEstimator
+	{
+	public:
+		RoundTripEstimator() { Reset(); }
+
+		void AddSample( double roundTripSeconds );
+		double GetBackedOffTimeoutSeconds( unsigned int numberOfResends ) const;
+		double GetRetransmissionTimeoutSeconds() const;
+		double GetSmoothedSeconds() const { return m_smoothedSeconds; }
+		double GetVarianceSeconds() const { return m_varianceSeconds; }
+		bool HasSample() const { return m_hasSample; }
+		void Reset();
+
+	private:
+		double m_smoothedSeconds;
+		double m_varianceSeconds;
+		bool m_hasSample;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	//Only feed this packets that were sent once; an ack for a resent packet could be for either copy.
+	inline void RoundTripEstimator::AddSample( double roundTripSeconds )
+	{
+		if( !( roundTripSeconds >= 0.0 ) ) //Also catches NaN
+			return;
+
+		if( !m_hasSample )
+		{
+			m_smoothedSeconds = roundTripSeconds;
+			m_varianceSeconds = roundTripSeconds * 0.5;
+			m_hasSample = true;
+			return;
+		}
+
+		m_varianceSeconds = 0.75 * m_varianceSeconds + 0.25 * fabs( m_smoothedSeconds - roundTripSeconds );
+		m_smoothedSeconds = 0.875 * m_smoothedSeconds + 0.125 * roundTripSeconds;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//The timeout doubles with each resend of the same packet, up to the maximum.
+	inline double RoundTripEstimator::GetBackedOffTimeoutSeconds( unsigned int numberOfResends ) const
+	{
+		double timeoutSeconds = GetRetransmissionTimeoutSeconds();
+		for( unsigned int i = 0; i < numberOfResends && timeoutSeconds < MAXIMUM_RETRANSMISSION_TIMEOUT_SECONDS; ++i )
+		{
+			timeoutSeconds *= 2.0;
+		}
+
+		if( timeoutSeconds > MAXIMUM_RETRANSMISSION_TIMEOUT_SECONDS )
+			timeoutSeconds = MAXIMUM_RETRANSMISSION_TIMEOUT_SECONDS;
+		return timeoutSeconds;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline double RoundTripEstimator::GetRetransmissionTimeoutSeconds() const
+	{
+		if( !m_hasSample )
+			return INITIAL_RETRANSMISSION_TIMEOUT_SECONDS;
+
+		double timeoutSeconds = m_smoothedSeconds + 4.0 * m_varianceSeconds;
+		if( timeoutSeconds < MINIMUM_RETRANSMISSION_TIMEOUT_SECONDS )
+			return MINIMUM_RETRANSMISSION_TIMEOUT_SECONDS;
+		if( timeoutSeconds > MAXIMUM_RETRANSMISSION_TIMEOUT_SECONDS )
+			return MAXIMUM_RETRANSMISSION_TIMEOUT_SECONDS;
+		return timeoutSeconds;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline void RoundTripEstimator::Reset()
+	{
+		m_smoothedSeconds = 0.0;
+		m_varianceSeconds = 0.0;
+		m_hasSample = false;
+	}
+}
+
+#endif //INCLUDED_ROUND_TRIP_ESTIMATOR_HPP
@@ -2,11 +2,27 @@
 #ifndef INCLUDED_SOCKET_HPP
 #define INCLUDED_SOCKET_HPP
 
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#pragma comment( lib, "Ws2_32.lib" )
+#include <string>
+#include "EngineMacros.hpp"
 
-#define ABSTRACT
+#if defined( PLATFORM_WINDOWS )
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+	#pragma comment( lib, "Ws2_32.lib" )
+#elif defined( PLATFORM_UNIX )
+	#include <arpa/inet.h>
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <netdb.h>
+	#include <netinet/in.h>
+	#include <sys/ioctl.h>
+	#include <sys/socket.h>
+	#include <unistd.h>
+
+	typedef int SOCKET;
+	static const SOCKET INVALID_SOCKET = -1;
+	static const int SOCKET_ERROR = -1;
+#endif
 
 //-----------------------------------------------------------------------------------------------
 namespace Network
@@ -26,6 +42,28 @@ namespace Network
 		PROTOCOL_UDP = 1
 	};
 
+	//-----------------------------------------------------------------------------------------------
+	inline int GetLastSocketErrorCode()
+	{
+	#if defined( PLATFORM_WINDOWS )
+		return WSAGetLastError();
+	#else
+		return errno;
+	#endif
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline bool SocketErrorMeansQueueIsEmpty( int errorCode )
+	{
+	#if defined( PLATFORM_WINDOWS )
+		return errorCode == WSAEWOULDBLOCK;
+	#else
+		return errorCode == EAGAIN || errorCode == EWOULDBLOCK;
+	#endif
+	}
+
+
+
 	//-----------------------------------------------------------------------------------------------
 	ABSTRACT class Socket
 	{
@@ -41,7 +79,9 @@ namespace Network
 	protected:
 		addrinfo* m_addressInfo;
 		SOCKET m_windowsSocket;
+	#if defined( PLATFORM_WINDOWS )
 		WSADATA m_winsockData;
+	#endif
 		bool m_isInitialized;
 	};
 
@@ -34,4 +34,24 @@ void InitializeTimer()
 	g_secondsPerCount = 1.0 / static_cast< double >( countsPerSecond.QuadPart );
 }
 #pragma endregion
+#else //_WIN32
+#pragma region POSIX Time Functions
+#include <time.h>
+
+//----------------------------------------------------------------------------------------------------
+double GetCurrentTimeSeconds()
+{
+	timespec monotonicTime;
+	clock_gettime( CLOCK_MONOTONIC, &monotonicTime );
+
+	double timeSeconds = static_cast< double >( monotonicTime.tv_sec ) + ( static_cast< double >( monotonicTime.tv_nsec ) * 1.0e-9 );
+	return timeSeconds;
+}
+
+//----------------------------------------------------------------------------------------------------
+void InitializeTimer()
+{
+	//CLOCK_MONOTONIC needs no calibration.
+}
+#pragma endregion
 #endif //_WIN32
@@ -2,26 +2,69 @@
 #ifndef INCLUDED_UDP_SOCKET_HPP
 #define INCLUDED_UDP_SOCKET_HPP
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
-#include "Socket.hpp"
+#include "DatagramSocket.hpp"
+
+#if defined( PLATFORM_LINUX )
+	#include <netinet/udp.h>
+	#include <sys/epoll.h>
+
+	#ifndef UDP_SEGMENT
+		#define UDP_SEGMENT 103
+	#endif
+#endif
 
 //-----------------------------------------------------------------------------------------------
 namespace Network
 {
 	//-----------------------------------------------------------------------------------------------
-	class UDPSocket
+	//Describes one datagram waiting in the UDPSocket send queue. Its bytes are the segments
+	//	[ firstSegment, firstSegment + numberOfSegments ) of the queue's segment list.
+	struct QueuedDatagram
+	{
+		unsigned int firstSegment;
+		unsigned int numberOfSegments;
+		int numberOfBytes;
+		sockaddr_in receiverAddress;
+	};
+
+
+
+	//-----------------------------------------------------------------------------------------------
+	class UDPSocket : public DatagramSocket
 	{
 	public:
+		static const unsigned int MAXIMUM_QUEUED_DATAGRAMS = 1024;
+		static const unsigned int MAXIMUM_QUEUED_SEGMENTS = 4096;
+		static const unsigned int MAXIMUM_SEGMENTS_PER_DATAGRAM = 1024; //IOV_MAX on Linux
+		static const unsigned int SEND_QUEUE_BUFFER_BYTES = 256 * 1024;
+		static const unsigned int MAXIMUM_SEGMENTS_PER_SEND = 64; //Kernel limit for one UDP_SEGMENT send
+		static const unsigned int MAXIMUM_SEGMENTED_SEND_BYTES = 65000;
+
 		UDPSocket();
 		~UDPSocket();
 
 		int Initialize();
+		int EnablePortSharing();
 		int Bind( const std::string& address, const std::string& portNumber );
 		int ReceiveBuffer( char* buffer, int bufferLength, std::string& out_receivedIPAddress, unsigned short& out_receivedPortNumber );
+		int ReceiveBufferBatch( char* buffers, int bufferLength, unsigned int numberOfBuffers, ReceivedDatagram* out_receivedDatagrams );
 		int SendBuffer( char* buffer, int bufferLength, const std::string& receiverIPAddress, unsigned short receiverPortNumber );
+		int QueueBufferForSend( const char* buffer, int bufferLength, const sockaddr_in& receiverAddress );
+		int QueueBufferForSend( const char* buffer, int bufferLength, const std::string& receiverIPAddress, unsigned short receiverPortNumber );
+		int QueueSegmentsForSend( const BufferSegment* segments, unsigned int numberOfSegments, const sockaddr_in& receiverAddress );
+		int QueueSegmentsForSend( const BufferSegment* segments, unsigned int numberOfSegments, const std::string& receiverIPAddress, unsigned short receiverPortNumber );
+		int FlushSendQueue();
+		int WaitForIncomingData( int timeoutMilliseconds );
 		int Cleanup();
 
 		bool IsInitialized() { return m_isInitialized; }
+		int GetReadinessDescriptor() const;
+		int GetLastSendErrorCode() const { return m_lastSendErrorCode; }
+		unsigned int GetNumberOfQueuedDatagrams() const { return m_numberOfQueuedDatagrams; }
 
 		unsigned long GetNumberOfBytesInNetworkQueue();
 		void GetRemoteAddress( std::string& out_remoteAddress );
@@ -33,17 +76,45 @@ namespace Network
 		void SetRemotePort( unsigned short portNumber ) { SetSockaddrPort( m_remoteAddress, portNumber ); }
 		int SetFunctionsToNonbindingMode();
 
+		static void GetSockaddrAddressAsString( const sockaddr_in* socketAddress, char* out_addressBuffer, size_t sizeOfAddressBuffer );
+		static unsigned short GetSockaddrPort( const sockaddr_in* addressStruct ) { return ntohs( addressStruct->sin_port ); }
+		static bool SockaddrsAreEqual( const sockaddr_in& first, const sockaddr_in& second );
+
 	private:
-		unsigned short GetSockaddrPort( sockaddr_in* addressStruct ) { return ntohs( addressStruct->sin_port ); }
-		void GetSockaddrAddressAsString( sockaddr_in* socketAddress, char* out_addressBuffer, size_t sizeOfAddressBuffer );
+		unsigned int CountDatagramsInSegmentedRun( unsigned int firstDatagramIndex ) const;
+	#if defined( PLATFORM_LINUX )
+		int SendDatagramsIndividually( unsigned int firstDatagramIndex, unsigned int numberOfDatagrams );
+	#endif
+
 		void SetSockaddrAddress( sockaddr_in* addressStruct, unsigned long newAddress ) { addressStruct->sin_addr.s_addr = newAddress; }
 		void SetSockaddrPort( sockaddr_in* addressStruct, unsigned short portNumber ) { addressStruct->sin_port = htons( portNumber ); }
 
 		sockaddr_in* m_socketAddress;
 		sockaddr_in* m_remoteAddress;
 		SOCKET m_winSocketID;
-		WSADATA m_winsockData;
 		bool m_isInitialized;
+
+		char* m_sendQueueBuffer;
+		unsigned int m_sendQueueBytesUsed;
+		QueuedDatagram m_queuedDatagrams[ MAXIMUM_QUEUED_DATAGRAMS ];
+		unsigned int m_numberOfQueuedDatagrams;
+		BufferSegment* m_queuedSegments;
+		unsigned int m_numberOfQueuedSegments;
+		int m_lastSendErrorCode; //From the most recent FlushSendQueue that had a send fail
+
+	#if !defined( PLATFORM_LINUX )
+		char* m_gatherBuffer; //Multi-segment datagrams are copied together here before sendto
+	#endif
+	#if defined( PLATFORM_WINDOWS )
+		WSADATA m_winsockData;
+	#elif defined( PLATFORM_LINUX )
+		int m_epollID;
+		bool m_segmentationOffloadIsSupported;
+		mmsghdr m_batchHeaders[ MAXIMUM_DATAGRAMS_PER_BATCH ];
+		iovec m_batchIOVectors[ MAXIMUM_DATAGRAMS_PER_BATCH ];
+		iovec* m_queuedIOVectors; //One per queued segment, filled in at flush time
+		char m_batchControlBuffers[ MAXIMUM_DATAGRAMS_PER_BATCH ][ CMSG_SPACE( sizeof( unsigned short ) ) ];
+	#endif
 	};
 
 
@@ -54,6 +125,20 @@ namespace Network
 		, m_remoteAddress( nullptr )
 		, m_winSocketID( 0 )
 		, m_isInitialized( false )
+		, m_sendQueueBuffer( nullptr )
+		, m_sendQueueBytesUsed( 0 )
+		, m_numberOfQueuedDatagrams( 0 )
+		, m_queuedSegments( nullptr )
+		, m_numberOfQueuedSegments( 0 )
+		, m_lastSendErrorCode( 0 )
+	#if !defined( PLATFORM_LINUX )
+		, m_gatherBuffer( nullptr )
+	#endif
+	#if defined( PLATFORM_LINUX )
+		, m_epollID( -1 )
+		, m_segmentationOffloadIsSupported( false )
+		, m_queuedIOVectors( nullptr )
+	#endif
 	{
 	}
 
@@ -66,11 +151,13 @@ namespace Network
 	//-----------------------------------------------------------------------------------------------
 	inline int UDPSocket::Initialize()
 	{
+	#if defined( PLATFORM_WINDOWS )
 		if ( WSAStartup( MAKEWORD(2,2), &m_winsockData ) != 0 )
 		{
 			printf( "Failed to initialize socket system. Error Code: %d", WSAGetLastError() );
 			return -1;
 		}
+	#endif
 
 		m_socketAddress = new sockaddr_in();
 		m_socketAddress->sin_family = AF_INET;
@@ -80,14 +167,62 @@ namespace Network
 		//create socket
 		if ( ( m_winSocketID = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP) ) == SOCKET_ERROR )
 		{
-			printf( "Failed to initialize socket. windows Error Code: %d", WSAGetLastError() );
+			printf( "Failed to initialize socket. Error Code: %d", GetLastSocketErrorCode() );
 			return -2;
 		}
 
+	#if defined( PLATFORM_LINUX )
+		//The epoll set only ever watches this socket; it lets WaitForIncomingData sleep instead of spinning on FIONREAD.
+		m_epollID = epoll_create1( EPOLL_CLOEXEC );
+		if( m_epollID < 0 )
+		{
+			printf( "Failed to create epoll instance. Error Code: %d", GetLastSocketErrorCode() );
+			return -3;
+		}
+
+		epoll_event readableEvent;
+		readableEvent.events = EPOLLIN;
+		readableEvent.data.fd = m_winSocketID;
+		if( epoll_ctl( m_epollID, EPOLL_CTL_ADD, m_winSocketID, &readableEvent ) < 0 )
+		{
+			printf( "Failed to register socket with epoll. Error Code: %d", GetLastSocketErrorCode() );
+			return -4;
+		}
+
+		//Kernels without UDP GSO reject the option outright, so this doubles as a feature probe.
+		int segmentSize = 0;
+		socklen_t segmentSizeLength = sizeof( segmentSize );
+		m_segmentationOffloadIsSupported = ( getsockopt( m_winSocketID, SOL_UDP, UDP_SEGMENT, &segmentSize, &segmentSizeLength ) == 0 );
+	#endif
+
+		m_sendQueueBuffer = new char[ SEND_QUEUE_BUFFER_BYTES ];
+		m_sendQueueBytesUsed = 0;
+		m_numberOfQueuedDatagrams = 0;
+		m_queuedSegments = new BufferSegment[ MAXIMUM_QUEUED_SEGMENTS ];
+		m_numberOfQueuedSegments = 0;
+	#if defined( PLATFORM_LINUX )
+		m_queuedIOVectors = new iovec[ MAXIMUM_QUEUED_SEGMENTS ];
+	#else
+		m_gatherBuffer = new char[ MAXIMUM_SEGMENTED_SEND_BYTES ];
+	#endif
+
 		m_isInitialized = true;
 		return 0;
 	}
 
+	//-----------------------------------------------------------------------------------------------
+	//Lets several sockets bind the same port, with the kernel spreading incoming datagrams between them.
+	//Must be called before Bind.
+	inline int UDPSocket::EnablePortSharing()
+	{
+	#if defined( PLATFORM_UNIX ) && defined( SO_REUSEPORT )
+		int optionValue = 1;
+		return setsockopt( m_winSocketID, SOL_SOCKET, SO_REUSEPORT, &optionValue, sizeof( optionValue ) );
+	#else
+		return -1; //Winsock has no load-balancing equivalent of SO_REUSEPORT
+	#endif
+	}
+
 	//-----------------------------------------------------------------------------------------------
 	inline int UDPSocket::Bind( const std::string& address, const std::string& portNumber )
 	{
@@ -105,7 +240,7 @@ namespace Network
 	//-----------------------------------------------------------------------------------------------
 	inline int UDPSocket::ReceiveBuffer( char* buffer, int bufferLength, std::string& out_receivedIPAddress, unsigned short& out_receivedPortNumber )
 	{
-		int sizeOfRemoteAddress = sizeof( sockaddr_in );
+		socklen_t sizeOfRemoteAddress = sizeof( sockaddr_in );
 		int returnValue = recvfrom( m_winSocketID, buffer, bufferLength, 0, (sockaddr*)m_remoteAddress, &sizeOfRemoteAddress );
 
 		static char addressBuffer[32];
@@ -115,6 +250,67 @@ namespace Network
 		return returnValue;
 	}
 
+	//-----------------------------------------------------------------------------------------------
+	//Fills up to numberOfBuffers consecutive buffers, each bufferLength bytes long, with queued datagrams.
+	//Returns the number of datagrams received (0 if the queue was empty), or a negative value on error.
+	inline int UDPSocket::ReceiveBufferBatch( char* buffers, int bufferLength, unsigned int numberOfBuffers, ReceivedDatagram* out_receivedDatagrams )
+	{
+		if( numberOfBuffers > MAXIMUM_DATAGRAMS_PER_BATCH )
+			numberOfBuffers = MAXIMUM_DATAGRAMS_PER_BATCH;
+
+	#if defined( PLATFORM_LINUX )
+		for( unsigned int i = 0; i < numberOfBuffers; ++i )
+		{
+			m_batchIOVectors[ i ].iov_base = buffers + ( i * bufferLength );
+			m_batchIOVectors[ i ].iov_len = bufferLength;
+
+			msghdr& header = m_batchHeaders[ i ].msg_hdr;
+			header.msg_name = &out_receivedDatagrams[ i ].senderAddress;
+			header.msg_namelen = sizeof( sockaddr_in );
+			header.msg_iov = &m_batchIOVectors[ i ];
+			header.msg_iovlen = 1;
+			header.msg_control = nullptr;
+			header.msg_controllen = 0;
+			header.msg_flags = 0;
+			m_batchHeaders[ i ].msg_len = 0;
+		}
+
+		int numberOfDatagrams = recvmmsg( m_winSocketID, m_batchHeaders, numberOfBuffers, MSG_DONTWAIT, nullptr );
+		if( numberOfDatagrams < 0 )
+		{
+			if( SocketErrorMeansQueueIsEmpty( GetLastSocketErrorCode() ) )
+				return 0;
+			return -1;
+		}
+
+		for( int i = 0; i < numberOfDatagrams; ++i )
+		{
+			out_receivedDatagrams[ i ].numberOfBytes = static_cast< int >( m_batchHeaders[ i ].msg_len );
+		}
+		return numberOfDatagrams;
+	#else
+		//No batch receive call here, so drain the queue one datagram at a time.
+		unsigned int numberOfDatagrams = 0;
+		while( numberOfDatagrams < numberOfBuffers && GetNumberOfBytesInNetworkQueue() > 0 )
+		{
+			ReceivedDatagram& datagram = out_receivedDatagrams[ numberOfDatagrams ];
+			socklen_t sizeOfSenderAddress = sizeof( sockaddr_in );
+			int receiveResult = recvfrom( m_winSocketID, buffers + ( numberOfDatagrams * bufferLength ), bufferLength, 0,
+										  (sockaddr*)&datagram.senderAddress, &sizeOfSenderAddress );
+			if( receiveResult < 0 )
+			{
+				if( SocketErrorMeansQueueIsEmpty( GetLastSocketErrorCode() ) )
+					break;
+				return -1;
+			}
+
+			datagram.numberOfBytes = receiveResult;
+			++numberOfDatagrams;
+		}
+		return static_cast< int >( numberOfDatagrams );
+	#endif
+	}
+
 	//-----------------------------------------------------------------------------------------------
 	inline int UDPSocket::SendBuffer( char* buffer, int bufferLength, const std::string& receiverIPAddress, unsigned short receiverPortNumber )
 	{
@@ -125,6 +321,263 @@ namespace Network
 		return sendto( m_winSocketID, buffer, bufferLength, 0, (sockaddr*)m_remoteAddress, sizeof( sockaddr_in ) );
 	}
 
+	//-----------------------------------------------------------------------------------------------
+	//Copies the datagram into the send queue; nothing hits the wire until FlushSendQueue.
+	//Flushes early if the queue is full. Returns a negative value if that early flush failed.
+	inline int UDPSocket::QueueBufferForSend( const char* buffer, int bufferLength, const sockaddr_in& receiverAddress )
+	{
+		if( bufferLength <= 0 || static_cast< unsigned int >( bufferLength ) > SEND_QUEUE_BUFFER_BYTES )
+			return -1;
+
+		int flushResult = 0;
+		//Flush here rather than in QueueSegmentsForSend, which would otherwise flush away the bytes just copied
+		if( m_sendQueueBytesUsed + bufferLength > SEND_QUEUE_BUFFER_BYTES || m_numberOfQueuedDatagrams == MAXIMUM_QUEUED_DATAGRAMS ||
+			m_numberOfQueuedSegments == MAXIMUM_QUEUED_SEGMENTS )
+			flushResult = FlushSendQueue();
+
+		BufferSegment copiedSegment;
+		copiedSegment.bytes = m_sendQueueBuffer + m_sendQueueBytesUsed;
+		copiedSegment.numberOfBytes = bufferLength;
+		memcpy( m_sendQueueBuffer + m_sendQueueBytesUsed, buffer, bufferLength );
+		m_sendQueueBytesUsed += bufferLength;
+
+		int queueResult = QueueSegmentsForSend( &copiedSegment, 1, receiverAddress );
+		return ( flushResult < 0 ) ? flushResult : queueResult;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline int UDPSocket::QueueBufferForSend( const char* buffer, int bufferLength, const std::string& receiverIPAddress, unsigned short receiverPortNumber )
+	{
+		sockaddr_in receiverAddress;
+		memset( &receiverAddress, 0, sizeof( sockaddr_in ) );
+		receiverAddress.sin_family = AF_INET;
+		SetSockaddrAddress( &receiverAddress, inet_addr( receiverIPAddress.c_str() ) );
+		SetSockaddrPort( &receiverAddress, receiverPortNumber );
+
+		return QueueBufferForSend( buffer, bufferLength, receiverAddress );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Queues a datagram made of the given segments without copying them. On Linux the kernel gathers
+	//	them straight from the caller's memory, so every segment must stay valid until the next FlushSendQueue.
+	//Flushes early if the queue is full. Returns a negative value if that early flush failed.
+	inline int UDPSocket::QueueSegmentsForSend( const BufferSegment* segments, unsigned int numberOfSegments, const sockaddr_in& receiverAddress )
+	{
+		unsigned int numberOfBytes = 0;
+		for( unsigned int i = 0; i < numberOfSegments; ++i )
+		{
+			numberOfBytes += segments[ i ].numberOfBytes;
+		}
+		if( numberOfBytes == 0 || numberOfBytes > MAXIMUM_SEGMENTED_SEND_BYTES || numberOfSegments > MAXIMUM_SEGMENTS_PER_DATAGRAM )
+			return -1;
+
+		int flushResult = 0;
+		if( m_numberOfQueuedDatagrams == MAXIMUM_QUEUED_DATAGRAMS || m_numberOfQueuedSegments + numberOfSegments > MAXIMUM_QUEUED_SEGMENTS )
+			flushResult = FlushSendQueue();
+
+		QueuedDatagram& datagram = m_queuedDatagrams[ m_numberOfQueuedDatagrams ];
+		datagram.firstSegment = m_numberOfQueuedSegments;
+		datagram.numberOfSegments = numberOfSegments;
+		datagram.numberOfBytes = static_cast< int >( numberOfBytes );
+		datagram.receiverAddress = receiverAddress;
+		memcpy( m_queuedSegments + m_numberOfQueuedSegments, segments, numberOfSegments * sizeof( BufferSegment ) );
+
+		m_numberOfQueuedSegments += numberOfSegments;
+		++m_numberOfQueuedDatagrams;
+		return ( flushResult < 0 ) ? flushResult : 0;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline int UDPSocket::QueueSegmentsForSend( const BufferSegment* segments, unsigned int numberOfSegments, const std::string& receiverIPAddress, unsigned short receiverPortNumber )
+	{
+		sockaddr_in receiverAddress;
+		memset( &receiverAddress, 0, sizeof( sockaddr_in ) );
+		receiverAddress.sin_family = AF_INET;
+		SetSockaddrAddress( &receiverAddress, inet_addr( receiverIPAddress.c_str() ) );
+		SetSockaddrPort( &receiverAddress, receiverPortNumber );
+
+		return QueueSegmentsForSend( segments, numberOfSegments, receiverAddress );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Sends everything in the send queue and empties it.
+	//On Linux, runs of equal-sized datagrams to one receiver go out as a single UDP_SEGMENT (GSO) send,
+	//	and up to MAXIMUM_DATAGRAMS_PER_BATCH sends are handed to the kernel per sendmmsg call.
+	//Returns the number of datagrams handed to the kernel, or a negative value if any send failed
+	//	(GetLastSendErrorCode says why). Either way the queue is empty afterward.
+	//Datagrams that could not be sent because the socket buffer was full are dropped, just as the network might.
+	//If the kernel or NIC refuses a segmented send, GSO is switched off for good and that run goes out one datagram at a time.
+	inline int UDPSocket::FlushSendQueue()
+	{
+		int numberOfDatagramsSent = 0;
+		bool sendErrorOccurred = false;
+		m_lastSendErrorCode = 0;
+
+	#if defined( PLATFORM_LINUX )
+		for( unsigned int i = 0; i < m_numberOfQueuedSegments; ++i )
+		{
+			m_queuedIOVectors[ i ].iov_base = const_cast< char* >( m_queuedSegments[ i ].bytes );
+			m_queuedIOVectors[ i ].iov_len = m_queuedSegments[ i ].numberOfBytes;
+		}
+
+		unsigned int nextDatagramIndex = 0;
+		while( nextDatagramIndex < m_numberOfQueuedDatagrams )
+		{
+			unsigned int numberOfHeaders = 0;
+			unsigned int firstDatagramOfHeader[ MAXIMUM_DATAGRAMS_PER_BATCH ];
+			unsigned int datagramsInHeader[ MAXIMUM_DATAGRAMS_PER_BATCH ];
+			while( numberOfHeaders < MAXIMUM_DATAGRAMS_PER_BATCH && nextDatagramIndex < m_numberOfQueuedDatagrams )
+			{
+				const QueuedDatagram& firstDatagram = m_queuedDatagrams[ nextDatagramIndex ];
+				unsigned int datagramsInRun = CountDatagramsInSegmentedRun( nextDatagramIndex );
+
+				//Datagrams queue their segments in order, so a whole run is one contiguous stretch of iovecs.
+				//With GSO the kernel cuts segment boundaries from the byte count, not from the iovecs.
+				const QueuedDatagram& lastDatagram = m_queuedDatagrams[ nextDatagramIndex + datagramsInRun - 1 ];
+				msghdr& header = m_batchHeaders[ numberOfHeaders ].msg_hdr;
+				header.msg_name = const_cast< sockaddr_in* >( &firstDatagram.receiverAddress );
+				header.msg_namelen = sizeof( sockaddr_in );
+				header.msg_iov = &m_queuedIOVectors[ firstDatagram.firstSegment ];
+				header.msg_iovlen = ( lastDatagram.firstSegment + lastDatagram.numberOfSegments ) - firstDatagram.firstSegment;
+				header.msg_control = nullptr;
+				header.msg_controllen = 0;
+				header.msg_flags = 0;
+				m_batchHeaders[ numberOfHeaders ].msg_len = 0;
+
+				if( datagramsInRun > 1 )
+				{
+					header.msg_control = m_batchControlBuffers[ numberOfHeaders ];
+					header.msg_controllen = CMSG_SPACE( sizeof( unsigned short ) );
+
+					cmsghdr* segmentMessage = CMSG_FIRSTHDR( &header );
+					segmentMessage->cmsg_level = SOL_UDP;
+					segmentMessage->cmsg_type = UDP_SEGMENT;
+					segmentMessage->cmsg_len = CMSG_LEN( sizeof( unsigned short ) );
+
+					unsigned short segmentSize = static_cast< unsigned short >( firstDatagram.numberOfBytes );
+					memcpy( CMSG_DATA( segmentMessage ), &segmentSize, sizeof( unsigned short ) );
+				}
+
+				firstDatagramOfHeader[ numberOfHeaders ] = nextDatagramIndex;
+				datagramsInHeader[ numberOfHeaders ] = datagramsInRun;
+				nextDatagramIndex += datagramsInRun;
+				++numberOfHeaders;
+			}
+
+			unsigned int headersSent = 0;
+			while( headersSent < numberOfHeaders )
+			{
+				int sendResult = sendmmsg( m_winSocketID, m_batchHeaders + headersSent, numberOfHeaders - headersSent, 0 );
+				if( sendResult < 0 )
+				{
+					int errorCode = GetLastSocketErrorCode();
+					if( errorCode == EINTR )
+						continue;
+
+					if( datagramsInHeader[ headersSent ] > 1 && !SocketErrorMeansQueueIsEmpty( errorCode ) )
+					{
+						printf( "WARNING: Segmented send failed with Error Code:%i. Sending datagrams individually from now on.\n", errorCode );
+						m_segmentationOffloadIsSupported = false;
+
+						int individualSendResult = SendDatagramsIndividually( firstDatagramOfHeader[ headersSent ], datagramsInHeader[ headersSent ] );
+						if( individualSendResult < 0 )
+							sendErrorOccurred = true;
+						else
+							numberOfDatagramsSent += individualSendResult;
+					}
+					else if( !SocketErrorMeansQueueIsEmpty( errorCode ) )
+					{
+						sendErrorOccurred = true;
+						m_lastSendErrorCode = errorCode;
+					}
+
+					++headersSent; //Skip the send that failed and keep going with the rest.
+					continue;
+				}
+
+				for( int i = 0; i < sendResult; ++i )
+				{
+					numberOfDatagramsSent += datagramsInHeader[ headersSent + i ];
+				}
+				headersSent += sendResult;
+			}
+		}
+	#else
+		for( unsigned int i = 0; i < m_numberOfQueuedDatagrams; ++i )
+		{
+			const QueuedDatagram& datagram = m_queuedDatagrams[ i ];
+			const BufferSegment& firstSegment = m_queuedSegments[ datagram.firstSegment ];
+			const char* datagramBytes = firstSegment.bytes;
+			if( datagram.numberOfSegments > 1 )
+			{
+				unsigned int gatheredBytes = 0;
+				for( unsigned int j = 0; j < datagram.numberOfSegments; ++j )
+				{
+					const BufferSegment& segment = m_queuedSegments[ datagram.firstSegment + j ];
+					memcpy( m_gatherBuffer + gatheredBytes, segment.bytes, segment.numberOfBytes );
+					gatheredBytes += segment.numberOfBytes;
+				}
+				datagramBytes = m_gatherBuffer;
+			}
+
+			int sendResult = sendto( m_winSocketID, datagramBytes, datagram.numberOfBytes, 0,
+									 (const sockaddr*)&datagram.receiverAddress, sizeof( sockaddr_in ) );
+			if( sendResult < 0 )
+			{
+				int errorCode = GetLastSocketErrorCode();
+				if( !SocketErrorMeansQueueIsEmpty( errorCode ) )
+				{
+					sendErrorOccurred = true;
+					m_lastSendErrorCode = errorCode;
+				}
+				continue;
+			}
+			++numberOfDatagramsSent;
+		}
+	#endif
+
+		m_numberOfQueuedDatagrams = 0;
+		m_numberOfQueuedSegments = 0;
+		m_sendQueueBytesUsed = 0;
+
+		if( sendErrorOccurred )
+			return -1;
+		return numberOfDatagramsSent;
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Blocks until a datagram is readable or the timeout passes (-1 waits forever).
+	//Returns a positive value if data is waiting, 0 on timeout, or a negative value on error.
+	inline int UDPSocket::WaitForIncomingData( int timeoutMilliseconds )
+	{
+	#if defined( PLATFORM_LINUX )
+		epoll_event readyEvent;
+		int waitResult = epoll_wait( m_epollID, &readyEvent, 1, timeoutMilliseconds );
+		if( waitResult < 0 && GetLastSocketErrorCode() == EINTR )
+			return 0;
+		return waitResult;
+	#else
+		fd_set readableSockets;
+		FD_ZERO( &readableSockets );
+		FD_SET( m_winSocketID, &readableSockets );
+
+		timeval timeout;
+		timeout.tv_sec = timeoutMilliseconds / 1000;
+		timeout.tv_usec = ( timeoutMilliseconds % 1000 ) * 1000;
+		return select( static_cast< int >( m_winSocketID ) + 1, &readableSockets, nullptr, nullptr, ( timeoutMilliseconds < 0 ) ? nullptr : &timeout );
+	#endif
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	inline int UDPSocket::GetReadinessDescriptor() const
+	{
+	#if defined( PLATFORM_UNIX )
+		return m_winSocketID;
+	#else
+		return -1; //Winsock sockets can't be waited on alongside other handles through a plain descriptor
+	#endif
+	}
+
 	//-----------------------------------------------------------------------------------------------
 	inline int UDPSocket::Cleanup()
 	{
@@ -133,8 +586,30 @@ namespace Network
 
 		delete m_socketAddress;
 		delete m_remoteAddress;
+		delete[] m_sendQueueBuffer;
+		m_sendQueueBuffer = nullptr;
+		m_numberOfQueuedDatagrams = 0;
+		delete[] m_queuedSegments;
+		m_queuedSegments = nullptr;
+		m_numberOfQueuedSegments = 0;
+	#if defined( PLATFORM_LINUX )
+		delete[] m_queuedIOVectors;
+		m_queuedIOVectors = nullptr;
+	#else
+		delete[] m_gatherBuffer;
+		m_gatherBuffer = nullptr;
+	#endif
+		m_sendQueueBytesUsed = 0;
+	#if defined( PLATFORM_WINDOWS )
 		closesocket( m_winSocketID );
 		WSACleanup();
+	#else
+		#if defined( PLATFORM_LINUX )
+		close( m_epollID );
+		m_epollID = -1;
+		#endif
+		close( m_winSocketID );
+	#endif
 		m_isInitialized = false;
 		return 0;
 	}
@@ -142,18 +617,113 @@ namespace Network
 	//-----------------------------------------------------------------------------------------------
 	inline unsigned long UDPSocket::GetNumberOfBytesInNetworkQueue()
 	{
+	#if defined( PLATFORM_WINDOWS )
 		unsigned long numberOfBytesInQueue;
 
 		ioctlsocket( m_winSocketID, FIONREAD, &numberOfBytesInQueue );
 		return numberOfBytesInQueue;
+	#else
+		int numberOfBytesInQueue = 0;
+
+		ioctl( m_winSocketID, FIONREAD, &numberOfBytesInQueue );
+		return static_cast< unsigned long >( numberOfBytesInQueue );
+	#endif
 	}
 
 	//-----------------------------------------------------------------------------------------------
-	inline void UDPSocket::GetSockaddrAddressAsString( sockaddr_in* socketAddress, char* out_addressBuffer, size_t sizeOfAddressBuffer )
+	inline void UDPSocket::GetSockaddrAddressAsString( const sockaddr_in* socketAddress, char* out_addressBuffer, size_t sizeOfAddressBuffer )
 	{
 		inet_ntop( socketAddress->sin_family, (void*)&socketAddress->sin_addr, out_addressBuffer, sizeOfAddressBuffer );
 	}
 
+	//-----------------------------------------------------------------------------------------------
+	inline bool UDPSocket::SockaddrsAreEqual( const sockaddr_in& first, const sockaddr_in& second )
+	{
+		return ( first.sin_addr.s_addr == second.sin_addr.s_addr ) && ( first.sin_port == second.sin_port );
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	//Counts how many queued datagrams, starting at firstDatagramIndex, can share one segmented (GSO) send:
+	//	same receiver, every segment the size of the first except a possibly shorter final one.
+	inline unsigned int UDPSocket::CountDatagramsInSegmentedRun( unsigned int firstDatagramIndex ) const
+	{
+	#if defined( PLATFORM_LINUX )
+		if( !m_segmentationOffloadIsSupported )
+			return 1;
+
+		const QueuedDatagram& firstDatagram = m_queuedDatagrams[ firstDatagramIndex ];
+		unsigned int datagramsInRun = 1;
+		unsigned int bytesInRun = firstDatagram.numberOfBytes;
+		unsigned int segmentsInRun = firstDatagram.numberOfSegments;
+		while( firstDatagramIndex + datagramsInRun < m_numberOfQueuedDatagrams && datagramsInRun < MAXIMUM_SEGMENTS_PER_SEND )
+		{
+			const QueuedDatagram& nextDatagram = m_queuedDatagrams[ firstDatagramIndex + datagramsInRun ];
+			if( !SockaddrsAreEqual( nextDatagram.receiverAddress, firstDatagram.receiverAddress ) )
+				break;
+			if( nextDatagram.numberOfBytes > firstDatagram.numberOfBytes )
+				break;
+			if( bytesInRun + nextDatagram.numberOfBytes > MAXIMUM_SEGMENTED_SEND_BYTES )
+				break;
+			if( segmentsInRun + nextDatagram.numberOfSegments > MAXIMUM_SEGMENTS_PER_DATAGRAM )
+				break;
+
+			bytesInRun += nextDatagram.numberOfBytes;
+			segmentsInRun += nextDatagram.numberOfSegments;
+			++datagramsInRun;
+
+			if( nextDatagram.numberOfBytes < firstDatagram.numberOfBytes )
+				break; //Only the last segment may be short
+		}
+		return datagramsInRun;
+	#else
+		VARIABLE_IS_UNUSED( firstDatagramIndex );
+		return 1;
+	#endif
+	}
+
+	#if defined( PLATFORM_LINUX )
+	//-----------------------------------------------------------------------------------------------
+	//Sends queued datagrams one sendmsg each, without UDP_SEGMENT. Used to retry a segmented run the kernel refused.
+	//Returns how many were sent, or a negative value if any send failed for a reason other than a full socket buffer.
+	inline int UDPSocket::SendDatagramsIndividually( unsigned int firstDatagramIndex, unsigned int numberOfDatagrams )
+	{
+		int numberOfDatagramsSent = 0;
+		bool sendErrorOccurred = false;
+		for( unsigned int i = 0; i < numberOfDatagrams; ++i )
+		{
+			const QueuedDatagram& datagram = m_queuedDatagrams[ firstDatagramIndex + i ];
+			msghdr header;
+			memset( &header, 0, sizeof( msghdr ) );
+			header.msg_name = const_cast< sockaddr_in* >( &datagram.receiverAddress );
+			header.msg_namelen = sizeof( sockaddr_in );
+			header.msg_iov = &m_queuedIOVectors[ datagram.firstSegment ];
+			header.msg_iovlen = datagram.numberOfSegments;
+
+			ssize_t sendResult;
+			do
+			{
+				sendResult = sendmsg( m_winSocketID, &header, 0 );
+			} while( sendResult < 0 && GetLastSocketErrorCode() == EINTR );
+
+			if( sendResult < 0 )
+			{
+				int errorCode = GetLastSocketErrorCode();
+				if( !SocketErrorMeansQueueIsEmpty( errorCode ) )
+				{
+					sendErrorOccurred = true;
+					m_lastSendErrorCode = errorCode;
+				}
+				continue;
+			}
+			++numberOfDatagramsSent;
+		}
+
+		if( sendErrorOccurred )
+			return -1;
+		return numberOfDatagramsSent;
+	}
+	#endif
+
 	//-----------------------------------------------------------------------------------------------
 	inline void UDPSocket::SetRemoteAddress( const std::string& address )
 	{
@@ -166,9 +736,17 @@ namespace Network
 	//-----------------------------------------------------------------------------------------------
 	inline int UDPSocket::SetFunctionsToNonbindingMode()
 	{
+	#if defined( PLATFORM_WINDOWS )
 		static unsigned long LONG_TRUE = 1;
 
 		return ioctlsocket( m_winSocketID, FIONBIO, &LONG_TRUE );
+	#else
+		int socketFlags = fcntl( m_winSocketID, F_GETFL, 0 );
+		if( socketFlags < 0 )
+			return socketFlags;
+
+		return fcntl( m_winSocketID, F_SETFL, socketFlags | O_NONBLOCK );
+	#endif
 	}
 }
 
@@ -9,14 +9,19 @@
 #include "../Engine/Components/MaterialComponent.hpp"
 #include "../Engine/Graphics/Renderer.hpp"
 #include "../Engine/Graphics/VertexDataContainers.hpp"
+#include "../Engine/EngineCommon.hpp"
 
+STATIC const float Entity::MAXIMUM_EXTRAPOLATION_SECONDS = 0.25f; //Past this, a player with no news stops where it was headed
 
 //-----------------------------------------------------------------------------------------------
 Entity::Entity()
 	: m_playerID( 0 )
 	, m_isIt( false )
+	, m_isLocallyPredicted( false )
 	, m_clientOrientationDegrees( 0 )
 	, m_serverOrientationDegrees( 0 )
+	, m_oldestServerState( 0 )
+	, m_numberOfServerStates( 0 )
 	, m_color( (unsigned char)255, 0, 0, 255 )
 {
 	Renderer* renderer = Renderer::GetRenderer();
@@ -27,6 +32,78 @@ Entity::Entity()
 	m_tankMaterial->SetProjectionMatrixUniform( "u_projectionMatrix" );
 }
 
+//-----------------------------------------------------------------------------------------------
+//Places the entity where the server had it at renderTimestamp, which should trail the newest state by enough
+//	that there's usually a state on each side. Between two states the position follows a cubic Hermite curve
+//	through both positions and velocities, so it stays smooth however far apart the snapshots are. Past the
+//	newest state it's carried along by that state's velocity and acceleration for up to MAXIMUM_EXTRAPOLATION_SECONDS.
+void Entity::InterpolateServerStates( double renderTimestamp )
+{
+	if( m_numberOfServerStates == 0 )
+		return;
+
+	const ServerState& oldestState = GetServerState( 0 );
+	if( renderTimestamp <= oldestState.timestamp )
+	{
+		m_clientPosition = oldestState.position;
+		m_clientVelocity = oldestState.velocity;
+		m_clientAcceleration = oldestState.acceleration;
+		m_clientOrientationDegrees = oldestState.orientationDegrees;
+		return;
+	}
+
+	for( unsigned int i = 1; i < m_numberOfServerStates; ++i )
+	{
+		const ServerState& laterState = GetServerState( i );
+		if( renderTimestamp > laterState.timestamp )
+			continue;
+
+		const ServerState& earlierState = GetServerState( i - 1 );
+		float spanSeconds = static_cast< float >( laterState.timestamp - earlierState.timestamp );
+		float t = static_cast< float >( renderTimestamp - earlierState.timestamp ) / spanSeconds;
+		float tSquared = t * t;
+		float tCubed = tSquared * t;
+
+		float earlierPositionWeight = 2.f * tCubed - 3.f * tSquared + 1.f;
+		float earlierVelocityWeight = ( tCubed - 2.f * tSquared + t ) * spanSeconds;
+		float laterPositionWeight = -2.f * tCubed + 3.f * tSquared;
+		float laterVelocityWeight = ( tCubed - tSquared ) * spanSeconds;
+		m_clientPosition = earlierPositionWeight * earlierState.position + earlierVelocityWeight * earlierState.velocity
+						 + laterPositionWeight * laterState.position + laterVelocityWeight * laterState.velocity;
+
+		//The curve's own slope, so velocity agrees with how the position is moving
+		float earlierPositionSlope = ( 6.f * tSquared - 6.f * t ) / spanSeconds;
+		float earlierVelocitySlope = 3.f * tSquared - 4.f * t + 1.f;
+		float laterVelocitySlope = 3.f * tSquared - 2.f * t;
+		m_clientVelocity = earlierPositionSlope * ( earlierState.position - laterState.position )
+						 + earlierVelocitySlope * earlierState.velocity + laterVelocitySlope * laterState.velocity;
+		m_clientAcceleration = ( 1.f - t ) * earlierState.acceleration + t * laterState.acceleration;
+
+		float turnDegrees = laterState.orientationDegrees - earlierState.orientationDegrees;
+		while( turnDegrees > 180.f )
+			turnDegrees -= 360.f;
+		while( turnDegrees < -180.f )
+			turnDegrees += 360.f;
+		m_clientOrientationDegrees = earlierState.orientationDegrees + t * turnDegrees;
+		while( m_clientOrientationDegrees >= 360.f )
+			m_clientOrientationDegrees -= 360.f;
+		while( m_clientOrientationDegrees < 0.f )
+			m_clientOrientationDegrees += 360.f;
+		return;
+	}
+
+	const ServerState& newestState = GetServerState( m_numberOfServerStates - 1 );
+	float extrapolationSeconds = static_cast< float >( renderTimestamp - newestState.timestamp );
+	if( extrapolationSeconds > MAXIMUM_EXTRAPOLATION_SECONDS )
+		extrapolationSeconds = MAXIMUM_EXTRAPOLATION_SECONDS;
+
+	m_clientPosition = newestState.position + extrapolationSeconds * newestState.velocity
+					 + ( 0.5f * extrapolationSeconds * extrapolationSeconds ) * newestState.acceleration;
+	m_clientVelocity = newestState.velocity + extrapolationSeconds * newestState.acceleration;
+	m_clientAcceleration = newestState.acceleration;
+	m_clientOrientationDegrees = newestState.orientationDegrees;
+}
+
 //-----------------------------------------------------------------------------------------------
 void Entity::Render() const
 {
@@ -101,6 +178,10 @@ void Entity::Render() const
 //-----------------------------------------------------------------------------------------------
 void Entity::Update( float /*deltaSeconds*/ )
 {
+	//Remote players are placed by InterpolateServerStates instead, and our own by prediction
+	if( m_numberOfServerStates > 0 || m_isLocallyPredicted )
+		return;
+
 	//Janky Dead Reckoning
 	static const float GUESSTIMATED_LATENCY = .001f;
 	static const float PERCENT_TO_INTERPOLATE_PER_FRAME = 0.2f;
@@ -11,6 +11,9 @@ struct MaterialComponent;
 class Entity
 {
 public:
+	static const unsigned int SERVER_STATE_HISTORY_LENGTH = 16; //Most of a second of snapshots at the server's default 20 per second
+	static const float MAXIMUM_EXTRAPOLATION_SECONDS;
+
 	Entity();
 	~Entity() {}
 
@@ -26,12 +29,14 @@ public:
 	unsigned char GetHealth() const { return m_health; }
 	unsigned char GetID() const { return m_playerID; }
 	bool IsIt() const { return m_isIt; }
+	bool IsLocallyPredicted() const { return m_isLocallyPredicted; }
 	unsigned char GetScore() { return m_score; }
 
 	void SetColor( const Color& color ) { m_color = color; }
 	void SetHealth( unsigned char health ) { m_health = health; }
 	void SetID( unsigned char newID ) { m_playerID = newID; }
 	void SetItStatus( bool itStatus ) { m_isIt = itStatus; }
+	void SetLocallyPredicted( bool isLocallyPredicted ) { m_isLocallyPredicted = isLocallyPredicted; } //Update then leaves its position to the owner
 	void SetScore( unsigned char score ) { m_score = score; }
 
 	void SetClientPosition( float x, float y );
@@ -44,10 +49,28 @@ public:
 	void SetServerAcceleration( float ax, float ay );
 	void SetServerOrientation( float orientationDegrees ) { m_serverOrientationDegrees = orientationDegrees; }
 
+	//Remote players only; once an entity has server states, Update leaves it to InterpolateServerStates
+	void AddServerState( double timestamp, const FloatVector2& position, const FloatVector2& velocity, const FloatVector2& acceleration, float orientationDegrees );
+	bool HasServerStates() const { return m_numberOfServerStates > 0; }
+	void InterpolateServerStates( double renderTimestamp );
+
 protected:
+	//Where the server had this entity at one snapshot, by the server's timestamp
+	struct ServerState
+	{
+		double timestamp;
+		FloatVector2 position;
+		FloatVector2 velocity;
+		FloatVector2 acceleration;
+		float orientationDegrees;
+	};
+
+	const ServerState& GetServerState( unsigned int index ) const { return m_serverStates[ ( m_oldestServerState + index ) % SERVER_STATE_HISTORY_LENGTH ]; }
+
 	unsigned char m_playerID;
 
 	bool m_isIt;
+	bool m_isLocallyPredicted;
 	Color m_color;
 	unsigned char m_health;
 	unsigned char m_score;
@@ -62,11 +85,43 @@ protected:
 	FloatVector2 m_serverAcceleration;
 	float m_serverOrientationDegrees;
 
+	ServerState m_serverStates[ SERVER_STATE_HISTORY_LENGTH ]; //Ring, oldest first from m_oldestServerState
+	unsigned int m_oldestServerState;
+	unsigned int m_numberOfServerStates;
+
 	MaterialComponent* m_tankMaterial;
 };
 
 
 
+//-----------------------------------------------------------------------------------------------
+//States have to come in timestamp order; one no newer than the last is dropped. The oldest is pushed out once
+//	the ring is full, which is long after the interpolation delay has passed it by.
+inline void Entity::AddServerState( double timestamp, const FloatVector2& position, const FloatVector2& velocity, const FloatVector2& acceleration, float orientationDegrees )
+{
+	if( m_numberOfServerStates > 0 && timestamp <= GetServerState( m_numberOfServerStates - 1 ).timestamp )
+		return;
+
+	if( m_numberOfServerStates == SERVER_STATE_HISTORY_LENGTH )
+	{
+		m_oldestServerState = ( m_oldestServerState + 1 ) % SERVER_STATE_HISTORY_LENGTH;
+		--m_numberOfServerStates;
+	}
+
+	ServerState& newState = m_serverStates[ ( m_oldestServerState + m_numberOfServerStates ) % SERVER_STATE_HISTORY_LENGTH ];
+	newState.timestamp = timestamp;
+	newState.position = position;
+	newState.velocity = velocity;
+	newState.acceleration = acceleration;
+	newState.orientationDegrees = orientationDegrees;
+	++m_numberOfServerStates;
+
+	m_serverPosition = position;
+	m_serverVelocity = velocity;
+	m_serverAcceleration = acceleration;
+	m_serverOrientationDegrees = orientationDegrees;
+}
+
 //-----------------------------------------------------------------------------------------------
 inline void Entity::SetClientPosition( float x, float y )
 {
@@ -40,6 +40,10 @@
 
 #pragma region Network Protocol
 //-----------------------------------------------------------------------------------------------
+//"Ack" below means the packet shows up in the acknowledgement fields of the next header going the
+//	other way; an empty Ack packet only carries them when there's nothing else to send.
+//	Refused requests are never acknowledged, so a client that misses the Nack asks again.
+
 //PROTOCOL START
 //	Client->Server: Join( ROOM_Lobby )
 //	Server->Client: Ack
@@ -71,9 +75,14 @@
 //			GOTO GAME LOOP
 
 
+//ANY TIME AFTER JOINING
+//	Client->Server: TimeSync, every second or so (faster until the client has a few replies)
+//	Server->Client: TimeSync, right away, echoing the request's time and adding when it arrived
+
 //GAME LOOP
-//	Client->Server: Update, Hit, Fire
-//	Server->Client: Update, Respawn
+//	Client->Server: Input, Hit, Fire
+//	Server->Client: RoomSnapshot, Respawn
+//	Client->Server: Ack( RoomSnapshot ), for every part at once when the last one arrives; that snapshot becomes the next baseline
 
 //	When end score is reached OR host exits the game:
 //		Server->ALL Clients: ReturnToLobby
@@ -92,6 +101,12 @@ static const RoomID ROOM_None = 255;
 
 typedef unsigned int PacketNumber;
 
+typedef unsigned int SnapshotSequence; //Counts a room's snapshots; separate from each client's packet numbers
+static const SnapshotSequence SNAPSHOT_None = 0;
+
+typedef unsigned short InputSequence; //Counts a client's Inputs within a game; wraps, skipping INPUT_None
+static const InputSequence INPUT_None = 0;
+
 //-----------------------------------------------------------------------------------------------
 typedef unsigned char PacketType;
 static const PacketType TYPE_None = 0;
@@ -101,12 +116,15 @@ static const PacketType TYPE_KeepAlive = 3;
 static const PacketType TYPE_CreateRoom = 4;
 static const PacketType TYPE_JoinRoom = 5;
 static const PacketType TYPE_LobbyUpdate = 6;
-static const PacketType TYPE_GameUpdate = 7;
+//7 was GameUpdate, which clients sent their own positions in until Input replaced it
 static const PacketType TYPE_GameReset = 8;
 static const PacketType TYPE_Respawn = 9;
 static const PacketType TYPE_Hit = 10;
 static const PacketType TYPE_Fire = 11;
 static const PacketType TYPE_ReturnToLobby = 12;
+static const PacketType TYPE_RoomSnapshot = 13;
+static const PacketType TYPE_Input = 14;
+static const PacketType TYPE_TimeSync = 15;
 
 //-----------------------------------------------------------------------------------------------
 typedef unsigned char ErrorCode;
@@ -115,18 +133,23 @@ static const ErrorCode ERROR_RoomEmpty = 1;
 static const ErrorCode ERROR_RoomFull = 2;
 static const ErrorCode ERROR_BadRoomID = 3;
 static const ErrorCode ERROR_Unknown = 255;
+
+//-----------------------------------------------------------------------------------------------
+typedef unsigned char DeltaField;
+static const DeltaField DELTA_None = 0; //Only sent for a player who left the room
+static const DeltaField DELTA_Position = 1 << 0;
+static const DeltaField DELTA_Velocity = 1 << 1;
+static const DeltaField DELTA_Acceleration = 1 << 2;
+static const DeltaField DELTA_Orientation = 1 << 3;
+static const DeltaField DELTA_Health = 1 << 4;
+static const DeltaField DELTA_Score = 1 << 5;
+static const DeltaField DELTA_InputSequence = 1 << 6;
+static const DeltaField DELTA_All = ( 1 << 7 ) - 1;
 #pragma endregion //Packet Type Definitions
 
 
 
 #pragma region Packet Structure Definitions
-//-----------------------------------------------------------------------------------------------
-struct AckPacket
-{
-	PacketType type;
-	PacketNumber number;
-};
-
 //-----------------------------------------------------------------------------------------------
 struct NackPacket
 {
@@ -165,6 +188,19 @@ struct LobbyUpdatePacket
 };
 
 //-----------------------------------------------------------------------------------------------
+//A client's controls for one step of World::INPUTS_PER_SECOND. The server moves the tank one step's worth for
+//	each Input it receives, the same way the client predicted it (see World::GetTankMovementForInput).
+//	Inputs coming faster than that rate don't move the tank.
+//Shots aren't in here: each one is a guaranteed Fire, since an Input can be lost.
+struct InputPacket
+{
+	InputSequence sequence;
+	float movementHeadingDegrees; //0-359.99, 0 = east
+	float movementMagnitude; //0-1; 0 leaves the tank where it is
+};
+
+//-----------------------------------------------------------------------------------------------
+//One player's state in a RoomSnapshot.
 struct GameUpdatePacket
 {
 	float xPosition;
@@ -176,6 +212,7 @@ struct GameUpdatePacket
 	float orientationDegrees; //0-359.99, 0 = east
 	unsigned char health;
 	unsigned char score;
+	InputSequence inputSequence; //The player's latest Input the server applied
 };
 
 //-----------------------------------------------------------------------------------------------
@@ -207,6 +244,15 @@ struct HitPacket
 struct GunfirePacket
 {
 	ClientID instigatorID;
+	double viewTimestamp; //Server time of the other players on the shooter's screen, or 0 if the shooter can't tell
+};
+
+//-----------------------------------------------------------------------------------------------
+//Requests only fill in originTimestamp. The reply's header timestamp is when the server sent it.
+struct TimeSyncPacket
+{
+	double originTimestamp; //When the client sent the request, by the client's clock
+	double receiveTimestamp; //When the request arrived, by the server's clock
 };
 
 //-----------------------------------------------------------------------------------------------
@@ -214,6 +260,49 @@ struct ReturnToLobbyPacket
 {
 
 };
+
+//-----------------------------------------------------------------------------------------------
+//A GameUpdatePacket in the fixed-point steps it is sent in (see FinalPacketSerialization.hpp).
+//Snapshot deltas compare these, so movement smaller than one step never counts as a change.
+struct QuantizedGameUpdate
+{
+	int xPosition;
+	int yPosition;
+	int xVelocity;
+	int yVelocity;
+	int xAcceleration;
+	int yAcceleration;
+	int orientation;
+	int health;
+	int score;
+	int inputSequence;
+};
+
+//-----------------------------------------------------------------------------------------------
+struct PlayerStateDelta
+{
+	ClientID id;
+	DeltaField changedFields;
+	bool positionIsOffset; //If set, the position fields are step offsets from the baseline instead of steps
+	QuantizedGameUpdate state; //Only the changed fields mean anything
+};
+
+//-----------------------------------------------------------------------------------------------
+//Sent as the FinalPacket header followed by this, so it isn't part of FinalPacket's data union.
+//Each snapshot only carries the players who changed since baselineSequence, a snapshot this client acknowledged;
+//	everyone else is as they were. Snapshots with more changes than fit in one message go out in several parts,
+//	and the client only acknowledges a snapshot once it has every part.
+static const unsigned int MAXIMUM_PLAYERS_PER_SNAPSHOT = 32; //Keeps a whole snapshot message inside one 1200-byte datagram
+
+struct RoomSnapshotPacket
+{
+	SnapshotSequence sequence;
+	SnapshotSequence baselineSequence; //SNAPSHOT_None if the client has no baseline, so every player is sent in full
+	unsigned char partIndex;
+	unsigned char numberOfParts;
+	unsigned char numberOfPlayers;
+	PlayerStateDelta players[ MAXIMUM_PLAYERS_PER_SNAPSHOT ];
+};
 #pragma endregion //Packet Structure Definitions
 
 
@@ -225,22 +314,24 @@ struct FinalPacket
 	PacketType type;
 	ClientID clientID;
 	PacketNumber number;
-	double timestamp;
+	double timestamp; //By the sender's clock; clients map the server's onto theirs with TimeSync
+	PacketNumber acknowledgedNumber; //Latest packet received from the other side, or 0 for none
+	unsigned int acknowledgedBits; //Bit i set means acknowledgedNumber - 1 - i was received too
 
 	union PacketData
 	{
-		AckPacket acknowledged;
 		NackPacket refused;
 		KeepAlivePacket keptAlive;
 		CreateRoomPacket creating;
 		JoinRoomPacket joining;
 		LobbyUpdatePacket updatedLobby;
-		GameUpdatePacket updatedGame;
+		InputPacket input;
 		GameResetPacket reset;
 		RespawnPacket respawn;
 		HitPacket hit;
 		GunfirePacket gunfire;
 		ReturnToLobbyPacket lobbyReturn;
+		TimeSyncPacket timeSync;
 	} data;
 
 
@@ -275,7 +366,9 @@ inline bool FinalPacket::IsGuaranteed() const
 	case TYPE_Nack:
 	case TYPE_KeepAlive:
 	case TYPE_LobbyUpdate:
-	case TYPE_GameUpdate:
+	case TYPE_Input:
+	case TYPE_RoomSnapshot:
+	case TYPE_TimeSync:
 	case TYPE_None:
 	default:
 		break;
@@ -285,6 +378,15 @@ inline bool FinalPacket::IsGuaranteed() const
 
 
 
+//-----------------------------------------------------------------------------------------------
+//True if sequence came after previous, allowing for wraparound; sequences more than half the range apart are taken to have wrapped.
+inline bool IsInputSequenceNewer( InputSequence sequence, InputSequence previous )
+{
+	return static_cast< short >( sequence - previous ) > 0;
+}
+
+
+
 //-----------------------------------------------------------------------------------------------
 class FinalPacketComparer
 {
@@ -0,0 +1,591 @@
+#pragma once
+#ifndef INCLUDED_FINAL_PACKET_SERIALIZATION_HPP
+#define INCLUDED_FINAL_PACKET_SERIALIZATION_HPP
+
+//-----------------------------------------------------------------------------------------------
+#include <stdlib.h>
+#include "../Engine/BitStream.hpp"
+#include "../Engine/ByteStream.hpp"
+#include "FinalPacket.hpp"
+
+//-----------------------------------------------------------------------------------------------
+//Wire format: every message is the header (type, clientID, number, timestamp, acknowledgedNumber,
+//	acknowledgedBits) followed by only the live fields of its payload, all in ByteWriter's fixed byte
+//	order. Each type's body has an exact length, so anything longer or shorter is rejected on receive.
+//Game state (Input, and each player in a RoomSnapshot) is the exception: it is bit-packed and
+//	quantized with the settings below, and the body ends at the byte holding its last bit.
+//A RoomSnapshot player is a delta: id, a DeltaField mask, then only the fields in the mask. Small moves
+//	go as signed offsets from the baseline position.
+static const unsigned int FINAL_PACKET_HEADER_WIRE_BYTES = 22;
+static const unsigned int MAXIMUM_FIXED_BODY_WIRE_BYTES = 13; //GameReset; every guaranteed type has a fixed-size body
+
+static const float POSITION_MINIMUM = -256.f; //Spawns reach 600 and tanks can drive off the 500x500 arena,
+static const float POSITION_STEPS_PER_UNIT = 16.f; //	so positions cover -256 to 768 at 1/16 unit
+static const unsigned int POSITION_BITS = 14;
+static const float VELOCITY_MINIMUM = -1024.f; //Units per second; a tank moves about 600. Acceleration uses the same range
+static const float VELOCITY_STEPS_PER_UNIT = 2.f;
+static const unsigned int VELOCITY_BITS = 12;
+static const unsigned int ORIENTATION_BITS = 10; //About 0.35 degrees
+static const unsigned int HEALTH_BITS = 2;
+static const unsigned int SCORE_BITS = 5;
+static const unsigned int ORIENTATION_STEPS = 1 << ORIENTATION_BITS;
+static const unsigned int POSITION_OFFSET_BITS = 7; //-64 to 63 steps, so moves of up to 4 units
+static const unsigned int INPUT_SEQUENCE_BITS = 16;
+static const unsigned int INPUT_MAGNITUDE_BITS = 5; //Stick deflection in 31 steps
+static const unsigned int INPUT_MAGNITUDE_STEPS = ( 1 << INPUT_MAGNITUDE_BITS ) - 1;
+static const unsigned int DELTA_FIELD_BITS = 7;
+
+static const unsigned int INPUT_WIRE_BYTES = ( INPUT_SEQUENCE_BITS + ORIENTATION_BITS + INPUT_MAGNITUDE_BITS + 7 ) / 8;
+static const unsigned int MAXIMUM_PLAYER_DELTA_WIRE_BITS = 8 + DELTA_FIELD_BITS + 1 + 2 * POSITION_BITS + 4 * VELOCITY_BITS + ORIENTATION_BITS + HEALTH_BITS + SCORE_BITS + INPUT_SEQUENCE_BITS;
+static const unsigned int ROOM_SNAPSHOT_HEADER_WIRE_BYTES = 11;
+static const unsigned int MAXIMUM_ROOM_SNAPSHOT_WIRE_BYTES = ROOM_SNAPSHOT_HEADER_WIRE_BYTES + ( MAXIMUM_PLAYERS_PER_SNAPSHOT * MAXIMUM_PLAYER_DELTA_WIRE_BITS + 7 ) / 8;
+static const unsigned int MAXIMUM_PACKET_WIRE_BYTES = FINAL_PACKET_HEADER_WIRE_BYTES + MAXIMUM_ROOM_SNAPSHOT_WIRE_BYTES;
+
+//-----------------------------------------------------------------------------------------------
+//Returns false for types without a fixed-size body (RoomSnapshot) and for unknown types.
+inline bool GetPacketBodyWireBytes( PacketType type, unsigned int& out_bodyBytes )
+{
+	switch( type )
+	{
+	case TYPE_Ack:				out_bodyBytes = 0;	return true;
+	case TYPE_Nack:				out_bodyBytes = 6;	return true;
+	case TYPE_KeepAlive:		out_bodyBytes = 0;	return true;
+	case TYPE_CreateRoom:		out_bodyBytes = 1;	return true;
+	case TYPE_JoinRoom:			out_bodyBytes = 1;	return true;
+	case TYPE_LobbyUpdate:		out_bodyBytes = 8;	return true;
+	case TYPE_GameReset:		out_bodyBytes = 13;	return true;
+	case TYPE_Respawn:			out_bodyBytes = 12;	return true;
+	case TYPE_Hit:				out_bodyBytes = 3;	return true;
+	case TYPE_Fire:				out_bodyBytes = 9;	return true;
+	case TYPE_ReturnToLobby:	out_bodyBytes = 0;	return true;
+	case TYPE_Input:			out_bodyBytes = INPUT_WIRE_BYTES;	return true;
+	case TYPE_TimeSync:			out_bodyBytes = 16;	return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+
+
+#pragma region Quantization
+//-----------------------------------------------------------------------------------------------
+//Wraps into [0, 360) first, so -90 and 270 come out the same.
+inline int QuantizeOrientation( float orientationDegrees )
+{
+	float wrappedDegrees = fmodf( orientationDegrees, 360.f );
+	if( wrappedDegrees < 0.f )
+		wrappedDegrees += 360.f;
+	if( !( wrappedDegrees >= 0.f ) ) //NaN
+		wrappedDegrees = 0.f;
+
+	unsigned int step = static_cast< unsigned int >( floorf( wrappedDegrees * ORIENTATION_STEPS / 360.f + 0.5f ) );
+	return static_cast< int >( step % ORIENTATION_STEPS ); //Rounding up from 359.9 wraps to 0
+}
+
+//-----------------------------------------------------------------------------------------------
+inline int ClampToBits( unsigned int value, unsigned int numberOfBits )
+{
+	unsigned int maximumValue = ( 1U << numberOfBits ) - 1;
+	return static_cast< int >( ( value > maximumValue ) ? maximumValue : value );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Out-of-range values are clamped, not wrapped, so a bad value stays near the edge it crossed.
+inline void QuantizeGameUpdate( const GameUpdatePacket& update, QuantizedGameUpdate& out_quantized )
+{
+	out_quantized.xPosition = Network::QuantizeFixedPoint( update.xPosition, POSITION_MINIMUM, POSITION_STEPS_PER_UNIT, POSITION_BITS );
+	out_quantized.yPosition = Network::QuantizeFixedPoint( update.yPosition, POSITION_MINIMUM, POSITION_STEPS_PER_UNIT, POSITION_BITS );
+	out_quantized.xVelocity = Network::QuantizeFixedPoint( update.xVelocity, VELOCITY_MINIMUM, VELOCITY_STEPS_PER_UNIT, VELOCITY_BITS );
+	out_quantized.yVelocity = Network::QuantizeFixedPoint( update.yVelocity, VELOCITY_MINIMUM, VELOCITY_STEPS_PER_UNIT, VELOCITY_BITS );
+	out_quantized.xAcceleration = Network::QuantizeFixedPoint( update.xAcceleration, VELOCITY_MINIMUM, VELOCITY_STEPS_PER_UNIT, VELOCITY_BITS );
+	out_quantized.yAcceleration = Network::QuantizeFixedPoint( update.yAcceleration, VELOCITY_MINIMUM, VELOCITY_STEPS_PER_UNIT, VELOCITY_BITS );
+	out_quantized.orientation = QuantizeOrientation( update.orientationDegrees );
+	out_quantized.health = ClampToBits( update.health, HEALTH_BITS );
+	out_quantized.score = ClampToBits( update.score, SCORE_BITS );
+	out_quantized.inputSequence = update.inputSequence;
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void DequantizeGameUpdate( const QuantizedGameUpdate& quantized, GameUpdatePacket& out_update )
+{
+	out_update.xPosition = Network::DequantizeFixedPoint( quantized.xPosition, POSITION_MINIMUM, POSITION_STEPS_PER_UNIT );
+	out_update.yPosition = Network::DequantizeFixedPoint( quantized.yPosition, POSITION_MINIMUM, POSITION_STEPS_PER_UNIT );
+	out_update.xVelocity = Network::DequantizeFixedPoint( quantized.xVelocity, VELOCITY_MINIMUM, VELOCITY_STEPS_PER_UNIT );
+	out_update.yVelocity = Network::DequantizeFixedPoint( quantized.yVelocity, VELOCITY_MINIMUM, VELOCITY_STEPS_PER_UNIT );
+	out_update.xAcceleration = Network::DequantizeFixedPoint( quantized.xAcceleration, VELOCITY_MINIMUM, VELOCITY_STEPS_PER_UNIT );
+	out_update.yAcceleration = Network::DequantizeFixedPoint( quantized.yAcceleration, VELOCITY_MINIMUM, VELOCITY_STEPS_PER_UNIT );
+	out_update.orientationDegrees = static_cast< float >( quantized.orientation ) * 360.f / ORIENTATION_STEPS;
+	out_update.health = static_cast< unsigned char >( quantized.health );
+	out_update.score = static_cast< unsigned char >( quantized.score );
+	out_update.inputSequence = static_cast< InputSequence >( quantized.inputSequence );
+}
+
+//-----------------------------------------------------------------------------------------------
+inline int QuantizeInputMagnitude( float movementMagnitude )
+{
+	if( !( movementMagnitude > 0.f ) ) //Also catches NaN
+		return 0;
+	if( movementMagnitude >= 1.f )
+		return INPUT_MAGNITUDE_STEPS;
+	return static_cast< int >( floorf( movementMagnitude * INPUT_MAGNITUDE_STEPS + 0.5f ) );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Snaps input to what the server will read, so the client predicts with exactly the input the server applies.
+inline void RoundInputToWireSteps( InputPacket& inout_input )
+{
+	inout_input.movementHeadingDegrees = static_cast< float >( QuantizeOrientation( inout_input.movementHeadingDegrees ) ) * 360.f / ORIENTATION_STEPS;
+	inout_input.movementMagnitude = static_cast< float >( QuantizeInputMagnitude( inout_input.movementMagnitude ) ) / INPUT_MAGNITUDE_STEPS;
+}
+
+//-----------------------------------------------------------------------------------------------
+inline DeltaField GetChangedFields( const QuantizedGameUpdate& baseline, const QuantizedGameUpdate& current )
+{
+	DeltaField changedFields = DELTA_None;
+	if( current.xPosition != baseline.xPosition || current.yPosition != baseline.yPosition )
+		changedFields |= DELTA_Position;
+	if( current.xVelocity != baseline.xVelocity || current.yVelocity != baseline.yVelocity )
+		changedFields |= DELTA_Velocity;
+	if( current.xAcceleration != baseline.xAcceleration || current.yAcceleration != baseline.yAcceleration )
+		changedFields |= DELTA_Acceleration;
+	if( current.orientation != baseline.orientation )
+		changedFields |= DELTA_Orientation;
+	if( current.health != baseline.health )
+		changedFields |= DELTA_Health;
+	if( current.score != baseline.score )
+		changedFields |= DELTA_Score;
+	if( current.inputSequence != baseline.inputSequence )
+		changedFields |= DELTA_InputSequence;
+	return changedFields;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Fills out_delta with what turns baseline into current. Pass a null baseline for a player the
+//	receiver hasn't seen yet; every field goes out in full. Returns false if nothing changed.
+inline bool MakePlayerStateDelta( ClientID id, const QuantizedGameUpdate* baseline, const QuantizedGameUpdate& current, PlayerStateDelta& out_delta )
+{
+	static const int MAXIMUM_POSITION_OFFSET = ( 1 << ( POSITION_OFFSET_BITS - 1 ) ) - 1;
+
+	out_delta.id = id;
+	out_delta.changedFields = ( baseline != nullptr ) ? GetChangedFields( *baseline, current ) : DELTA_All;
+	out_delta.positionIsOffset = false;
+	out_delta.state = current;
+	if( out_delta.changedFields == DELTA_None )
+		return false;
+
+	if( baseline != nullptr && ( out_delta.changedFields & DELTA_Position ) )
+	{
+		int xOffset = current.xPosition - baseline->xPosition;
+		int yOffset = current.yPosition - baseline->yPosition;
+		if( abs( xOffset ) <= MAXIMUM_POSITION_OFFSET && abs( yOffset ) <= MAXIMUM_POSITION_OFFSET )
+		{
+			out_delta.positionIsOffset = true;
+			out_delta.state.xPosition = xOffset;
+			out_delta.state.yPosition = yOffset;
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+//state has to start out as the baseline (all zeroes for a player who isn't in it).
+inline void ApplyPlayerStateDelta( const PlayerStateDelta& delta, QuantizedGameUpdate& inout_state )
+{
+	if( delta.changedFields & DELTA_Position )
+	{
+		if( delta.positionIsOffset )
+		{
+			inout_state.xPosition += delta.state.xPosition;
+			inout_state.yPosition += delta.state.yPosition;
+		}
+		else
+		{
+			inout_state.xPosition = delta.state.xPosition;
+			inout_state.yPosition = delta.state.yPosition;
+		}
+	}
+	if( delta.changedFields & DELTA_Velocity )
+	{
+		inout_state.xVelocity = delta.state.xVelocity;
+		inout_state.yVelocity = delta.state.yVelocity;
+	}
+	if( delta.changedFields & DELTA_Acceleration )
+	{
+		inout_state.xAcceleration = delta.state.xAcceleration;
+		inout_state.yAcceleration = delta.state.yAcceleration;
+	}
+	if( delta.changedFields & DELTA_Orientation )
+		inout_state.orientation = delta.state.orientation;
+	if( delta.changedFields & DELTA_Health )
+		inout_state.health = delta.state.health;
+	if( delta.changedFields & DELTA_Score )
+		inout_state.score = delta.state.score;
+	if( delta.changedFields & DELTA_InputSequence )
+		inout_state.inputSequence = delta.state.inputSequence;
+}
+#pragma endregion //Quantization
+
+
+
+#pragma region Writing
+//-----------------------------------------------------------------------------------------------
+inline void WritePacketHeader( Network::ByteWriter& writer, const FinalPacket& packet )
+{
+	writer.WriteUnsignedChar( packet.type );
+	writer.WriteUnsignedChar( packet.clientID );
+	writer.WriteUnsignedInt( packet.number );
+	writer.WriteDouble( packet.timestamp );
+	writer.WriteUnsignedInt( packet.acknowledgedNumber );
+	writer.WriteUnsignedInt( packet.acknowledgedBits );
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void WritePlayerStateDelta( Network::BitWriter& writer, const PlayerStateDelta& delta )
+{
+	static const int POSITION_OFFSET_BIAS = 1 << ( POSITION_OFFSET_BITS - 1 );
+
+	writer.WriteBits( delta.id, 8 );
+	writer.WriteBits( delta.changedFields, DELTA_FIELD_BITS );
+
+	const QuantizedGameUpdate& state = delta.state;
+	if( delta.changedFields & DELTA_Position )
+	{
+		writer.WriteBool( delta.positionIsOffset );
+		if( delta.positionIsOffset )
+		{
+			writer.WriteBits( state.xPosition + POSITION_OFFSET_BIAS, POSITION_OFFSET_BITS );
+			writer.WriteBits( state.yPosition + POSITION_OFFSET_BIAS, POSITION_OFFSET_BITS );
+		}
+		else
+		{
+			writer.WriteBits( state.xPosition, POSITION_BITS );
+			writer.WriteBits( state.yPosition, POSITION_BITS );
+		}
+	}
+	if( delta.changedFields & DELTA_Velocity )
+	{
+		writer.WriteBits( state.xVelocity, VELOCITY_BITS );
+		writer.WriteBits( state.yVelocity, VELOCITY_BITS );
+	}
+	if( delta.changedFields & DELTA_Acceleration )
+	{
+		writer.WriteBits( state.xAcceleration, VELOCITY_BITS );
+		writer.WriteBits( state.yAcceleration, VELOCITY_BITS );
+	}
+	if( delta.changedFields & DELTA_Orientation )
+		writer.WriteBits( state.orientation, ORIENTATION_BITS );
+	if( delta.changedFields & DELTA_Health )
+		writer.WriteBits( state.health, HEALTH_BITS );
+	if( delta.changedFields & DELTA_Score )
+		writer.WriteBits( state.score, SCORE_BITS );
+	if( delta.changedFields & DELTA_InputSequence )
+		writer.WriteBits( state.inputSequence, INPUT_SEQUENCE_BITS );
+}
+
+//-----------------------------------------------------------------------------------------------
+//What WritePlayerStateDelta would write for delta, for budgeting a snapshot before it's encoded.
+inline unsigned int GetPlayerStateDeltaWireBits( const PlayerStateDelta& delta )
+{
+	unsigned int wireBits = 8 + DELTA_FIELD_BITS;
+	if( delta.changedFields & DELTA_Position )
+		wireBits += 1 + 2 * ( delta.positionIsOffset ? POSITION_OFFSET_BITS : POSITION_BITS );
+	if( delta.changedFields & DELTA_Velocity )
+		wireBits += 2 * VELOCITY_BITS;
+	if( delta.changedFields & DELTA_Acceleration )
+		wireBits += 2 * VELOCITY_BITS;
+	if( delta.changedFields & DELTA_Orientation )
+		wireBits += ORIENTATION_BITS;
+	if( delta.changedFields & DELTA_Health )
+		wireBits += HEALTH_BITS;
+	if( delta.changedFields & DELTA_Score )
+		wireBits += SCORE_BITS;
+	if( delta.changedFields & DELTA_InputSequence )
+		wireBits += INPUT_SEQUENCE_BITS;
+	return wireBits;
+}
+
+//-----------------------------------------------------------------------------------------------
+//An upper bound on the bytes a snapshot of numberOfPlayers deltas, playerWireBits in all, takes on the wire
+//	once split into parts, packet headers included.
+inline unsigned int GetRoomSnapshotWireBytes( unsigned int numberOfPlayers, unsigned int playerWireBits )
+{
+	unsigned int numberOfParts = ( numberOfPlayers + MAXIMUM_PLAYERS_PER_SNAPSHOT - 1 ) / MAXIMUM_PLAYERS_PER_SNAPSHOT;
+	if( numberOfParts == 0 )
+		numberOfParts = 1;
+
+	//Each part rounds its players up to a whole byte on its own
+	return numberOfParts * ( FINAL_PACKET_HEADER_WIRE_BYTES + ROOM_SNAPSHOT_HEADER_WIRE_BYTES + 1 ) + playerWireBits / 8;
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void WritePacketBody( Network::ByteWriter& writer, const FinalPacket& packet )
+{
+	switch( packet.type )
+	{
+	case TYPE_Nack:
+		writer.WriteUnsignedChar( packet.data.refused.type );
+		writer.WriteUnsignedInt( packet.data.refused.number );
+		writer.WriteUnsignedChar( packet.data.refused.errorCode );
+		break;
+	case TYPE_CreateRoom:
+		writer.WriteUnsignedChar( packet.data.creating.room );
+		break;
+	case TYPE_JoinRoom:
+		writer.WriteUnsignedChar( packet.data.joining.room );
+		break;
+	case TYPE_LobbyUpdate:
+		for( unsigned int i = 0; i < 8; ++i )
+		{
+			writer.WriteUnsignedChar( static_cast< unsigned char >( packet.data.updatedLobby.playersInRoomNumber[ i ] ) );
+		}
+		break;
+	case TYPE_Input:
+	{
+		char packedInput[ INPUT_WIRE_BYTES ];
+		Network::BitWriter bitWriter( packedInput, INPUT_WIRE_BYTES );
+		bitWriter.WriteBits( packet.data.input.sequence, INPUT_SEQUENCE_BITS );
+		bitWriter.WriteBits( QuantizeOrientation( packet.data.input.movementHeadingDegrees ), ORIENTATION_BITS );
+		bitWriter.WriteBits( QuantizeInputMagnitude( packet.data.input.movementMagnitude ), INPUT_MAGNITUDE_BITS );
+		writer.WriteBytes( packedInput, INPUT_WIRE_BYTES );
+		break;
+	}
+	case TYPE_GameReset:
+		writer.WriteFloat( packet.data.reset.xPosition );
+		writer.WriteFloat( packet.data.reset.yPosition );
+		writer.WriteFloat( packet.data.reset.orientationDegrees );
+		writer.WriteUnsignedChar( packet.data.reset.id );
+		break;
+	case TYPE_Respawn:
+		writer.WriteFloat( packet.data.respawn.xPosition );
+		writer.WriteFloat( packet.data.respawn.yPosition );
+		writer.WriteFloat( packet.data.respawn.orientationDegrees );
+		break;
+	case TYPE_Hit:
+		writer.WriteUnsignedChar( packet.data.hit.instigatorID );
+		writer.WriteUnsignedChar( packet.data.hit.targetID );
+		writer.WriteUnsignedChar( packet.data.hit.damageDealt );
+		break;
+	case TYPE_Fire:
+		writer.WriteUnsignedChar( packet.data.gunfire.instigatorID );
+		writer.WriteDouble( packet.data.gunfire.viewTimestamp );
+		break;
+	case TYPE_TimeSync:
+		writer.WriteDouble( packet.data.timeSync.originTimestamp );
+		writer.WriteDouble( packet.data.timeSync.receiveTimestamp );
+		break;
+	case TYPE_Ack:
+	case TYPE_KeepAlive:
+	case TYPE_ReturnToLobby:
+	default:
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void WriteRoomSnapshot( Network::ByteWriter& writer, const RoomSnapshotPacket& snapshot )
+{
+	writer.WriteUnsignedInt( snapshot.sequence );
+	writer.WriteUnsignedInt( snapshot.baselineSequence );
+	writer.WriteUnsignedChar( snapshot.partIndex );
+	writer.WriteUnsignedChar( snapshot.numberOfParts );
+	writer.WriteUnsignedChar( snapshot.numberOfPlayers );
+
+	//All the players share one bitstream, so only the snapshot as a whole is padded out to a byte
+	char packedPlayers[ MAXIMUM_ROOM_SNAPSHOT_WIRE_BYTES ];
+	Network::BitWriter bitWriter( packedPlayers, MAXIMUM_ROOM_SNAPSHOT_WIRE_BYTES );
+	for( unsigned int i = 0; i < snapshot.numberOfPlayers; ++i )
+	{
+		WritePlayerStateDelta( bitWriter, snapshot.players[ i ] );
+	}
+	writer.WriteBytes( packedPlayers, bitWriter.GetNumberOfBytesWritten() );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Writes the whole message. Returns the number of bytes written, or 0 if the buffer was too small.
+inline unsigned int SerializePacket( const FinalPacket& packet, char* out_buffer, unsigned int bufferBytes )
+{
+	Network::ByteWriter writer( out_buffer, bufferBytes );
+	WritePacketHeader( writer, packet );
+	WritePacketBody( writer, packet );
+
+	if( writer.HasOverflowed() )
+		return 0;
+	return writer.GetNumberOfBytesWritten();
+}
+#pragma endregion //Writing
+
+
+
+#pragma region Reading
+//-----------------------------------------------------------------------------------------------
+inline void ReadPacketHeader( Network::ByteReader& reader, FinalPacket& out_packet )
+{
+	out_packet.type = reader.ReadUnsignedChar();
+	out_packet.clientID = reader.ReadUnsignedChar();
+	out_packet.number = reader.ReadUnsignedInt();
+	out_packet.timestamp = reader.ReadDouble();
+	out_packet.acknowledgedNumber = reader.ReadUnsignedInt();
+	out_packet.acknowledgedBits = reader.ReadUnsignedInt();
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void ReadPlayerStateDelta( Network::BitReader& reader, PlayerStateDelta& out_delta )
+{
+	static const int POSITION_OFFSET_BIAS = 1 << ( POSITION_OFFSET_BITS - 1 );
+
+	memset( &out_delta, 0, sizeof( PlayerStateDelta ) );
+	out_delta.id = static_cast< ClientID >( reader.ReadBits( 8 ) );
+	out_delta.changedFields = static_cast< DeltaField >( reader.ReadBits( DELTA_FIELD_BITS ) );
+
+	QuantizedGameUpdate& state = out_delta.state;
+	if( out_delta.changedFields & DELTA_Position )
+	{
+		out_delta.positionIsOffset = reader.ReadBool();
+		if( out_delta.positionIsOffset )
+		{
+			state.xPosition = static_cast< int >( reader.ReadBits( POSITION_OFFSET_BITS ) ) - POSITION_OFFSET_BIAS;
+			state.yPosition = static_cast< int >( reader.ReadBits( POSITION_OFFSET_BITS ) ) - POSITION_OFFSET_BIAS;
+		}
+		else
+		{
+			state.xPosition = reader.ReadBits( POSITION_BITS );
+			state.yPosition = reader.ReadBits( POSITION_BITS );
+		}
+	}
+	if( out_delta.changedFields & DELTA_Velocity )
+	{
+		state.xVelocity = reader.ReadBits( VELOCITY_BITS );
+		state.yVelocity = reader.ReadBits( VELOCITY_BITS );
+	}
+	if( out_delta.changedFields & DELTA_Acceleration )
+	{
+		state.xAcceleration = reader.ReadBits( VELOCITY_BITS );
+		state.yAcceleration = reader.ReadBits( VELOCITY_BITS );
+	}
+	if( out_delta.changedFields & DELTA_Orientation )
+		state.orientation = reader.ReadBits( ORIENTATION_BITS );
+	if( out_delta.changedFields & DELTA_Health )
+		state.health = reader.ReadBits( HEALTH_BITS );
+	if( out_delta.changedFields & DELTA_Score )
+		state.score = reader.ReadBits( SCORE_BITS );
+	if( out_delta.changedFields & DELTA_InputSequence )
+		state.inputSequence = reader.ReadBits( INPUT_SEQUENCE_BITS );
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void ReadPacketBody( Network::ByteReader& reader, FinalPacket& out_packet )
+{
+	switch( out_packet.type )
+	{
+	case TYPE_Nack:
+		out_packet.data.refused.type = reader.ReadUnsignedChar();
+		out_packet.data.refused.number = reader.ReadUnsignedInt();
+		out_packet.data.refused.errorCode = reader.ReadUnsignedChar();
+		break;
+	case TYPE_CreateRoom:
+		out_packet.data.creating.room = reader.ReadUnsignedChar();
+		break;
+	case TYPE_JoinRoom:
+		out_packet.data.joining.room = reader.ReadUnsignedChar();
+		break;
+	case TYPE_LobbyUpdate:
+		for( unsigned int i = 0; i < 8; ++i )
+		{
+			out_packet.data.updatedLobby.playersInRoomNumber[ i ] = static_cast< char >( reader.ReadUnsignedChar() );
+		}
+		break;
+	case TYPE_Input:
+	{
+		Network::BitReader bitReader( reader.GetRemainingBytes(), reader.GetNumberOfBytesLeft() );
+		out_packet.data.input.sequence = static_cast< InputSequence >( bitReader.ReadBits( INPUT_SEQUENCE_BITS ) );
+		out_packet.data.input.movementHeadingDegrees = static_cast< float >( bitReader.ReadBits( ORIENTATION_BITS ) ) * 360.f / ORIENTATION_STEPS;
+		out_packet.data.input.movementMagnitude = static_cast< float >( bitReader.ReadBits( INPUT_MAGNITUDE_BITS ) ) / INPUT_MAGNITUDE_STEPS;
+		if( bitReader.IsMalformed() )
+			reader.MarkMalformed();
+		else
+			reader.SkipBytes( INPUT_WIRE_BYTES );
+		break;
+	}
+	case TYPE_GameReset:
+		out_packet.data.reset.xPosition = reader.ReadFloat();
+		out_packet.data.reset.yPosition = reader.ReadFloat();
+		out_packet.data.reset.orientationDegrees = reader.ReadFloat();
+		out_packet.data.reset.id = reader.ReadUnsignedChar();
+		break;
+	case TYPE_Respawn:
+		out_packet.data.respawn.xPosition = reader.ReadFloat();
+		out_packet.data.respawn.yPosition = reader.ReadFloat();
+		out_packet.data.respawn.orientationDegrees = reader.ReadFloat();
+		break;
+	case TYPE_Hit:
+		out_packet.data.hit.instigatorID = reader.ReadUnsignedChar();
+		out_packet.data.hit.targetID = reader.ReadUnsignedChar();
+		out_packet.data.hit.damageDealt = reader.ReadUnsignedChar();
+		break;
+	case TYPE_Fire:
+		out_packet.data.gunfire.instigatorID = reader.ReadUnsignedChar();
+		out_packet.data.gunfire.viewTimestamp = reader.ReadDouble();
+		break;
+	case TYPE_TimeSync:
+		out_packet.data.timeSync.originTimestamp = reader.ReadDouble();
+		out_packet.data.timeSync.receiveTimestamp = reader.ReadDouble();
+		break;
+	case TYPE_Ack:
+	case TYPE_KeepAlive:
+	case TYPE_ReturnToLobby:
+	default:
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+//Returns false unless the message is exactly one packet of a known type, with no bytes left over.
+inline bool DeserializePacket( const char* message, unsigned int messageBytes, FinalPacket& out_packet )
+{
+	memset( &out_packet, 0, sizeof( FinalPacket ) );
+
+	Network::ByteReader reader( message, messageBytes );
+	ReadPacketHeader( reader, out_packet );
+	if( reader.IsMalformed() )
+		return false;
+
+	unsigned int expectedBodyBytes = 0;
+	if( !GetPacketBodyWireBytes( out_packet.type, expectedBodyBytes ) || reader.GetNumberOfBytesLeft() != expectedBodyBytes )
+		return false;
+
+	ReadPacketBody( reader, out_packet );
+	return !reader.IsMalformed() && reader.GetNumberOfBytesLeft() == 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Returns false unless the message is exactly one room snapshot.
+inline bool DeserializeRoomSnapshot( const char* message, unsigned int messageBytes, FinalPacket& out_header, RoomSnapshotPacket& out_snapshot )
+{
+	memset( &out_header, 0, sizeof( FinalPacket ) );
+
+	Network::ByteReader reader( message, messageBytes );
+	ReadPacketHeader( reader, out_header );
+	if( reader.IsMalformed() || out_header.type != TYPE_RoomSnapshot )
+		return false;
+
+	out_snapshot.sequence = reader.ReadUnsignedInt();
+	out_snapshot.baselineSequence = reader.ReadUnsignedInt();
+	out_snapshot.partIndex = reader.ReadUnsignedChar();
+	out_snapshot.numberOfParts = reader.ReadUnsignedChar();
+	out_snapshot.numberOfPlayers = reader.ReadUnsignedChar();
+	if( reader.IsMalformed() || out_snapshot.numberOfPlayers > MAXIMUM_PLAYERS_PER_SNAPSHOT )
+		return false;
+	if( out_snapshot.sequence == SNAPSHOT_None || out_snapshot.partIndex >= out_snapshot.numberOfParts )
+		return false;
+
+	Network::BitReader bitReader( reader.GetRemainingBytes(), reader.GetNumberOfBytesLeft() );
+	for( unsigned int i = 0; i < out_snapshot.numberOfPlayers; ++i )
+	{
+		ReadPlayerStateDelta( bitReader, out_snapshot.players[ i ] );
+	}
+	return !bitReader.IsMalformed() && bitReader.GetNumberOfBytesRead() == reader.GetNumberOfBytesLeft();
+}
+#pragma endregion //Reading
+
+#endif //INCLUDED_FINAL_PACKET_SERIALIZATION_HPP
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef INCLUDED_FIXED_STEP_CLOCK_HPP
+#define INCLUDED_FIXED_STEP_CLOCK_HPP
+
+//-----------------------------------------------------------------------------------------------
+//Turns however much time each tick (a server tick or a client frame) happened to take into whole steps of a fixed length.
+//	Time that doesn't make a full step carries over to the next tick, so steps come out at the
+//	configured rate on average whatever the event loop does.
+//A tick that falls far behind only catches up maximumStepsPerTick steps and forgets the rest,
+//	so one slow step can't make the next tick slower still.
+class FixedStepClock
+{
+public:
+	FixedStepClock( unsigned int stepsPerSecond = 60, unsigned int maximumStepsPerTick = 1 ) { SetStepsPerSecond( stepsPerSecond, maximumStepsPerTick ); }
+
+	float GetStepSeconds() const { return m_stepSeconds; }
+	unsigned int GetStepsPerSecond() const { return m_stepsPerSecond; }
+	void Reset() { m_accumulatedSeconds = 0.f; }
+	void SetStepsPerSecond( unsigned int stepsPerSecond, unsigned int maximumStepsPerTick );
+	unsigned int TakeDueSteps( float deltaSeconds );
+
+private:
+	unsigned int m_stepsPerSecond;
+	unsigned int m_maximumStepsPerTick;
+	float m_stepSeconds;
+	float m_accumulatedSeconds;
+};
+
+
+
+//-----------------------------------------------------------------------------------------------
+//Also starts the clock over with no time carried.
+inline void FixedStepClock::SetStepsPerSecond( unsigned int stepsPerSecond, unsigned int maximumStepsPerTick )
+{
+	if( stepsPerSecond == 0 )
+		stepsPerSecond = 1;
+	if( maximumStepsPerTick == 0 )
+		maximumStepsPerTick = 1;
+
+	m_stepsPerSecond = stepsPerSecond;
+	m_maximumStepsPerTick = maximumStepsPerTick;
+	m_stepSeconds = 1.f / static_cast< float >( stepsPerSecond );
+	m_accumulatedSeconds = 0.f;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Adds a tick's time and returns how many steps to run now.
+inline unsigned int FixedStepClock::TakeDueSteps( float deltaSeconds )
+{
+	m_accumulatedSeconds += deltaSeconds;
+
+	unsigned int dueSteps = 0;
+	while( m_accumulatedSeconds >= m_stepSeconds && dueSteps < m_maximumStepsPerTick )
+	{
+		m_accumulatedSeconds -= m_stepSeconds;
+		++dueSteps;
+	}
+
+	if( m_accumulatedSeconds >= m_stepSeconds )
+		m_accumulatedSeconds -= m_stepSeconds * static_cast< float >( static_cast< unsigned int >( m_accumulatedSeconds / m_stepSeconds ) );
+	return dueSteps;
+}
+
+#endif //INCLUDED_FIXED_STEP_CLOCK_HPP
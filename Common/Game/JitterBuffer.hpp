@@ -0,0 +1,178 @@
+#pragma once
+#ifndef INCLUDED_JITTER_BUFFER_HPP
+#define INCLUDED_JITTER_BUFFER_HPP
+
+#include <math.h>
+#include "FinalPacket.hpp"
+
+//-----------------------------------------------------------------------------------------------
+static const double MINIMUM_PLAYOUT_DELAY_SECONDS = 0.01;
+static const double MAXIMUM_PLAYOUT_DELAY_SECONDS = 0.25; //Past this, waiting costs more than the stutter it hides
+static const double PLAYOUT_DELAY_JITTERS = 3.0; //Enough to cover nearly every packet's lateness
+
+//-----------------------------------------------------------------------------------------------
+//Holds the other side's packets until their turn to play out, so jitter in the network doesn't become
+//	jitter on screen. A packet plays out a fixed time after the sender stamped it: the smoothed transit time
+//	(which also absorbs the difference between the two clocks) plus a delay of a few times the measured
+//	jitter, the way RTP does it (RFC 3550).
+//Packets are kept in a fixed ring indexed by packet number modulo CAPACITY and come out in number order.
+//	Once any packet is due, every packet numbered before it goes too, so a late one never holds up the rest.
+class JitterBuffer
+{
+public:
+	static const unsigned int CAPACITY = 128; //Twice the packets the longest playout delay holds at 60 ticks per second
+
+	struct BufferedPacket
+	{
+		FinalPacket header;
+		RoomSnapshotPacket snapshot; //Only for TYPE_RoomSnapshot headers
+		bool isInUse;
+	};
+
+	JitterBuffer() { Clear(); }
+
+	void Clear();
+	double GetJitterSeconds() const { return m_jitterSeconds; }
+	unsigned int GetNumberOfPackets() const { return m_numberOfPackets; }
+	double GetPlayoutDelaySeconds() const;
+	double GetPlayoutTimestamp( double currentTimeSeconds ) const;
+	bool Insert( const FinalPacket& header, const RoomSnapshotPacket* snapshot, double arrivalTimeSeconds );
+	const BufferedPacket* PopNextDuePacket( double currentTimeSeconds );
+
+private:
+	void SkipUnusedOldestSlots();
+
+	BufferedPacket m_packets[ CAPACITY ];
+	unsigned int m_numberOfPackets;
+	PacketNumber m_oldestNumber; //Every packet in the buffer is numbered from m_oldestNumber to m_newestNumber
+	PacketNumber m_newestNumber;
+	PacketNumber m_releasedThroughNumber; //Packets up to this one are due, whatever their own timestamps say
+	double m_transitSeconds; //Smoothed arrival time minus the sender's timestamp
+	double m_lastTransitSeconds;
+	double m_jitterSeconds;
+	bool m_hasTransitSample;
+};
+
+
+
+//-----------------------------------------------------------------------------------------------
+inline void JitterBuffer::Clear()
+{
+	for( unsigned int i = 0; i < CAPACITY; ++i )
+	{
+		m_packets[ i ].isInUse = false;
+	}
+	m_numberOfPackets = 0;
+	m_oldestNumber = 1;
+	m_newestNumber = 0;
+	m_releasedThroughNumber = 0;
+	m_transitSeconds = 0.0;
+	m_lastTransitSeconds = 0.0;
+	m_jitterSeconds = 0.0;
+	m_hasTransitSample = false;
+}
+
+//-----------------------------------------------------------------------------------------------
+inline double JitterBuffer::GetPlayoutDelaySeconds() const
+{
+	double playoutDelaySeconds = PLAYOUT_DELAY_JITTERS * m_jitterSeconds;
+	if( playoutDelaySeconds < MINIMUM_PLAYOUT_DELAY_SECONDS )
+		return MINIMUM_PLAYOUT_DELAY_SECONDS;
+	if( playoutDelaySeconds > MAXIMUM_PLAYOUT_DELAY_SECONDS )
+		return MAXIMUM_PLAYOUT_DELAY_SECONDS;
+	return playoutDelaySeconds;
+}
+
+//-----------------------------------------------------------------------------------------------
+//The sender's timestamp that is playing out now; packets stamped at or before it are due.
+inline double JitterBuffer::GetPlayoutTimestamp( double currentTimeSeconds ) const
+{
+	return currentTimeSeconds - m_transitSeconds - GetPlayoutDelaySeconds();
+}
+
+//-----------------------------------------------------------------------------------------------
+//Every packet from the sender goes through here, so its transit time updates the jitter estimate. Returns
+//	false if the packet is a duplicate or too far from the others to fit in the ring; either way it's dropped.
+//A packet that arrives after later ones were released is due right away.
+inline bool JitterBuffer::Insert( const FinalPacket& header, const RoomSnapshotPacket* snapshot, double arrivalTimeSeconds )
+{
+	double transitSeconds = arrivalTimeSeconds - header.timestamp;
+	if( !m_hasTransitSample )
+	{
+		m_transitSeconds = transitSeconds;
+		m_hasTransitSample = true;
+	}
+	else
+	{
+		m_jitterSeconds += ( fabs( transitSeconds - m_lastTransitSeconds ) - m_jitterSeconds ) / 16.0;
+		m_transitSeconds += ( transitSeconds - m_transitSeconds ) / 16.0;
+	}
+	m_lastTransitSeconds = transitSeconds;
+
+	if( header.number == 0 )
+		return false;
+	if( m_numberOfPackets > 0 && ( header.number + CAPACITY <= m_newestNumber || header.number >= m_oldestNumber + CAPACITY ) )
+		return false;
+
+	BufferedPacket& packet = m_packets[ header.number % CAPACITY ];
+	if( packet.isInUse )
+		return false;
+
+	packet.header = header;
+	if( snapshot != nullptr )
+		packet.snapshot = *snapshot;
+	packet.isInUse = true;
+
+	if( m_numberOfPackets == 0 || header.number < m_oldestNumber )
+		m_oldestNumber = header.number;
+	if( m_numberOfPackets == 0 || header.number > m_newestNumber )
+		m_newestNumber = header.number;
+	++m_numberOfPackets;
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Returns null once nothing more is due. The returned packet stays valid until the next Insert.
+inline const JitterBuffer::BufferedPacket* JitterBuffer::PopNextDuePacket( double currentTimeSeconds )
+{
+	if( m_numberOfPackets == 0 )
+		return nullptr;
+
+	if( m_oldestNumber > m_releasedThroughNumber )
+	{
+		double playoutTimestamp = GetPlayoutTimestamp( currentTimeSeconds );
+		for( PacketNumber number = m_newestNumber; number >= m_oldestNumber; --number )
+		{
+			const BufferedPacket& packet = m_packets[ number % CAPACITY ];
+			if( packet.isInUse && packet.header.number == number && packet.header.timestamp <= playoutTimestamp )
+			{
+				m_releasedThroughNumber = number;
+				break;
+			}
+		}
+
+		if( m_oldestNumber > m_releasedThroughNumber )
+			return nullptr;
+	}
+
+	BufferedPacket& oldestPacket = m_packets[ m_oldestNumber % CAPACITY ];
+	oldestPacket.isInUse = false;
+	--m_numberOfPackets;
+	SkipUnusedOldestSlots();
+	return &oldestPacket;
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void JitterBuffer::SkipUnusedOldestSlots()
+{
+	if( m_numberOfPackets == 0 )
+		return;
+
+	++m_oldestNumber;
+	while( m_oldestNumber < m_newestNumber && !m_packets[ m_oldestNumber % CAPACITY ].isInUse )
+	{
+		++m_oldestNumber;
+	}
+}
+
+#endif //INCLUDED_JITTER_BUFFER_HPP
@@ -0,0 +1,139 @@
+#pragma once
+#ifndef INCLUDED_PLAYER_POSITION_HISTORY_HPP
+#define INCLUDED_PLAYER_POSITION_HISTORY_HPP
+
+#include <bitset>
+#include "../Engine/Math/FloatVector2.hpp"
+
+//-----------------------------------------------------------------------------------------------
+//Where every player in a room was on each of the last CAPACITY ticks, so a shot can be tested against the
+//	room as the shooter saw it. Each tick is a row of x positions and a row of y positions indexed by player ID,
+//	so rewinding to a time is one search over the tick timestamps and then a straight run down two rows.
+class PlayerPositionHistory
+{
+public:
+	static const unsigned int MAXIMUM_TICKS_PER_SECOND = 240; //The fastest a room can simulate
+	static const unsigned int CAPACITY = MAXIMUM_TICKS_PER_SECOND / 2; //Half a second of ticks at the fastest rate, and longer at slower ones
+	static const unsigned int MAXIMUM_PLAYERS = 256; //Indexed by player ID
+
+	//Two recorded ticks and how far between them a rewound time falls
+	struct Rewind
+	{
+		unsigned int olderTick;
+		unsigned int newerTick;
+		float fractionToNewer;
+	};
+
+	PlayerPositionHistory() { Clear(); }
+
+	void Clear();
+	bool GetRewoundPosition( const Rewind& rewind, unsigned char playerID, FloatVector2& out_position ) const;
+	unsigned int GetNumberOfTicks() const { return m_numberOfTicks; }
+	void RecordPosition( unsigned char playerID, const FloatVector2& position );
+	void RecordTick( double timestamp );
+	bool RewindTo( double timestamp, Rewind& out_rewind ) const;
+
+private:
+	unsigned int GetTickSlot( unsigned int index ) const { return ( m_oldestTick + index ) % CAPACITY; } //0 is the oldest tick
+
+	double m_timestamps[ CAPACITY ];
+	float m_xPositions[ CAPACITY ][ MAXIMUM_PLAYERS ];
+	float m_yPositions[ CAPACITY ][ MAXIMUM_PLAYERS ];
+	std::bitset< MAXIMUM_PLAYERS > m_recordedPlayers[ CAPACITY ];
+	unsigned int m_oldestTick;
+	unsigned int m_numberOfTicks;
+};
+
+
+
+//-----------------------------------------------------------------------------------------------
+inline void PlayerPositionHistory::Clear()
+{
+	m_oldestTick = 0;
+	m_numberOfTicks = 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Returns false if the player wasn't in the room on either tick. A player only on one of them is taken from that one.
+inline bool PlayerPositionHistory::GetRewoundPosition( const Rewind& rewind, unsigned char playerID, FloatVector2& out_position ) const
+{
+	bool wasInOlderTick = m_recordedPlayers[ rewind.olderTick ].test( playerID );
+	bool wasInNewerTick = m_recordedPlayers[ rewind.newerTick ].test( playerID );
+	if( !wasInOlderTick && !wasInNewerTick )
+		return false;
+
+	unsigned int fromTick = wasInOlderTick ? rewind.olderTick : rewind.newerTick;
+	unsigned int toTick = wasInNewerTick ? rewind.newerTick : rewind.olderTick;
+	float fromX = m_xPositions[ fromTick ][ playerID ];
+	float fromY = m_yPositions[ fromTick ][ playerID ];
+	out_position.x = fromX + rewind.fractionToNewer * ( m_xPositions[ toTick ][ playerID ] - fromX );
+	out_position.y = fromY + rewind.fractionToNewer * ( m_yPositions[ toTick ][ playerID ] - fromY );
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Fills in the tick RecordTick last started.
+inline void PlayerPositionHistory::RecordPosition( unsigned char playerID, const FloatVector2& position )
+{
+	if( m_numberOfTicks == 0 )
+		return;
+
+	unsigned int newestTick = GetTickSlot( m_numberOfTicks - 1 );
+	m_xPositions[ newestTick ][ playerID ] = position.x;
+	m_yPositions[ newestTick ][ playerID ] = position.y;
+	m_recordedPlayers[ newestTick ].set( playerID );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Starts a tick with no players in it, pushing out the oldest once the ring is full. Ticks have to come in timestamp order.
+inline void PlayerPositionHistory::RecordTick( double timestamp )
+{
+	if( m_numberOfTicks == CAPACITY )
+	{
+		m_oldestTick = ( m_oldestTick + 1 ) % CAPACITY;
+		--m_numberOfTicks;
+	}
+
+	unsigned int newTick = GetTickSlot( m_numberOfTicks );
+	m_timestamps[ newTick ] = timestamp;
+	m_recordedPlayers[ newTick ].reset();
+	++m_numberOfTicks;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Finds the ticks on either side of timestamp. Times outside the history are clamped to its oldest or newest tick.
+//	Returns false if nothing has been recorded.
+inline bool PlayerPositionHistory::RewindTo( double timestamp, Rewind& out_rewind ) const
+{
+	if( m_numberOfTicks == 0 )
+		return false;
+
+	out_rewind.olderTick = GetTickSlot( 0 );
+	out_rewind.newerTick = out_rewind.olderTick;
+	out_rewind.fractionToNewer = 0.f;
+	if( timestamp <= m_timestamps[ out_rewind.olderTick ] )
+		return true;
+
+	//Shots usually rewind a few ticks at most, so the search starts from the newest
+	for( unsigned int index = m_numberOfTicks - 1; index > 0; --index )
+	{
+		unsigned int olderTick = GetTickSlot( index - 1 );
+		unsigned int newerTick = GetTickSlot( index );
+		if( timestamp >= m_timestamps[ newerTick ] )
+		{
+			out_rewind.olderTick = newerTick;
+			out_rewind.newerTick = newerTick;
+			return true;
+		}
+		if( timestamp >= m_timestamps[ olderTick ] )
+		{
+			out_rewind.olderTick = olderTick;
+			out_rewind.newerTick = newerTick;
+			out_rewind.fractionToNewer = static_cast< float >( ( timestamp - m_timestamps[ olderTick ] ) / ( m_timestamps[ newerTick ] - m_timestamps[ olderTick ] ) );
+			return true;
+		}
+	}
+	return true;
+}
+
+#endif //INCLUDED_PLAYER_POSITION_HISTORY_HPP
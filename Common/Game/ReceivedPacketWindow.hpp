@@ -0,0 +1,118 @@
+#pragma once
+#ifndef INCLUDED_RECEIVED_PACKET_WINDOW_HPP
+#define INCLUDED_RECEIVED_PACKET_WINDOW_HPP
+
+#include "FinalPacket.hpp"
+
+//-----------------------------------------------------------------------------------------------
+//Which of the other side's packets we've received, in the form every outgoing header acknowledges them:
+//	the latest packet number plus a bit for each of the ACKNOWLEDGED_BITS before it.
+//Every header repeats the whole window, so an acknowledgement lost with one packet rides along on the next.
+class ReceivedPacketWindow
+{
+public:
+	static const unsigned int ACKNOWLEDGED_BITS = 32;
+
+	ReceivedPacketWindow() { Clear(); }
+
+	void Clear();
+	bool HasUnsentAcknowledgements() const { return m_hasUnsentAcknowledgements; }
+	bool RecordReceivedPacket( PacketNumber number );
+	bool WasPacketReceived( PacketNumber number ) const;
+	void WriteAcknowledgements( FinalPacket& out_packet );
+
+private:
+	PacketNumber m_latestNumber;
+	unsigned int m_previousBits;
+	bool m_hasUnsentAcknowledgements;
+};
+
+
+
+//-----------------------------------------------------------------------------------------------
+//True if packet's header acknowledges the packet we sent as number.
+inline bool IsPacketAcknowledged( const FinalPacket& packet, PacketNumber number )
+{
+	if( number == 0 || number > packet.acknowledgedNumber )
+		return false;
+	if( number == packet.acknowledgedNumber )
+		return true;
+
+	PacketNumber bitIndex = packet.acknowledgedNumber - number - 1;
+	if( bitIndex >= ReceivedPacketWindow::ACKNOWLEDGED_BITS )
+		return false;
+	return ( packet.acknowledgedBits & ( 1U << bitIndex ) ) != 0;
+}
+
+
+
+//-----------------------------------------------------------------------------------------------
+inline void ReceivedPacketWindow::Clear()
+{
+	m_latestNumber = 0;
+	m_previousBits = 0;
+	m_hasUnsentAcknowledgements = false;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Returns false if the packet was already recorded or is too old to acknowledge. Either way a packet
+//	still in the window is acknowledged again, since a resend means our last acknowledgement was lost.
+inline bool ReceivedPacketWindow::RecordReceivedPacket( PacketNumber number )
+{
+	if( number == 0 ) //Unnumbered, like Ack packets, which are never acknowledged themselves
+		return false;
+
+	if( m_latestNumber == 0 || number > m_latestNumber )
+	{
+		PacketNumber shift = number - m_latestNumber;
+		if( m_latestNumber == 0 || shift > ACKNOWLEDGED_BITS )
+			m_previousBits = 0;
+		else
+			m_previousBits = static_cast< unsigned int >( ( ( static_cast< unsigned long long >( m_previousBits ) << 1 ) | 1 ) << ( shift - 1 ) );
+
+		m_latestNumber = number;
+		m_hasUnsentAcknowledgements = true;
+		return true;
+	}
+
+	if( number == m_latestNumber )
+	{
+		m_hasUnsentAcknowledgements = true;
+		return false;
+	}
+
+	PacketNumber bitIndex = m_latestNumber - number - 1;
+	if( bitIndex >= ACKNOWLEDGED_BITS )
+		return false;
+
+	unsigned int bit = 1U << bitIndex;
+	bool isNew = ( m_previousBits & bit ) == 0;
+	m_previousBits |= bit;
+	m_hasUnsentAcknowledgements = true;
+	return isNew;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Packets too old for the window count as received: we can no longer tell, and they can't be acknowledged anyway.
+inline bool ReceivedPacketWindow::WasPacketReceived( PacketNumber number ) const
+{
+	if( number == 0 || m_latestNumber == 0 || number > m_latestNumber )
+		return false;
+	if( number == m_latestNumber )
+		return true;
+
+	PacketNumber bitIndex = m_latestNumber - number - 1;
+	if( bitIndex >= ACKNOWLEDGED_BITS )
+		return true;
+	return ( m_previousBits & ( 1U << bitIndex ) ) != 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void ReceivedPacketWindow::WriteAcknowledgements( FinalPacket& out_packet )
+{
+	out_packet.acknowledgedNumber = m_latestNumber;
+	out_packet.acknowledgedBits = m_previousBits;
+	m_hasUnsentAcknowledgements = false;
+}
+
+#endif //INCLUDED_RECEIVED_PACKET_WINDOW_HPP
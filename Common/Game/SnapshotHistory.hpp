@@ -0,0 +1,77 @@
+#pragma once
+#ifndef INCLUDED_SNAPSHOT_HISTORY_HPP
+#define INCLUDED_SNAPSHOT_HISTORY_HPP
+
+#include <map>
+#include "FinalPacket.hpp"
+
+//-----------------------------------------------------------------------------------------------
+//Every player in a room at one snapshot, by ID, in the steps they are sent in.
+typedef std::map< ClientID, QuantizedGameUpdate > RoomState;
+
+//-----------------------------------------------------------------------------------------------
+//The last HISTORY_LENGTH room states, by snapshot sequence. The server keeps one per room to encode
+//	deltas against; the client keeps one to decode them. Both are the same length, so a baseline the
+//	server still has is always one the client still has.
+class SnapshotHistory
+{
+public:
+	static const unsigned int HISTORY_LENGTH = 32;
+
+	SnapshotHistory() { Clear(); }
+
+	void Clear();
+	const RoomState* Find( SnapshotSequence sequence ) const;
+	SnapshotSequence GetLatestSequence() const { return m_latestSequence; }
+	void Store( SnapshotSequence sequence, const RoomState& state );
+
+private:
+	struct StoredState
+	{
+		SnapshotSequence sequence;
+		RoomState state;
+	};
+
+	StoredState m_storedStates[ HISTORY_LENGTH ];
+	SnapshotSequence m_latestSequence;
+};
+
+
+
+//-----------------------------------------------------------------------------------------------
+//For when the sequences start over, as they do when the client changes rooms.
+inline void SnapshotHistory::Clear()
+{
+	m_latestSequence = SNAPSHOT_None;
+	for( unsigned int i = 0; i < HISTORY_LENGTH; ++i )
+	{
+		m_storedStates[ i ].sequence = SNAPSHOT_None;
+		m_storedStates[ i ].state.clear();
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+//Returns null if the sequence was never stored or has been pushed out by newer ones.
+inline const RoomState* SnapshotHistory::Find( SnapshotSequence sequence ) const
+{
+	if( sequence == SNAPSHOT_None || sequence > m_latestSequence || m_latestSequence - sequence >= HISTORY_LENGTH )
+		return nullptr;
+
+	const StoredState& storedState = m_storedStates[ sequence % HISTORY_LENGTH ];
+	if( storedState.sequence != sequence )
+		return nullptr;
+	return &storedState.state;
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void SnapshotHistory::Store( SnapshotSequence sequence, const RoomState& state )
+{
+	StoredState& storedState = m_storedStates[ sequence % HISTORY_LENGTH ];
+	storedState.sequence = sequence;
+	storedState.state = state;
+
+	if( sequence > m_latestSequence )
+		m_latestSequence = sequence;
+}
+
+#endif //INCLUDED_SNAPSHOT_HISTORY_HPP
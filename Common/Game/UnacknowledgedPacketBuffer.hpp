@@ -0,0 +1,141 @@
+#pragma once
+#ifndef INCLUDED_UNACKNOWLEDGED_PACKET_BUFFER_HPP
+#define INCLUDED_UNACKNOWLEDGED_PACKET_BUFFER_HPP
+
+#include <string.h>
+#include "FinalPacket.hpp"
+#include "FinalPacketSerialization.hpp"
+
+//-----------------------------------------------------------------------------------------------
+enum InsertResult
+{
+	INSERT_Stored = 0,
+	INSERT_PushedOutOlderPacket = 1, //Stored in the slot of a packet CAPACITY older that was never acknowledged; that one is dropped
+	INSERT_BodyTooBig = 2 //Not stored
+};
+
+
+
+//-----------------------------------------------------------------------------------------------
+//Guaranteed packets sent to one peer and not yet acknowledged, in a fixed ring indexed by packet number
+//	modulo CAPACITY. Each keeps its encoded body, so a resend only writes a fresh header.
+//Inserting, finding and removing are a single slot lookup and nothing is allocated after construction.
+class UnacknowledgedPacketBuffer
+{
+public:
+	static const unsigned int CAPACITY = 256; //About four seconds of packets to one client at 60 ticks per second
+
+	struct UnacknowledgedPacket
+	{
+		FinalPacket header; //Only the header fields are kept; the data is in body
+		double sendTimeSeconds; //When it last went out
+		double resendTimeSeconds;
+		unsigned int numberOfResends;
+		unsigned int bodyBytes;
+		char body[ MAXIMUM_FIXED_BODY_WIRE_BYTES ];
+		bool isInUse;
+	};
+
+	UnacknowledgedPacketBuffer() { Clear(); }
+
+	void Clear();
+	UnacknowledgedPacket* Find( PacketNumber number );
+	unsigned int GetNumberOfPackets() const { return m_numberOfPackets; }
+	PacketNumber GetOldestNumber() const { return m_oldestNumber; }
+	PacketNumber GetNewestNumber() const { return m_newestNumber; }
+	InsertResult Insert( const FinalPacket& header, const char* body, unsigned int bodyBytes, double sendTimeSeconds, double resendTimeSeconds );
+	bool Remove( PacketNumber number );
+
+private:
+	void SkipUnusedOldestSlots();
+
+	UnacknowledgedPacket m_packets[ CAPACITY ];
+	unsigned int m_numberOfPackets;
+	PacketNumber m_oldestNumber; //Every packet in the buffer is numbered from m_oldestNumber to m_newestNumber
+	PacketNumber m_newestNumber;
+};
+
+
+
+//-----------------------------------------------------------------------------------------------
+inline void UnacknowledgedPacketBuffer::Clear()
+{
+	for( unsigned int i = 0; i < CAPACITY; ++i )
+	{
+		m_packets[ i ].isInUse = false;
+	}
+	m_numberOfPackets = 0;
+	m_oldestNumber = 1;
+	m_newestNumber = 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+inline UnacknowledgedPacketBuffer::UnacknowledgedPacket* UnacknowledgedPacketBuffer::Find( PacketNumber number )
+{
+	UnacknowledgedPacket& packet = m_packets[ number % CAPACITY ];
+	if( !packet.isInUse || packet.header.number != number )
+		return nullptr;
+	return &packet;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Packet numbers have to go up from one insert to the next.
+inline InsertResult UnacknowledgedPacketBuffer::Insert( const FinalPacket& header, const char* body, unsigned int bodyBytes, double sendTimeSeconds, double resendTimeSeconds )
+{
+	if( bodyBytes > MAXIMUM_FIXED_BODY_WIRE_BYTES )
+		return INSERT_BodyTooBig;
+
+	UnacknowledgedPacket& packet = m_packets[ header.number % CAPACITY ];
+	bool pushedOutOlderPacket = packet.isInUse;
+	if( !pushedOutOlderPacket )
+		++m_numberOfPackets;
+
+	packet.header = header;
+	packet.sendTimeSeconds = sendTimeSeconds;
+	packet.resendTimeSeconds = resendTimeSeconds;
+	packet.numberOfResends = 0;
+	packet.bodyBytes = bodyBytes;
+	memcpy( packet.body, body, bodyBytes );
+	packet.isInUse = true;
+
+	if( m_numberOfPackets == 1 && !pushedOutOlderPacket )
+		m_oldestNumber = header.number;
+	m_newestNumber = header.number;
+	if( m_newestNumber - m_oldestNumber >= CAPACITY )
+		m_oldestNumber = m_newestNumber - CAPACITY + 1;
+	SkipUnusedOldestSlots();
+
+	return pushedOutOlderPacket ? INSERT_PushedOutOlderPacket : INSERT_Stored;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Returns false if the packet wasn't waiting on an acknowledgement.
+inline bool UnacknowledgedPacketBuffer::Remove( PacketNumber number )
+{
+	UnacknowledgedPacket* packet = Find( number );
+	if( packet == nullptr )
+		return false;
+
+	packet->isInUse = false;
+	--m_numberOfPackets;
+	SkipUnusedOldestSlots();
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Keeps walks from m_oldestNumber short when the oldest packets were acknowledged first, as they usually are.
+inline void UnacknowledgedPacketBuffer::SkipUnusedOldestSlots()
+{
+	if( m_numberOfPackets == 0 )
+	{
+		m_oldestNumber = m_newestNumber + 1;
+		return;
+	}
+
+	while( m_oldestNumber < m_newestNumber && Find( m_oldestNumber ) == nullptr )
+	{
+		++m_oldestNumber;
+	}
+}
+
+#endif //INCLUDED_UNACKNOWLEDGED_PACKET_BUFFER_HPP
@@ -5,6 +5,10 @@
 
 //-----------------------------------------------------------------------------------------------
 STATIC const float World::OBJECTIVE_TOUCH_DISTANCE = 10.f;
+STATIC const float World::TANK_COLLISION_RADIUS = 10.f;
+STATIC const float World::INTERPOLATION_DELAY_SECONDS = 0.1f; //Two snapshots at the default 20 per second, so one can go missing; one at the slowest rate the server allows
+STATIC const float World::TANK_SPEED = 600.f; //Units per second at full stick
+STATIC const float World::IT_PLAYER_MOVEMENT_MULTIPLIER = .9f; //It player is slower than the rest.
 
 //-----------------------------------------------------------------------------------------------
 World::World()
@@ -22,6 +26,20 @@ World::World()
 	m_floorMaterial->SetProjectionMatrixUniform( "u_projectionMatrix" );
 }
 
+//-----------------------------------------------------------------------------------------------
+//The client's prediction and the server both move tanks with this, so they agree on where each Input takes one.
+//	An Input is one step of INPUTS_PER_SECOND, so a tank moves at TANK_SPEED however often the client draws frames.
+STATIC FloatVector2 World::GetTankMovementForInput( float movementHeadingDegrees, float movementMagnitude, bool isIt )
+{
+	float headingRadians = ConvertDegreesToRadians( movementHeadingDegrees );
+	FloatVector2 movement( cos( headingRadians ), -sin( headingRadians ) );
+	movement *= movementMagnitude * TANK_SPEED / static_cast< float >( INPUTS_PER_SECOND );
+
+	if( isIt )
+		movement *= IT_PLAYER_MOVEMENT_MULTIPLIER;
+	return movement;
+}
+
 //-----------------------------------------------------------------------------------------------
 //Returns player pointer if player was found; nullptr otherwise
 Entity* World::FindPlayerWithID( unsigned short targetID )
@@ -57,28 +75,11 @@ bool World::RemovePlayer( Entity* player )
 }
 
 //-----------------------------------------------------------------------------------------------
+//Hits are found as each laser is fired (see HandleFireEventFromPlayer); this hands over the ones since the last call.
 void World::CheckForLaserImpacts( std::vector< std::pair< const Entity*, const Entity* > >& out_impactsThisFrame )
 {
-	for( unsigned int i = 0; i < m_players.size(); ++i )
-	{
-		const FloatVector2& playerPosition = m_players[ i ]->GetCurrentPosition();
-
-		for( unsigned int j = 0; j < m_activeLasers.size(); ++i )
-		{
-			const FloatVector2& laserAngleVector = m_activeLasers[ i ]->GetAngleVector();
-			const FloatVector2& laserSource = m_activeLasers[ i ]->GetCurrentPosition();
-
-			FloatVector2 vectorFromPlayerToLaserSource = laserSource - playerPosition;
-			FloatVector2 parallelProjectionOfVectorWithLaser = DotProduct( vectorFromPlayerToLaserSource, laserAngleVector ) * laserAngleVector;
-			float distanceFromPlayerToBeam = ( vectorFromPlayerToLaserSource - parallelProjectionOfVectorWithLaser ).CalculateNorm();
-
-			static const float TANK_SIZE = 10.f;
-			if( distanceFromPlayerToBeam < 10.f )
-			{
-				out_impactsThisFrame.push_back( std::pair< const Entity*, const Entity* >( m_players[ i ], m_activeLasers[ i ]->GetFirer() ) );
-			}
-		}
-	}
+	out_impactsThisFrame.insert( out_impactsThisFrame.end(), m_laserImpacts.begin(), m_laserImpacts.end() );
+	m_laserImpacts.clear();
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -100,10 +101,39 @@ Entity* World::FindPlayerTouchingObjective()
 }
 
 //-----------------------------------------------------------------------------------------------
-void World::HandleFireEventFromPlayer( const Entity* player )
+//Only a world that records player positions (the server's) looks for hits; on a client this just shows the laser.
+//	The other players are rewound to viewTimestamp, when the shooter saw them, and the beam hits every one it
+//	passes within TANK_COLLISION_RADIUS of in front of the shooter.
+void World::HandleFireEventFromPlayer( const Entity* player, double viewTimestamp )
 {
 	LaserBeam* newLaser = new LaserBeam( player );
 	m_activeLasers.push_back( newLaser );
+
+	PlayerPositionHistory::Rewind rewind;
+	if( !m_positionHistory.RewindTo( viewTimestamp, rewind ) )
+		return;
+
+	const FloatVector2& laserSource = newLaser->GetCurrentPosition();
+	const FloatVector2& laserAngleVector = newLaser->GetAngleVector();
+	for( unsigned int i = 0; i < m_players.size(); ++i )
+	{
+		const Entity* target = m_players[ i ];
+		if( target == player || target->GetHealth() == 0 )
+			continue;
+
+		FloatVector2 targetPosition;
+		if( !m_positionHistory.GetRewoundPosition( rewind, target->GetID(), targetPosition ) )
+			continue; //Joined after the shooter's view of the room
+
+		FloatVector2 vectorFromLaserSourceToTarget = targetPosition - laserSource;
+		float distanceAlongBeam = DotProduct( vectorFromLaserSourceToTarget, laserAngleVector );
+		if( distanceAlongBeam < 0.f )
+			continue;
+
+		float distanceFromTargetToBeam = ( vectorFromLaserSourceToTarget - distanceAlongBeam * laserAngleVector ).CalculateNorm();
+		if( distanceFromTargetToBeam < TANK_COLLISION_RADIUS )
+			m_laserImpacts.push_back( std::pair< const Entity*, const Entity* >( target, player ) );
+	}
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -122,6 +152,17 @@ bool World::PlayerIsTouchingObjective( Entity* player )
 	return false;
 }
 
+//-----------------------------------------------------------------------------------------------
+//Once per server tick, after the tick's movement.
+void World::RecordPlayerPositions( double timestamp )
+{
+	m_positionHistory.RecordTick( timestamp );
+	for( unsigned int i = 0; i < m_players.size(); ++i )
+	{
+		m_positionHistory.RecordPosition( m_players[ i ]->GetID(), m_players[ i ]->GetCurrentPosition() );
+	}
+}
+
 //-----------------------------------------------------------------------------------------------
 void World::RenderFloor() const
 {
@@ -200,6 +241,16 @@ void World::Render() const
 	}
 }
 
+//-----------------------------------------------------------------------------------------------
+//Only moves players that have server states; see Entity::InterpolateServerStates.
+void World::InterpolatePlayers( double renderTimestamp )
+{
+	for( unsigned int i = 0; i < m_players.size(); ++i )
+	{
+		m_players[ i ]->InterpolateServerStates( renderTimestamp );
+	}
+}
+
 //-----------------------------------------------------------------------------------------------
 void World::Update( float deltaSeconds )
 {
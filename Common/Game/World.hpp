@@ -7,6 +7,7 @@
 #include "../Engine/Camera.hpp"
 #include "Entity.hpp"
 #include "LaserBeam.hpp"
+#include "PlayerPositionHistory.hpp"
 
 struct MaterialComponent;
 
@@ -14,10 +15,17 @@ struct MaterialComponent;
 class World
 {
 	static const float OBJECTIVE_TOUCH_DISTANCE;
+	static const float TANK_COLLISION_RADIUS;
 
 public:
 	static const unsigned char MAX_HEALTH = 1;
 	static const unsigned char SCORE_NEEDED_TO_WIN = 10;
+	static const unsigned int INPUTS_PER_SECOND = 60; //Clients send one Input per step while driving, whatever their frame rate
+	static const float TANK_SPEED;
+	static const float INTERPOLATION_DELAY_SECONDS;
+	static const float IT_PLAYER_MOVEMENT_MULTIPLIER;
+
+	static FloatVector2 GetTankMovementForInput( float movementHeadingDegrees, float movementMagnitude, bool isIt );
 
 	World();
 	~World();
@@ -31,8 +39,10 @@ public:
 	unsigned char GetNextPlayerID();
 	unsigned int GetNumberOfPlayers() const { return m_players.size(); }
 	const Entity* GetObjective() { return m_objective; }
-	void HandleFireEventFromPlayer( const Entity* player );
+	void HandleFireEventFromPlayer( const Entity* player, double viewTimestamp );
+	void InterpolatePlayers( double renderTimestamp );
 	bool PlayerIsTouchingObjective( Entity* player );
+	void RecordPlayerPositions( double timestamp );
 	void RenderFloor() const;
 	void SetObjective( Entity* newObjective );
 	void UpdateLasers( float deltaSeconds );
@@ -45,6 +55,8 @@ private:
 	Entity* m_objective;
 	std::vector< LaserBeam* > m_activeLasers;
 	std::vector< Entity* > m_players;
+	PlayerPositionHistory m_positionHistory; //Only recorded on the server
+	std::vector< std::pair< const Entity*, const Entity* > > m_laserImpacts; //Target and firer, found as each laser was fired
 	unsigned char m_nextPlayerID;
 	MaterialComponent* m_floorMaterial;
 };
@@ -0,0 +1,109 @@
+#pragma once
+#ifndef INCLUDED_BANDWIDTH_BUDGET_HPP
+#define INCLUDED_BANDWIDTH_BUDGET_HPP
+
+//-----------------------------------------------------------------------------------------------
+static const float BANDWIDTH_BURST_SECONDS = 0.05f; //On top of a snapshot interval, for what goes out between snapshots
+static const float BANDWIDTH_LOSS_THRESHOLD = 0.1f; //More of a sample lost than this is taken as congestion
+static const float BANDWIDTH_DECREASE_FACTOR = 0.75f;
+
+//-----------------------------------------------------------------------------------------------
+//How many bytes one client may be sent, as a bucket refilled every tick at the client's current rate.
+//	It holds a whole snapshot interval's worth, since most of it goes out at once in each snapshot.
+//	The rate starts at the configured maximum and follows the loss the client's acks show: each sample
+//	of PACKETS_PER_LOSS_SAMPLE packets either cuts it by a quarter or adds back a slice of the maximum.
+//Spending can overdraw the bucket, so messages that must go out still do; the next ticks pay for them.
+class BandwidthBudget
+{
+public:
+	static const unsigned int DEFAULT_MAXIMUM_BYTES_PER_SECOND = 64 * 1024;
+	static const unsigned int MINIMUM_BYTES_PER_SECOND = 4 * 1024;
+	static const unsigned int PACKETS_PER_LOSS_SAMPLE = 64;
+	static const unsigned int INCREASE_SLICES = 32; //Samples it takes to climb back from nothing to the maximum
+
+	BandwidthBudget() { SetMaximumBytesPerSecond( DEFAULT_MAXIMUM_BYTES_PER_SECOND ); }
+
+	void AddTickAllowance( float deltaSeconds, float snapshotSeconds );
+	int GetAvailableBytes() const { return static_cast< int >( m_availableBytes ); }
+	unsigned int GetBytesPerSecond() const { return m_bytesPerSecond; }
+	float GetLastLossFraction() const { return m_lastLossFraction; }
+	void RecordDeliveredPacket();
+	void RecordLostPacket();
+	void SetMaximumBytesPerSecond( unsigned int bytesPerSecond );
+	void Spend( unsigned int numberOfBytes ) { m_availableBytes -= static_cast< float >( numberOfBytes ); }
+
+private:
+	void UpdateRateFromLossSample();
+
+	unsigned int m_maximumBytesPerSecond;
+	unsigned int m_bytesPerSecond;
+	float m_availableBytes;
+	unsigned int m_deliveredPackets; //In the current loss sample
+	unsigned int m_lostPackets;
+	float m_lastLossFraction;
+};
+
+
+
+//-----------------------------------------------------------------------------------------------
+inline void BandwidthBudget::AddTickAllowance( float deltaSeconds, float snapshotSeconds )
+{
+	m_availableBytes += static_cast< float >( m_bytesPerSecond ) * deltaSeconds;
+
+	float maximumAvailableBytes = static_cast< float >( m_bytesPerSecond ) * ( snapshotSeconds + BANDWIDTH_BURST_SECONDS );
+	if( m_availableBytes > maximumAvailableBytes )
+		m_availableBytes = maximumAvailableBytes;
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void BandwidthBudget::RecordDeliveredPacket()
+{
+	++m_deliveredPackets;
+	if( m_deliveredPackets + m_lostPackets >= PACKETS_PER_LOSS_SAMPLE )
+		UpdateRateFromLossSample();
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void BandwidthBudget::RecordLostPacket()
+{
+	++m_lostPackets;
+	if( m_deliveredPackets + m_lostPackets >= PACKETS_PER_LOSS_SAMPLE )
+		UpdateRateFromLossSample();
+}
+
+//-----------------------------------------------------------------------------------------------
+//Also starts the client over at the new maximum.
+inline void BandwidthBudget::SetMaximumBytesPerSecond( unsigned int bytesPerSecond )
+{
+	if( bytesPerSecond < MINIMUM_BYTES_PER_SECOND )
+		bytesPerSecond = MINIMUM_BYTES_PER_SECOND;
+
+	m_maximumBytesPerSecond = bytesPerSecond;
+	m_bytesPerSecond = bytesPerSecond;
+	m_availableBytes = 0.f;
+	m_deliveredPackets = 0;
+	m_lostPackets = 0;
+	m_lastLossFraction = 0.f;
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void BandwidthBudget::UpdateRateFromLossSample()
+{
+	m_lastLossFraction = static_cast< float >( m_lostPackets ) / static_cast< float >( m_deliveredPackets + m_lostPackets );
+	m_deliveredPackets = 0;
+	m_lostPackets = 0;
+
+	if( m_lastLossFraction > BANDWIDTH_LOSS_THRESHOLD )
+	{
+		m_bytesPerSecond = static_cast< unsigned int >( m_bytesPerSecond * BANDWIDTH_DECREASE_FACTOR );
+		if( m_bytesPerSecond < MINIMUM_BYTES_PER_SECOND )
+			m_bytesPerSecond = MINIMUM_BYTES_PER_SECOND;
+		return;
+	}
+
+	m_bytesPerSecond += m_maximumBytesPerSecond / INCREASE_SLICES;
+	if( m_bytesPerSecond > m_maximumBytesPerSecond )
+		m_bytesPerSecond = m_maximumBytesPerSecond;
+}
+
+#endif //INCLUDED_BANDWIDTH_BUDGET_HPP
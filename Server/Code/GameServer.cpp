@@ -2,34 +2,92 @@
 
 #include "../../Common/Engine/EngineCommon.hpp"
 #include "../../Common/Engine/EngineMath.hpp"
+#include "../../Common/Engine/IOUringSocket.hpp"
 #include "../../Common/Engine/TimeInterface.hpp"
+#include "../../Common/Engine/UDPSocket.hpp"
+#include "../../Common/Game/JitterBuffer.hpp"
+#include "ServerWorkerRouter.hpp"
 
 STATIC const float GameServer::SECONDS_BEFORE_CLIENT_TIMES_OUT = 5.f;
-STATIC const float GameServer::SECONDS_BEFORE_GUARANTEED_PACKET_RESENT = 1.f;
 STATIC const float GameServer::SECONDS_SINCE_LAST_CLIENT_PRINTOUT = 5.f;
+STATIC const float GameServer::INTEREST_ENTER_RADIUS = 200.f;
+STATIC const float GameServer::INTEREST_EXIT_RADIUS = 250.f; //Wider than the enter radius so players on the edge don't flicker in and out
+STATIC const float GameServer::OWN_PLAYER_PRIORITY = 4.f; //A client's own player drives its prediction, so it waits the least
+STATIC const float GameServer::OTHER_PLAYER_PRIORITY = 1.f;
+STATIC const float GameServer::MAXIMUM_REWIND_SECONDS = 0.5f; //What PlayerPositionHistory::CAPACITY holds at the fastest simulation rate
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::Initialize( const std::string& portNumber )
+void GameServer::Initialize( const std::string& portNumber, NetworkEngine engine, ServerWorkerRouter* router, unsigned int workerIndex )
 {
-	m_serverSocket.Initialize();
+	m_router = router;
+	m_workerIndex = workerIndex;
+	m_randomNumberGenerator.seed( std::random_device()() + workerIndex ); //rand() shares one state across the workers' threads
 
-	int bindingResult = m_serverSocket.Bind( "0.0.0.0", portNumber );
+#if defined( PLATFORM_LINUX )
+	if( engine == ENGINE_IOUring )
+	{
+		m_serverSocket = new Network::IOUringSocket();
+		if( m_serverSocket->Initialize() == 0 )
+		{
+			printf( "Using the io_uring network engine.\n" );
+		}
+		else
+		{
+			printf( "WARNING: Unable to start the io_uring network engine. Falling back to sockets.\n" );
+			delete m_serverSocket;
+			m_serverSocket = nullptr;
+		}
+	}
+#else
+	if( engine == ENGINE_IOUring )
+		printf( "WARNING: The io_uring network engine is only available on Linux. Falling back to sockets.\n" );
+#endif
+
+	if( m_serverSocket == nullptr )
+	{
+		m_serverSocket = new Network::UDPSocket();
+		m_serverSocket->Initialize();
+	}
+
+	//Every worker binds its own socket to the same port and the kernel spreads clients between them
+	if( m_router != nullptr && m_serverSocket->EnablePortSharing() < 0 )
+	{
+		int errorCode = Network::GetLastSocketErrorCode();
+		printf( "Unable to share the server port between worker threads. Error Code: %i.\n", errorCode );
+		exit( -6 );
+	}
+
+	int bindingResult = m_serverSocket->Bind( "0.0.0.0", portNumber );
 	if( bindingResult < 0 )
 	{
-		int errorCode = WSAGetLastError();
+		int errorCode = Network::GetLastSocketErrorCode();
 		printf( "Unable to bind server socket for listening. Error Code: %i.\n", errorCode );
 		exit( -5 );
 	}
 
-	m_serverSocket.SetFunctionsToNonbindingMode();
+	m_serverSocket->SetFunctionsToNonbindingMode();
 }
 
 //-----------------------------------------------------------------------------------------------
 void GameServer::Update( float deltaSeconds )
 {
+	//Each client's bandwidth budget and Input allowance refill once per tick, before anything this tick is sent or applied
+	for( unsigned int i = 0; i < m_clientList.size(); ++i )
+	{
+		ClientInfo*& client = m_clientList[ i ];
+		float snapshotSeconds = m_lobbyUpdateClock.GetStepSeconds();
+		if( client->currentRoom != ROOM_None && client->currentRoom != ROOM_Lobby )
+			snapshotSeconds = m_snapshotClocks[ client->currentRoom - 1 ].GetStepSeconds();
+		client->bandwidth.AddTickAllowance( deltaSeconds, snapshotSeconds );
+
+		client->inputAllowance += deltaSeconds * static_cast< float >( World::INPUTS_PER_SECOND );
+		if( client->inputAllowance > static_cast< float >( MAXIMUM_BANKED_INPUTS ) )
+			client->inputAllowance = static_cast< float >( MAXIMUM_BANKED_INPUTS );
+	}
+
 	ProcessNetworkQueue();
 	UpdateGameState( deltaSeconds );
-	BroadcastGameStateToClients();
+	BroadcastGameStateToClients( deltaSeconds );
 
 	//Remove all clients that have timed out
 	for( unsigned int i = 0; i < m_clientList.size(); ++i )
@@ -41,7 +99,9 @@ void GameServer::Update( float deltaSeconds )
 			printf( "Removed client %i @%s:%i for timing out.\n", client->id, client->ipAddress.c_str(), client->portNumber );
 			if( client->ownsCurrentRoom )
 				CloseRoom( client->currentRoom );
-			m_clientList.erase( m_clientList.begin() + i );
+			ClientInfo* timedOutClient = client;
+			DetachClient( timedOutClient );
+			delete timedOutClient;
 			--i;
 		}
 	}
@@ -54,31 +114,52 @@ void GameServer::Update( float deltaSeconds )
 	}
 
 	//Print all connected Clients
-	static float secondsSinceClientsLastPrinted = 0.f;
-	if( secondsSinceClientsLastPrinted > SECONDS_SINCE_LAST_CLIENT_PRINTOUT )
+	if( m_secondsSinceClientsLastPrinted > SECONDS_SINCE_LAST_CLIENT_PRINTOUT )
 	{
 		PrintConnectedClients();
-		secondsSinceClientsLastPrinted = 0.f;
+		PrintDroppedTraffic();
+		m_secondsSinceClientsLastPrinted = 0.f;
 	}
-	secondsSinceClientsLastPrinted += deltaSeconds;
+	m_secondsSinceClientsLastPrinted += deltaSeconds;
+
+	//Clients we sent nothing else to since their last packets arrived get an Ack on its own
+	for( unsigned int i = 0; i < m_clientList.size(); ++i )
+	{
+		ClientInfo*& client = m_clientList[ i ];
+		if( client->receivedPackets.HasUnsentAcknowledgements() )
+			SendAcknowledgementToClient( client );
+	}
+
+	FlushPacketsToClients();
 }
 
+//-----------------------------------------------------------------------------------------------
+//Descriptor that turns readable when other workers forward datagrams to us, or -1 in single-threaded mode.
+int GameServer::GetInboxReadinessDescriptor() const
+{
+	if( m_router == nullptr )
+		return -1;
 
+	return m_router->GetInboxReadinessDescriptor( m_workerIndex );
+}
 
-#pragma region Server Helper Functions
 //-----------------------------------------------------------------------------------------------
-void GameServer::AcknowledgePacketFromClient( const MainPacketType& packet, ClientInfo* client )
+//Handles packets as soon as they arrive, between ticks; replies such as Nacks go out right away.
+//Acknowledgements wait for the next packet to the client, or for the end of the tick.
+void GameServer::HandleIncomingPackets()
 {
-	MainPacketType ackPacket;
-	ackPacket.type = TYPE_Ack;
-	ackPacket.clientID = client->id;
-	ackPacket.number = client->GetNextPacketNumber();
-	ackPacket.timestamp = GetCurrentTimeSeconds();
+	ProcessNetworkQueue();
+	FlushPacketsToClients();
+}
 
-	ackPacket.data.acknowledged.type = packet.type;
-	ackPacket.data.acknowledged.number = packet.number;
 
-	SendPacketToClient( ackPacket, client );
+
+#pragma region Server Helper Functions
+//-----------------------------------------------------------------------------------------------
+//Nothing is sent here; the packet is acknowledged in the header of whatever goes to the client next.
+void GameServer::AcknowledgePacketFromClient( const MainPacketType& packet, ClientInfo* client )
+{
+	client->receivedPackets.RecordReceivedPacket( packet.number );
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -91,31 +172,87 @@ void GameServer::RefusePacketFromClient( const MainPacketType& packet, ClientInf
 	nackPacket.timestamp = GetCurrentTimeSeconds();
 
 	nackPacket.data.refused.type = packet.type;
-	nackPacket.data.refused.type = packet.number;
+	nackPacket.data.refused.number = packet.number;
 	nackPacket.data.refused.errorCode = errorCode;
 
 	SendPacketToClient( nackPacket, client );
 }
 
 //-----------------------------------------------------------------------------------------------
-ClientInfo* GameServer::AddNewClient( const std::string& ipAddress, unsigned short portNumber )
+ClientInfo* GameServer::AddNewClient( const sockaddr_in& address )
 {
-	m_clientList.push_back( new ClientInfo() );
-	ClientInfo* newClient = m_clientList.back();
+	char addressBuffer[ 32 ];
+	ClientInfo* newClient = new ClientInfo();
 
-	newClient->id = m_nextClientID;
-	++m_nextClientID;
+	if( m_router != nullptr )
+	{
+		newClient->id = m_router->GetNextClientID();
+	}
+	else
+	{
+		newClient->id = m_nextClientID;
+		++m_nextClientID;
+	}
 
-	newClient->ipAddress = ipAddress;
-	newClient->portNumber = portNumber;
+	newClient->address = address;
+	newClient->endpoint = Network::MakeEndpointKey( address );
+	Network::UDPSocket::GetSockaddrAddressAsString( &address, addressBuffer, 32 );
+	newClient->ipAddress = addressBuffer;
+	newClient->portNumber = Network::UDPSocket::GetSockaddrPort( &address );
 	newClient->currentPacketNumber = 1;
 	newClient->secondsSinceLastReceivedPacket = 0.f;
 	newClient->currentRoom = ROOM_None;
+	newClient->bandwidth.SetMaximumBytesPerSecond( m_maximumClientBytesPerSecond );
+
+	AttachClient( newClient );
 	return newClient;
 }
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::BroadcastGameStateToClients()
+//Every hit lands here once, on the tick after the shot was tested against the room as the shooter saw it.
+void GameServer::ApplyLaserImpactsInRoom( RoomID room )
+{
+	World* world = GetRoomWithID( room );
+	m_laserImpacts.clear();
+	world->CheckForLaserImpacts( m_laserImpacts );
+
+	for( unsigned int i = 0; i < m_laserImpacts.size(); ++i )
+	{
+		Entity* hitPlayer = world->FindPlayerWithID( m_laserImpacts[ i ].first->GetID() );
+		Entity* firingPlayer = world->FindPlayerWithID( m_laserImpacts[ i ].second->GetID() );
+		if( hitPlayer == nullptr || hitPlayer->GetHealth() == 0 )
+			continue;
+
+		unsigned char damageDealt = LaserBeam::DAMAGE_DEALT_ON_HIT;
+		if( damageDealt > hitPlayer->GetHealth() )
+			damageDealt = hitPlayer->GetHealth();
+		hitPlayer->SetHealth( hitPlayer->GetHealth() - damageDealt );
+		if( hitPlayer->GetHealth() == 0 && firingPlayer != nullptr )
+			firingPlayer->SetScore( firingPlayer->GetScore() + 1 );
+
+		MainPacketType hitPacket;
+		hitPacket.type = TYPE_Hit;
+		hitPacket.clientID = ID_None;
+		hitPacket.data.hit.instigatorID = ( firingPlayer != nullptr ) ? firingPlayer->GetID() : ID_None;
+		hitPacket.data.hit.targetID = hitPlayer->GetID();
+		hitPacket.data.hit.damageDealt = damageDealt;
+		BroadcastPacketToAllPlayersInRoom( hitPacket, room );
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+void GameServer::AttachClient( ClientInfo* client )
+{
+	m_clientList.push_back( client );
+	m_clientsByEndpoint.Insert( client->endpoint, client );
+
+	if( m_router != nullptr )
+		m_router->SetWorkerForEndpoint( client->endpoint, m_workerIndex );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Lobby updates and each room's snapshots go out on their own clocks, which can run slower than the simulation.
+void GameServer::BroadcastGameStateToClients( float deltaSeconds )
 {
 	MainPacketType lobbyUpdatePacket;
 	lobbyUpdatePacket.type = TYPE_LobbyUpdate;
@@ -123,10 +260,34 @@ void GameServer::BroadcastGameStateToClients()
 
 	for( unsigned int i = 0; i < MAXIMUM_NUMBER_OF_GAME_ROOMS; ++i )
 	{
-		if( m_openRooms[ i ] == nullptr )
-			lobbyUpdatePacket.data.updatedLobby.playersInRoomNumber[ i ] = 0;
-		else
-			lobbyUpdatePacket.data.updatedLobby.playersInRoomNumber[ i ] = m_openRooms[ i ]->GetNumberOfPlayers();
+		char playersInRoom = 0;
+		if( m_openRooms[ i ] != nullptr )
+			playersInRoom = m_openRooms[ i ]->GetNumberOfPlayers();
+
+		if( m_router == nullptr )
+		{
+			lobbyUpdatePacket.data.updatedLobby.playersInRoomNumber[ i ] = playersInRoom;
+			continue;
+		}
+
+		//Lobby clients can sit on any worker, so every room's count goes through the router
+		RoomID room = static_cast< RoomID >( i + 1 );
+		if( m_router->GetWorkerOwningRoom( room ) == m_workerIndex )
+			m_router->SetPlayersInRoom( room, playersInRoom );
+		lobbyUpdatePacket.data.updatedLobby.playersInRoomNumber[ i ] = m_router->GetPlayersInRoom( room );
+	}
+
+	//Every receiver gets the same body and timestamp; only the packet number differs
+	double broadcastTimestamp = GetCurrentTimeSeconds();
+	lobbyUpdatePacket.timestamp = broadcastTimestamp;
+	const char* lobbyUpdateBody = nullptr;
+	unsigned int lobbyUpdateBodyBytes = 0;
+	bool isLobbyUpdateDue = ( m_lobbyUpdateClock.TakeDueSteps( deltaSeconds ) > 0 );
+
+	//One pass over the clients sorts them by room, so each room's snapshot only looks at its own players
+	for( unsigned int i = 0; i < MAXIMUM_NUMBER_OF_GAME_ROOMS; ++i )
+	{
+		m_clientsInRoom[ i ].clear();
 	}
 
 	for( unsigned int i = 0; i < m_clientList.size(); ++i )
@@ -134,49 +295,42 @@ void GameServer::BroadcastGameStateToClients()
 		ClientInfo*& broadcastedClient = m_clientList[ i ];
 		if( broadcastedClient->currentRoom == ROOM_Lobby )
 		{
-			lobbyUpdatePacket.number = broadcastedClient->currentPacketNumber;
-			++broadcastedClient->currentPacketNumber;
-			SendPacketToClient( lobbyUpdatePacket, broadcastedClient );
-			continue; 
-		}
-
-		MainPacketType updatePacket;
-		updatePacket.type = TYPE_GameUpdate;
-		updatePacket.clientID = broadcastedClient->id;
-
-		Vector2 currentPosition = broadcastedClient->ownedPlayer->GetCurrentPosition();
-		updatePacket.data.updatedGame.xPosition = currentPosition.x;
-		updatePacket.data.updatedGame.yPosition = currentPosition.y;
-
-		Vector2 currentVelocity = broadcastedClient->ownedPlayer->GetCurrentVelocity();
-		updatePacket.data.updatedGame.xVelocity = currentVelocity.x;
-		updatePacket.data.updatedGame.yVelocity = currentVelocity.y;
+			if( !isLobbyUpdateDue )
+				continue;
 
-		Vector2 currentAcceleration = broadcastedClient->ownedPlayer->GetCurrentAcceleration();
-		updatePacket.data.updatedGame.xAcceleration = currentAcceleration.x;
-		updatePacket.data.updatedGame.yAcceleration = currentAcceleration.y;
+			//Every lobby update replaces the last, so one can be skipped while the client's budget is overdrawn
+			if( broadcastedClient->bandwidth.GetAvailableBytes() < 0 )
+				continue;
 
-		updatePacket.data.updatedGame.orientationDegrees = broadcastedClient->ownedPlayer->GetCurrentOrientation();
+			if( lobbyUpdateBody == nullptr )
+				lobbyUpdateBody = EncodeSharedBody( lobbyUpdatePacket, lobbyUpdateBodyBytes );
 
-		updatePacket.data.updatedGame.health = broadcastedClient->ownedPlayer->GetHealth();
-		updatePacket.data.updatedGame.score = broadcastedClient->ownedPlayer->GetScore();
+			lobbyUpdatePacket.number = broadcastedClient->GetNextPacketNumber();
+			SendPacketToClientWithSharedBody( lobbyUpdatePacket, lobbyUpdateBody, lobbyUpdateBodyBytes, broadcastedClient );
+			continue; 
+		}
 
-		for( unsigned int j = 0; j < m_clientList.size(); ++j )
-		{
-			ClientInfo*& receivingClient = m_clientList[ j ];
-			if( receivingClient->currentRoom != broadcastedClient->currentRoom )
-				continue;
+		if( broadcastedClient->currentRoom != ROOM_None && broadcastedClient->ownedPlayer != nullptr )
+			m_clientsInRoom[ broadcastedClient->currentRoom - 1 ].push_back( broadcastedClient );
+	}
 
-			updatePacket.number = receivingClient->currentPacketNumber;
-			++receivingClient->currentPacketNumber;
-			SendPacketToClient( updatePacket, receivingClient );
-		}
+	for( unsigned int i = 0; i < MAXIMUM_NUMBER_OF_GAME_ROOMS; ++i )
+	{
+		//Snapshots that fell due in the same late tick go out as one; the latest state covers them all
+		if( m_snapshotClocks[ i ].TakeDueSteps( deltaSeconds ) > 0 )
+			BroadcastSnapshotOfRoom( static_cast< RoomID >( i + 1 ), broadcastTimestamp );
 	}
 }
 
 //-----------------------------------------------------------------------------------------------
+//The body is encoded once for the whole room; each receiver only gets its own header.
 void GameServer::BroadcastPacketToAllPlayersInRoom( const MainPacketType& packet, RoomID room )
 {
+	MainPacketType packetCopy = packet;
+	packetCopy.timestamp = GetCurrentTimeSeconds();
+	unsigned int sharedBodyBytes = 0;
+	const char* sharedBody = EncodeSharedBody( packetCopy, sharedBodyBytes );
+
 	for( unsigned int i = 0; i < m_clientList.size(); ++i )
 	{
 		ClientInfo*& receivingClient = m_clientList[ i ];
@@ -184,10 +338,106 @@ void GameServer::BroadcastPacketToAllPlayersInRoom( const MainPacketType& packet
 		if( receivingClient->currentRoom != room )
 			continue;
 
-		MainPacketType packetCopy = packet;
 		packetCopy.number = receivingClient->GetNextPacketNumber();
-		packetCopy.timestamp = GetCurrentTimeSeconds();
-		SendPacketToClient( packetCopy, receivingClient );
+		SendPacketToClientWithSharedBody( packetCopy, sharedBody, sharedBodyBytes, receivingClient );
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+//Sends the room's state to everyone in it as a delta against the last snapshot each of them acknowledged.
+//	Players outside a receiver's area of interest are only sent every SNAPSHOTS_BETWEEN_DISTANT_UPDATES snapshots,
+//	and changed players that don't fit in the receiver's bandwidth budget wait for a later one.
+//	Receivers that track every player and have the same baseline share one encoding.
+//Expects m_clientsInRoom to be filled in for this tick.
+void GameServer::BroadcastSnapshotOfRoom( RoomID room, double timestamp )
+{
+	std::vector< ClientInfo* >& clientsInRoom = m_clientsInRoom[ room - 1 ];
+	if( clientsInRoom.empty() )
+		return;
+
+	m_currentRoomState.clear();
+	m_interestGrid.Clear();
+	for( unsigned int i = 0; i < clientsInRoom.size(); ++i )
+	{
+		ClientInfo*& snapshottedClient = clientsInRoom[ i ];
+		GameUpdatePacket playerState;
+
+		Vector2 currentPosition = snapshottedClient->ownedPlayer->GetCurrentPosition();
+		playerState.xPosition = currentPosition.x;
+		playerState.yPosition = currentPosition.y;
+		m_interestGrid.Insert( snapshottedClient->id, currentPosition.x, currentPosition.y );
+
+		Vector2 currentVelocity = snapshottedClient->ownedPlayer->GetCurrentVelocity();
+		playerState.xVelocity = currentVelocity.x;
+		playerState.yVelocity = currentVelocity.y;
+
+		Vector2 currentAcceleration = snapshottedClient->ownedPlayer->GetCurrentAcceleration();
+		playerState.xAcceleration = currentAcceleration.x;
+		playerState.yAcceleration = currentAcceleration.y;
+
+		playerState.orientationDegrees = snapshottedClient->ownedPlayer->GetCurrentOrientation();
+
+		playerState.health = snapshottedClient->ownedPlayer->GetHealth();
+		playerState.score = snapshottedClient->ownedPlayer->GetScore();
+		playerState.inputSequence = snapshottedClient->lastInputSequence;
+		QuantizeGameUpdate( playerState, m_currentRoomState[ snapshottedClient->id ] );
+	}
+
+	m_interestGrid.SortEntries();
+
+	SnapshotHistory& roomSnapshots = m_roomSnapshots[ room - 1 ];
+	SnapshotSequence sequence = roomSnapshots.GetLatestSequence() + 1;
+	roomSnapshots.Store( sequence, m_currentRoomState );
+
+	MainPacketType snapshotHeader;
+	snapshotHeader.type = TYPE_RoomSnapshot;
+	snapshotHeader.clientID = ID_None;
+	snapshotHeader.timestamp = timestamp;
+
+	m_encodedSnapshotParts.clear();
+	for( unsigned int i = 0; i < clientsInRoom.size(); ++i )
+	{
+		ClientInfo*& receivingClient = clientsInRoom[ i ];
+
+		//Distant players are all brought up to date at once, on a snapshot that differs from client to client
+		UpdateNearbyPlayersOfClient( receivingClient );
+		PlayerSet trackedPlayers = receivingClient->nearbyPlayers;
+		if( trackedPlayers.count() == clientsInRoom.size() || ( sequence + receivingClient->id ) % SNAPSHOTS_BETWEEN_DISTANT_UPDATES == 0 )
+			trackedPlayers.set();
+
+		//Baselines too old to still be in the history get a full snapshot instead
+		SnapshotSequence baselineSequence = receivingClient->acknowledgedSnapshot;
+		const RoomState* baseline = roomSnapshots.Find( baselineSequence );
+		const PlayerSet* trackedAtBaseline = receivingClient->FindTrackedPlayers( baselineSequence );
+		if( baseline == nullptr || trackedAtBaseline == nullptr )
+		{
+			baselineSequence = SNAPSHOT_None;
+			baseline = nullptr;
+			trackedAtBaseline = nullptr;
+		}
+
+		LimitTrackedPlayersToBudget( receivingClient, baseline, trackedAtBaseline, trackedPlayers );
+		receivingClient->RecordTrackedPlayers( sequence, trackedPlayers );
+
+		bool isShared = trackedPlayers.all() && ( trackedAtBaseline == nullptr || trackedAtBaseline->all() );
+		unsigned int firstPart = 0;
+		while( firstPart < m_encodedSnapshotParts.size() )
+		{
+			const EncodedSnapshotPart& encodedPart = m_encodedSnapshotParts[ firstPart ];
+			if( isShared && encodedPart.isShared && encodedPart.baselineSequence == baselineSequence )
+				break;
+			firstPart += encodedPart.numberOfParts;
+		}
+		if( firstPart == m_encodedSnapshotParts.size() )
+			EncodeSnapshotParts( m_currentRoomState, sequence, trackedPlayers, baselineSequence, baseline, trackedAtBaseline, isShared );
+
+		for( unsigned int part = 0; part < m_encodedSnapshotParts[ firstPart ].numberOfParts; ++part )
+		{
+			const EncodedSnapshotPart& encodedPart = m_encodedSnapshotParts[ firstPart + part ];
+			snapshotHeader.number = receivingClient->GetNextPacketNumber();
+			SendPacketToClientWithSharedBody( snapshotHeader, encodedPart.body, encodedPart.bodyBytes, receivingClient );
+			receivingClient->RecordSentSnapshot( snapshotHeader.number, sequence, timestamp );
+		}
 	}
 }
 
@@ -204,8 +454,8 @@ void GameServer::CloseRoom( RoomID room )
 		MoveClientToRoom( client, ROOM_Lobby, false );
 	}
 
-	delete m_openRooms[ room ];
-	m_openRooms[ room ] = nullptr;
+	delete m_openRooms[ room - 1 ]; //Rooms start at 1
+	m_openRooms[ room - 1 ] = nullptr;
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -240,6 +490,8 @@ ErrorCode GameServer::CreateNewWorldAtRoomID( RoomID id )
 
 	World* newWorld = new World();
 	m_openRooms[ id - 1 ] = newWorld; //remember, room ids start at 1!
+	m_simulationClocks[ id - 1 ].Reset();
+	m_snapshotClocks[ id - 1 ].Reset();
 
 // 	Vector2 objectivePosition( GetRandomFloatBetweenZeroandOne() * 600.f, 400.f );
 // 	Entity* objectiveFlag = new Entity();
@@ -251,19 +503,125 @@ ErrorCode GameServer::CreateNewWorldAtRoomID( RoomID id )
 }
 
 //-----------------------------------------------------------------------------------------------
-ClientInfo* GameServer::FindClientByAddress( const std::string& ipAddress, unsigned short portNumber )
+//Takes the client out of this server's lookups without freeing it.
+void GameServer::DetachClient( ClientInfo* client )
 {
-	ClientInfo* foundClient = nullptr;
 	for( unsigned int i = 0; i < m_clientList.size(); ++i )
 	{
-		ClientInfo*& client = m_clientList[ i ];
-		if( ( client->ipAddress.compare( ipAddress ) == 0 ) && client->portNumber == portNumber )
+		if( m_clientList[ i ] == client )
 		{
-			foundClient = client;
+			m_clientList.erase( m_clientList.begin() + i );
 			break;
 		}
 	}
-	return foundClient;
+	m_clientsByEndpoint.Remove( client->endpoint );
+
+	if( m_router != nullptr )
+		m_router->RemoveEndpoint( client->endpoint, m_workerIndex );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Serializes the packet's body into this tick's shared arena, where it stays until FlushPacketsToClients.
+const char* GameServer::EncodeSharedBody( const MainPacketType& packet, unsigned int& out_bodyBytes )
+{
+	char encodedBody[ MAXIMUM_PACKET_WIRE_BYTES ]; //Bit-packed bodies only know their size once written
+	Network::ByteWriter bodyWriter( encodedBody, MAXIMUM_PACKET_WIRE_BYTES );
+	WritePacketBody( bodyWriter, packet );
+	out_bodyBytes = bodyWriter.GetNumberOfBytesWritten();
+
+	char* sharedBody = m_sharedMessageBodies.Allocate( out_bodyBytes );
+	memcpy( sharedBody, encodedBody, out_bodyBytes );
+	return sharedBody;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Same as EncodeSharedBody, for a snapshot sent after a TYPE_RoomSnapshot header.
+const char* GameServer::EncodeSharedSnapshot( const RoomSnapshotPacket& snapshot, unsigned int& out_snapshotBytes )
+{
+	char encodedSnapshot[ MAXIMUM_ROOM_SNAPSHOT_WIRE_BYTES ];
+	Network::ByteWriter snapshotWriter( encodedSnapshot, MAXIMUM_ROOM_SNAPSHOT_WIRE_BYTES );
+	WriteRoomSnapshot( snapshotWriter, snapshot );
+	out_snapshotBytes = snapshotWriter.GetNumberOfBytesWritten();
+
+	char* sharedSnapshot = m_sharedMessageBodies.Allocate( out_snapshotBytes );
+	memcpy( sharedSnapshot, encodedSnapshot, out_snapshotBytes );
+	return sharedSnapshot;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Appends the parts of one snapshot (baseline to currentState) to m_encodedSnapshotParts. Only trackedPlayers
+//	are sent; those that didn't change are left out, and players that left get an entry with no fields.
+//	Players that weren't tracked at the baseline, or at all without one, are sent in full.
+void GameServer::EncodeSnapshotParts( const RoomState& currentState, SnapshotSequence sequence, const PlayerSet& trackedPlayers, SnapshotSequence baselineSequence, const RoomState* baseline, const PlayerSet* trackedAtBaseline, bool isShared )
+{
+	m_playerDeltas.clear();
+
+	PlayerStateDelta playerDelta;
+	RoomState::const_iterator player;
+	for( player = currentState.begin(); player != currentState.end(); ++player )
+	{
+		if( !trackedPlayers.test( player->first ) )
+			continue;
+
+		const QuantizedGameUpdate* baselineState = FindDeltaBaselineOfPlayer( player->first, baseline, trackedAtBaseline );
+		if( MakePlayerStateDelta( player->first, baselineState, player->second, playerDelta ) )
+			m_playerDeltas.push_back( playerDelta );
+	}
+
+	if( baseline != nullptr )
+	{
+		for( player = baseline->begin(); player != baseline->end(); ++player )
+		{
+			if( currentState.find( player->first ) != currentState.end() )
+				continue;
+
+			memset( &playerDelta, 0, sizeof( PlayerStateDelta ) );
+			playerDelta.id = player->first;
+			playerDelta.changedFields = DELTA_None;
+			m_playerDeltas.push_back( playerDelta );
+		}
+	}
+
+	//Even with nothing changed, one empty part goes out so the client can acknowledge this snapshot
+	unsigned int numberOfDeltas = static_cast< unsigned int >( m_playerDeltas.size() );
+	unsigned int numberOfParts = ( numberOfDeltas + MAXIMUM_PLAYERS_PER_SNAPSHOT - 1 ) / MAXIMUM_PLAYERS_PER_SNAPSHOT;
+	if( numberOfParts == 0 )
+		numberOfParts = 1;
+
+	RoomSnapshotPacket snapshot;
+	snapshot.sequence = sequence;
+	snapshot.baselineSequence = baselineSequence;
+	snapshot.numberOfParts = static_cast< unsigned char >( numberOfParts );
+	for( unsigned int part = 0; part < numberOfParts; ++part )
+	{
+		unsigned int firstDelta = part * MAXIMUM_PLAYERS_PER_SNAPSHOT;
+		unsigned int numberOfPlayers = numberOfDeltas - firstDelta;
+		if( numberOfPlayers > MAXIMUM_PLAYERS_PER_SNAPSHOT )
+			numberOfPlayers = MAXIMUM_PLAYERS_PER_SNAPSHOT;
+
+		snapshot.partIndex = static_cast< unsigned char >( part );
+		snapshot.numberOfPlayers = static_cast< unsigned char >( numberOfPlayers );
+		for( unsigned int i = 0; i < numberOfPlayers; ++i )
+		{
+			snapshot.players[ i ] = m_playerDeltas[ firstDelta + i ];
+		}
+
+		EncodedSnapshotPart encodedPart;
+		encodedPart.baselineSequence = baselineSequence;
+		encodedPart.isShared = isShared;
+		encodedPart.numberOfParts = snapshot.numberOfParts;
+		encodedPart.body = EncodeSharedSnapshot( snapshot, encodedPart.bodyBytes );
+		m_encodedSnapshotParts.push_back( encodedPart );
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+ClientInfo* GameServer::FindClientByEndpoint( Network::EndpointKey endpoint ) const
+{
+	ClientInfo* const* foundClient = m_clientsByEndpoint.Find( endpoint );
+	if( foundClient == nullptr )
+		return nullptr;
+	return *foundClient;
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -282,6 +640,258 @@ ClientInfo* GameServer::FindClientByID( unsigned short clientID )
 	return foundClient;
 }
 
+//-----------------------------------------------------------------------------------------------
+//Enough steps for one tick, plus MAXIMUM_LATE_STEPS_PER_TICK to catch up after a late one.
+unsigned int GameServer::GetMaximumStepsPerTick( unsigned int stepsPerSecond ) const
+{
+	unsigned int stepsPerTick = ( stepsPerSecond + m_ticksPerSecond - 1 ) / m_ticksPerSecond;
+	return stepsPerTick + MAXIMUM_LATE_STEPS_PER_TICK;
+}
+
+//-----------------------------------------------------------------------------------------------
+//The server time of the room the shooter was drawing when it fired. Clients send it with the shot, but it's only
+//	believed back to the oldest snapshot a client with this round trip could still have been drawing: one that
+//	waited out the longest playout delay and INTERPOLATION_DELAY_SECONDS, and was a whole snapshot interval old.
+//Shots without one are taken to see the room a round trip plus INTERPOLATION_DELAY_SECONDS ago.
+//	Either way no shot rewinds further than MAXIMUM_REWIND_SECONDS, whatever the room's rates.
+double GameServer::EstimateViewTimestampOfShot( const MainPacketType& firePacket, const ClientInfo* client ) const
+{
+	double currentTimeSeconds = GetCurrentTimeSeconds();
+	double viewTimestamp = firePacket.data.gunfire.viewTimestamp;
+	if( viewTimestamp <= 0.0 )
+		viewTimestamp = currentTimeSeconds - client->roundTripTime.GetSmoothedSeconds() - World::INTERPOLATION_DELAY_SECONDS;
+
+	double longestRoundTripSeconds = client->roundTripTime.GetSmoothedSeconds() + 4.0 * client->roundTripTime.GetVarianceSeconds();
+	double snapshotSeconds = m_snapshotClocks[ client->currentRoom - 1 ].GetStepSeconds();
+	double oldestViewTimestamp = currentTimeSeconds - longestRoundTripSeconds - MAXIMUM_PLAYOUT_DELAY_SECONDS - World::INTERPOLATION_DELAY_SECONDS - snapshotSeconds;
+	if( oldestViewTimestamp < currentTimeSeconds - MAXIMUM_REWIND_SECONDS )
+		oldestViewTimestamp = currentTimeSeconds - MAXIMUM_REWIND_SECONDS;
+	if( viewTimestamp < oldestViewTimestamp )
+		return oldestViewTimestamp;
+	if( viewTimestamp > currentTimeSeconds )
+		return currentTimeSeconds;
+	return viewTimestamp;
+}
+
+//-----------------------------------------------------------------------------------------------
+//The player's state at the baseline, or null if the client wasn't sent it then and needs it in full.
+const QuantizedGameUpdate* GameServer::FindDeltaBaselineOfPlayer( ClientID player, const RoomState* baseline, const PlayerSet* trackedAtBaseline ) const
+{
+	if( baseline == nullptr || !trackedAtBaseline->test( player ) )
+		return nullptr;
+
+	RoomState::const_iterator baselinePlayer = baseline->find( player );
+	if( baselinePlayer == baseline->end() )
+		return nullptr;
+	return &baselinePlayer->second;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Sends just this client's queued messages, ahead of everyone else's. The socket's send queue is empty between
+//	flushes, and other clients' buffers and the shared arena are left alone, so this is safe mid-receive.
+void GameServer::FlushPacketsToClient( ClientInfo* client )
+{
+	QueuePacketsForClient( client );
+
+	int flushResult = m_serverSocket->FlushSendQueue();
+	if( flushResult < 0 )
+	{
+		++m_failedSendsSinceLastPrintout;
+		m_lastSendErrorCode = m_serverSocket->GetLastSendErrorCode();
+	}
+
+	client->outgoingMessages.Clear();
+}
+
+//-----------------------------------------------------------------------------------------------
+//Each client's messages go out packed into as few datagrams as possible (usually one per tick),
+//	and all of those sit in the socket's send queue until the end, so the whole frame costs a few syscalls.
+//The queued datagrams point into the clients' buffers and the shared body arena, so nothing is cleared until after the flush.
+void GameServer::FlushPacketsToClients()
+{
+	for( unsigned int i = 0; i < m_clientList.size(); ++i )
+	{
+		QueuePacketsForClient( m_clientList[ i ] );
+	}
+
+	//Whatever didn't go out is dropped as the network might have: guaranteed packets get resent and snapshots superseded
+	int flushResult = m_serverSocket->FlushSendQueue();
+	if( flushResult < 0 )
+	{
+		++m_failedSendsSinceLastPrintout;
+		m_lastSendErrorCode = m_serverSocket->GetLastSendErrorCode();
+	}
+
+	for( unsigned int i = 0; i < m_clientList.size(); ++i )
+	{
+		m_clientList[ i ]->outgoingMessages.Clear();
+	}
+	m_sharedMessageBodies.Reset();
+}
+
+//-----------------------------------------------------------------------------------------------
+//Returns true if the datagram belongs to a client on another worker and was passed along to it.
+bool GameServer::ForwardDatagramToOwningWorker( const MainPacketType& receivedPacket, const sockaddr_in& receivedAddress )
+{
+	if( m_router == nullptr )
+		return false;
+
+	Network::EndpointKey endpoint = Network::MakeEndpointKey( receivedAddress );
+	if( FindClientByEndpoint( endpoint ) != nullptr )
+		return false;
+
+	unsigned int owningWorker = m_workerIndex;
+	if( !m_router->FindWorkerForEndpoint( endpoint, owningWorker ) )
+	{
+		//New clients joining a game room go straight to the worker that owns the room
+		if( receivedPacket.type != TYPE_JoinRoom )
+			return false;
+
+		RoomID requestedRoom = receivedPacket.data.joining.room;
+		if( requestedRoom == ROOM_Lobby || requestedRoom > MAXIMUM_NUMBER_OF_GAME_ROOMS )
+			return false;
+
+		owningWorker = m_router->GetWorkerOwningRoom( requestedRoom );
+		if( owningWorker == m_workerIndex )
+			return false;
+
+		m_router->SetWorkerForEndpoint( endpoint, owningWorker );
+	}
+
+	//If the router says the client is ours, its handoff is still waiting in our inbox; queue up behind it.
+	RoutedDatagram forwardedDatagram;
+	forwardedDatagram.packet = receivedPacket;
+	forwardedDatagram.senderAddress = receivedAddress;
+	forwardedDatagram.handedOffClient = nullptr;
+	m_router->PushToWorker( owningWorker, forwardedDatagram );
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Returns true if the client asked to create or join a room owned by another worker and was handed over to it.
+//The receiving worker processes the request packet, so it acks or refuses it as usual.
+bool GameServer::HandOffClientToOwningWorker( const MainPacketType& roomRequestPacket, ClientInfo* client )
+{
+	if( m_router == nullptr )
+		return false;
+
+	RoomID requestedRoom = ROOM_None;
+	if( roomRequestPacket.type == TYPE_CreateRoom )
+		requestedRoom = roomRequestPacket.data.creating.room;
+	else if( roomRequestPacket.type == TYPE_JoinRoom )
+		requestedRoom = roomRequestPacket.data.joining.room;
+
+	if( requestedRoom == ROOM_Lobby || requestedRoom > MAXIMUM_NUMBER_OF_GAME_ROOMS )
+		return false;
+
+	unsigned int owningWorker = m_router->GetWorkerOwningRoom( requestedRoom );
+	if( owningWorker == m_workerIndex )
+		return false;
+
+	//The client can't stay in one of our worlds once another thread owns it.
+	//A room leaves with its owner, as when the owner times out, and everyone else in it goes back to the lobby.
+	if( client->ownsCurrentRoom )
+	{
+		CloseRoom( client->currentRoom );
+	}
+	else if( client->currentRoom != ROOM_None && client->currentRoom != ROOM_Lobby )
+	{
+		m_openRooms[ client->currentRoom - 1 ]->RemovePlayer( client->ownedPlayer );
+		client->ownedPlayer = nullptr;
+		client->currentRoom = ROOM_Lobby;
+		client->ownsCurrentRoom = false;
+	}
+	client->secondsSinceLastReceivedPacket = 0.f;
+
+	//Anything still queued for the client may point into our shared arena, so it has to go out before the client leaves
+	FlushPacketsToClient( client );
+
+	//Point the router at the new owner first so no other worker sees the client as unknown
+	m_router->SetWorkerForEndpoint( client->endpoint, owningWorker );
+	DetachClient( client );
+
+	RoutedDatagram handoff;
+	handoff.packet = roomRequestPacket;
+	handoff.senderAddress = client->address;
+	handoff.handedOffClient = client;
+	m_router->PushToWorker( owningWorker, handoff );
+
+	printf( "Handed client at %s:%i to worker %i for room %i.\n", client->ipAddress.c_str(), client->portNumber, owningWorker, requestedRoom );
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Takes changed players out of inout_trackedPlayers until the receiver's snapshot fits in what's left of its
+//	bandwidth budget. Every snapshot a changed player is held back its priority grows, so the players that have
+//	waited longest go first; one that's sent, or has nothing new, starts over at zero.
+//Players that left the room are always sent, since their entries are only a few bits.
+void GameServer::LimitTrackedPlayersToBudget( ClientInfo* client, const RoomState* baseline, const PlayerSet* trackedAtBaseline, PlayerSet& inout_trackedPlayers )
+{
+	m_prioritizedPlayers.clear();
+	unsigned int requiredBits = 0;
+
+	PlayerStateDelta playerDelta;
+	RoomState::const_iterator player;
+	for( player = m_currentRoomState.begin(); player != m_currentRoomState.end(); ++player )
+	{
+		if( !inout_trackedPlayers.test( player->first ) )
+			continue;
+
+		float& priority = client->playerPriorities[ player->first ];
+		const QuantizedGameUpdate* baselineState = FindDeltaBaselineOfPlayer( player->first, baseline, trackedAtBaseline );
+		if( !MakePlayerStateDelta( player->first, baselineState, player->second, playerDelta ) )
+		{
+			priority = 0.f;
+			continue;
+		}
+
+		priority += ( player->first == client->id ) ? OWN_PLAYER_PRIORITY : OTHER_PLAYER_PRIORITY;
+
+		PrioritizedPlayer prioritizedPlayer;
+		prioritizedPlayer.id = player->first;
+		prioritizedPlayer.priority = priority;
+		prioritizedPlayer.wireBits = GetPlayerStateDeltaWireBits( playerDelta );
+		m_prioritizedPlayers.push_back( prioritizedPlayer );
+		requiredBits += prioritizedPlayer.wireBits;
+	}
+
+	unsigned int numberOfDeltas = 0;
+	unsigned int sentBits = 0;
+	if( baseline != nullptr )
+	{
+		memset( &playerDelta, 0, sizeof( PlayerStateDelta ) );
+		playerDelta.changedFields = DELTA_None;
+		for( player = baseline->begin(); player != baseline->end(); ++player )
+		{
+			if( m_currentRoomState.find( player->first ) != m_currentRoomState.end() )
+				continue;
+
+			++numberOfDeltas;
+			sentBits += GetPlayerStateDeltaWireBits( playerDelta );
+		}
+	}
+
+	int availableBytes = client->bandwidth.GetAvailableBytes();
+	unsigned int numberOfChangedPlayers = static_cast< unsigned int >( m_prioritizedPlayers.size() );
+	bool everythingFits = static_cast< int >( GetRoomSnapshotWireBytes( numberOfDeltas + numberOfChangedPlayers, sentBits + requiredBits ) ) <= availableBytes;
+	if( !everythingFits )
+		std::sort( m_prioritizedPlayers.begin(), m_prioritizedPlayers.end() );
+
+	for( unsigned int i = 0; i < numberOfChangedPlayers; ++i )
+	{
+		const PrioritizedPlayer& prioritizedPlayer = m_prioritizedPlayers[ i ];
+		if( !everythingFits && static_cast< int >( GetRoomSnapshotWireBytes( numberOfDeltas + 1, sentBits + prioritizedPlayer.wireBits ) ) > availableBytes )
+		{
+			inout_trackedPlayers.reset( prioritizedPlayer.id );
+			continue;
+		}
+
+		++numberOfDeltas;
+		sentBits += prioritizedPlayer.wireBits;
+		client->playerPriorities[ prioritizedPlayer.id ] = 0.f;
+	}
+}
+
 //-----------------------------------------------------------------------------------------------
 ErrorCode GameServer::MoveClientToRoom( ClientInfo* client, RoomID room, bool ownsRoom )
 {
@@ -306,12 +916,14 @@ ErrorCode GameServer::MoveClientToRoom( ClientInfo* client, RoomID room, bool ow
 
 	client->currentRoom = room;
 	client->ownsCurrentRoom = ownsRoom;
+	client->ForgetSnapshots();
 
 	if( client->currentRoom > ROOM_Lobby )
 	{
 		client->ownedPlayer = new Entity();
 		m_openRooms[ client->currentRoom - 1 ]->AddNewPlayer( client->ownedPlayer );
 		client->id = m_openRooms[ client->currentRoom - 1 ]->GetNextPlayerID();
+		client->ownedPlayer->SetID( client->id );
 		ResetClient( client );
 	}
 	return ERROR_None;
@@ -326,126 +938,235 @@ void GameServer::PrintConnectedClients() const
 		return;
 	}
 
-	printf( "Connected Clients:\n\n" );
+	if( m_router != nullptr )
+		printf( "Connected Clients on worker %i:\n\n", m_workerIndex );
+	else
+		printf( "Connected Clients:\n\n" );
 	for( unsigned int i = 0; i < m_clientList.size(); ++i )
 	{
 		const ClientInfo* const& client = m_clientList[ i ];
 		printf( "\t Client %i: @%s:%i, Last packet %f seconds ago, %i unacked packets\n", client->id, client->ipAddress.c_str(), 
-												client->portNumber, client->secondsSinceLastReceivedPacket, client->unacknowledgedPackets.size() );
+												client->portNumber, client->secondsSinceLastReceivedPacket, client->unacknowledgedPackets.GetNumberOfPackets() );
+		printf( "\t\t RTT %.1fms (+/- %.1fms), resend timeout %.0fms\n", client->roundTripTime.GetSmoothedSeconds() * 1000.0, 
+												client->roundTripTime.GetVarianceSeconds() * 1000.0, client->roundTripTime.GetRetransmissionTimeoutSeconds() * 1000.0 );
+		printf( "\t\t Bandwidth budget %u bytes/s, %.0f%% of snapshot packets lost\n", client->bandwidth.GetBytesPerSecond(), 
+												client->bandwidth.GetLastLossFraction() * 100.f );
 	}
 	printf( "\n" );
 }
 
+//-----------------------------------------------------------------------------------------------
+//Problems that can come up once per message are counted as they happen and reported here, every few seconds.
+void GameServer::PrintDroppedTraffic()
+{
+	if( m_malformedMessagesSinceLastPrintout > 0 )
+		printf( "WARNING: Dropped %u malformed messages or datagrams from clients.\n\n", m_malformedMessagesSinceLastPrintout );
+	if( m_droppedMessagesSinceLastPrintout > 0 )
+		printf( "WARNING: Dropped %u outgoing messages too big for a datagram.\n\n", m_droppedMessagesSinceLastPrintout );
+	if( m_failedSendsSinceLastPrintout > 0 )
+		printf( "WARNING: %u sends to clients failed; their datagrams were dropped. Last Error Code:%i.\n\n", m_failedSendsSinceLastPrintout, m_lastSendErrorCode );
+
+	m_malformedMessagesSinceLastPrintout = 0;
+	m_droppedMessagesSinceLastPrintout = 0;
+	m_failedSendsSinceLastPrintout = 0;
+}
+
 //-----------------------------------------------------------------------------------------------
 void GameServer::ProcessNetworkQueue()
 {
-	std::string receivedIPAddress;
-	unsigned short receivedPort;
-	MainPacketType receivedPacket;
-	ClientInfo* receivedClient = nullptr;
+	if( m_router != nullptr )
+		ProcessRoutedDatagrams();
 
-	int numberOfBytesInNetworkQueue = m_serverSocket.GetNumberOfBytesInNetworkQueue();
-	while( numberOfBytesInNetworkQueue > 0 )
+	int numberOfDatagramsReceived = 0;
+	do
 	{
-		int receiveResult = m_serverSocket.ReceiveBuffer( ( char* )&receivedPacket, sizeof( MainPacketType ), receivedIPAddress, receivedPort );
-		if( receiveResult < 0 )
+		numberOfDatagramsReceived = m_serverSocket->ReceiveBufferBatch( &m_receivedDatagramBytes[ 0 ][ 0 ], Network::MAXIMUM_DATAGRAM_PAYLOAD_BYTES, RECEIVE_BATCH_SIZE, m_receivedDatagrams );
+		if( numberOfDatagramsReceived < 0 )
 		{
-			int errorCode = WSAGetLastError();
-			if( errorCode = 10035 )
-				break; //The queue is empty
-
+			int errorCode = Network::GetLastSocketErrorCode();
 			printf( "Packet Receiving error! Error Code: %i", errorCode );
 			exit( -14 );
 		}
 
-		receivedClient = FindClientByAddress( receivedIPAddress, receivedPort );
-		if( receivedClient == nullptr )
+		for( int i = 0; i < numberOfDatagramsReceived; ++i )
 		{
-			if( receivedPacket.type != TYPE_JoinRoom )
-			{
-				printf( "WARNING: Received non-join packet from an unknown client at %s:%i.\n", receivedIPAddress.c_str(), receivedPort );
+			const Network::ReceivedDatagram& datagram = m_receivedDatagrams[ i ];
+			if( datagram.numberOfBytes <= 0 )
 				continue;
-			}
-			if( receivedPacket.data.joining.room == ROOM_None )
+
+			const char* message = nullptr;
+			unsigned int messageBytes = 0;
+			Network::IncomingMessageReader messageReader( m_receivedDatagramBytes[ i ], datagram.numberOfBytes );
+			while( messageReader.ReadNextMessage( message, messageBytes ) )
 			{
-				printf( "WARNING: Received join packet to invalid room from client at %s:%i.\n", receivedIPAddress.c_str(), receivedPort );
-				continue;
+				MainPacketType receivedPacket;
+				if( !DeserializePacket( message, messageBytes, receivedPacket ) )
+				{
+					++m_malformedMessagesSinceLastPrintout; //Counted rather than printed; stray traffic arrives a datagram at a time
+					continue;
+				}
+
+				if( ForwardDatagramToOwningWorker( receivedPacket, datagram.senderAddress ) )
+					continue;
+
+				ProcessPacketFromAddress( receivedPacket, datagram.senderAddress );
 			}
 
-			receivedClient = AddNewClient( receivedIPAddress, receivedPort );
-			ErrorCode moveError = MoveClientToRoom( receivedClient, receivedPacket.data.joining.room, false );
-			if( moveError == ERROR_None )
+			if( messageReader.IsMalformed() )
+				++m_malformedMessagesSinceLastPrintout;
+		}
+	} while( numberOfDatagramsReceived == RECEIVE_BATCH_SIZE ); //A full batch means more may be waiting
+}
+
+//-----------------------------------------------------------------------------------------------
+void GameServer::ProcessPacketFromAddress( const MainPacketType& receivedPacket, const sockaddr_in& receivedAddress )
+{
+	ClientInfo* receivedClient = FindClientByEndpoint( Network::MakeEndpointKey( receivedAddress ) );
+	if( receivedClient == nullptr )
+	{
+		//Unknown senders are rare, so only they pay for turning the address into text
+		char addressBuffer[ 32 ];
+		Network::UDPSocket::GetSockaddrAddressAsString( &receivedAddress, addressBuffer, 32 );
+		unsigned short receivedPort = Network::UDPSocket::GetSockaddrPort( &receivedAddress );
+
+		if( receivedPacket.type != TYPE_JoinRoom )
+		{
+			printf( "WARNING: Received non-join packet from an unknown client at %s:%i.\n", addressBuffer, receivedPort );
+			return;
+		}
+		if( receivedPacket.data.joining.room == ROOM_None )
+		{
+			printf( "WARNING: Received join packet to invalid room from client at %s:%i.\n", addressBuffer, receivedPort );
+			return;
+		}
+
+		receivedClient = AddNewClient( receivedAddress );
+		ErrorCode moveError = MoveClientToRoom( receivedClient, receivedPacket.data.joining.room, false );
+		if( moveError == ERROR_None )
+		{
+			printf( "Received join packet from %s:%i. Added as client.\n", receivedClient->ipAddress.c_str(), receivedClient->portNumber );
+			AcknowledgePacketFromClient( receivedPacket, receivedClient );
+		}
+		else
+		{
+			printf( "Refused join request from %s:%i. Error Code: %i.\n", receivedClient->ipAddress.c_str(), receivedClient->portNumber, moveError );
+			RefusePacketFromClient( receivedPacket, receivedClient, moveError );
+		}
+		return;
+	}
+	
+	if( HandOffClientToOwningWorker( receivedPacket, receivedClient ) )
+		return;
+
+	RemoveAcknowledgedPacketsFromClientQueue( receivedPacket, receivedClient );
+	receivedClient->secondsSinceLastReceivedPacket = 0.f;
+
+	if( receivedClient->receivedPackets.WasPacketReceived( receivedPacket.number ) )
+	{
+		//A resend whose acknowledgement was lost or late: acknowledge it again, but don't handle it twice
+		AcknowledgePacketFromClient( receivedPacket, receivedClient );
+		return;
+	}
+
+	bool isRefused = false;
+	switch( receivedPacket.type )
+	{
+	case TYPE_Ack:
+		//Only carries the header's acknowledgements, and isn't acknowledged itself
+		break;
+	case TYPE_Input:
+		ReceiveInputFromClient( receivedPacket, receivedClient );
+		break;
+	case TYPE_CreateRoom:
+		{
+			ErrorCode creationError = CreateNewRoomForClient( receivedPacket.data.creating.room, receivedClient );
+			if( creationError == ERROR_None )
 			{
-				printf( "Received join packet from %s:%i. Added as client.\n", receivedIPAddress.c_str(), receivedPort );
-				AcknowledgePacketFromClient( receivedPacket, receivedClient );
+				printf( "Client at %s:%i has created room %i.\n", receivedClient->ipAddress.c_str(), receivedClient->portNumber, receivedPacket.data.joining.room );
 			}
 			else
 			{
-				printf( "Refused join request from %s:%i. Error Code: %i.\n", receivedIPAddress.c_str(), receivedPort, moveError );
-				RefusePacketFromClient( receivedPacket, receivedClient, moveError );
+				printf( "Refused creation request from client at %s:%i. Error Code: %i.\n", receivedClient->ipAddress.c_str(), receivedClient->portNumber, creationError );
+				RefusePacketFromClient( receivedPacket, receivedClient, creationError );
+				isRefused = true;
 			}
-			continue;
 		}
-		
-		printf( "Received packet from %s:%i.\n", receivedIPAddress.c_str(), receivedPort );
-		switch( receivedPacket.type )
+		break;
+	case TYPE_JoinRoom:
 		{
-		case TYPE_Ack:
-			{
-				RemoveAcknowledgedPacketFromClientQueue( receivedPacket, FindClientByAddress( receivedIPAddress, receivedPort ) );
-			}
-			break;
-		case TYPE_GameUpdate:
-			ReceiveUpdateFromClient( receivedPacket, receivedClient );
-			break;
-		case TYPE_CreateRoom:
+			ErrorCode moveError = MoveClientToRoom( receivedClient, receivedPacket.data.joining.room, false );
+			if( moveError == ERROR_None )
 			{
-				ErrorCode creationError = CreateNewRoomForClient( receivedPacket.data.creating.room, receivedClient );
-				if( creationError == ERROR_None )
-				{
-					printf( "Client at %s:%i has created room %i.\n", receivedIPAddress.c_str(), receivedPort, receivedPacket.data.joining.room );
-					AcknowledgePacketFromClient( receivedPacket, receivedClient );
-				}
-				else
-				{
-					printf( "Refused creation request from client at %s:%i. Error Code: %i.\n", receivedIPAddress.c_str(), receivedPort, creationError );
-					RefusePacketFromClient( receivedPacket, receivedClient, creationError );
-				}
+				printf( "Client at %s:%i has moved to room %i.\n", receivedClient->ipAddress.c_str(), receivedClient->portNumber, receivedPacket.data.joining.room );
 			}
-			break;
-		case TYPE_JoinRoom:
+			else
 			{
-				ErrorCode moveError = MoveClientToRoom( receivedClient, receivedPacket.data.joining.room, false );
-				if( moveError == ERROR_None )
-				{
-					printf( "Client at %s:%i has moved to room %i.\n", receivedIPAddress.c_str(), receivedPort, receivedPacket.data.joining.room );
-					AcknowledgePacketFromClient( receivedPacket, receivedClient );
-				}
-				else
-				{
-					printf( "Refused join request from client at %s:%i. Error Code: %i.\n", receivedIPAddress.c_str(), receivedPort, moveError );
-					RefusePacketFromClient( receivedPacket, receivedClient, moveError );
-				}
+				printf( "Refused join request from client at %s:%i. Error Code: %i.\n", receivedClient->ipAddress.c_str(), receivedClient->portNumber, moveError );
+				RefusePacketFromClient( receivedPacket, receivedClient, moveError );
+				isRefused = true;
 			}
-			break;
-		case TYPE_KeepAlive:
-			// Just keep that client alive, baby...
-			break;
-		case TYPE_Fire:
+		}
+		break;
+	case TYPE_KeepAlive:
+		// Just keep that client alive, baby...
+		break;
+	case TYPE_TimeSync:
+		SendTimeSyncReplyToClient( receivedPacket, receivedClient );
+		break;
+	case TYPE_Fire:
+		{
+			//Only a player in an open game room has anything to fire; the client is behind on which room it's in
+			if( receivedClient->currentRoom == ROOM_None || receivedClient->currentRoom == ROOM_Lobby || receivedClient->ownedPlayer == nullptr
+				|| GetRoomWithID( receivedClient->currentRoom ) == nullptr )
 			{
-				BroadcastPacketToAllPlayersInRoom( receivedPacket, receivedClient->currentRoom );
-				World* worldFiredIn = GetRoomWithID( receivedClient->currentRoom );
-				worldFiredIn->HandleFireEventFromPlayer( receivedClient->ownedPlayer );
+				RefusePacketFromClient( receivedPacket, receivedClient, ERROR_BadRoomID );
+				isRefused = true;
+				break;
 			}
-			break;
-		case TYPE_Hit:
-		case TYPE_Respawn:
-		default:
-			printf( "WARNING: Received bad packet from %s:%i.\n", receivedIPAddress.c_str(), receivedPort );
+
+			BroadcastPacketToAllPlayersInRoom( receivedPacket, receivedClient->currentRoom );
+			World* worldFiredIn = GetRoomWithID( receivedClient->currentRoom );
+			worldFiredIn->HandleFireEventFromPlayer( receivedClient->ownedPlayer, EstimateViewTimestampOfShot( receivedPacket, receivedClient ) );
 		}
+		break;
+	case TYPE_Hit:
+	case TYPE_Respawn:
+	default:
+		printf( "WARNING: Received bad packet from %s:%i.\n", receivedClient->ipAddress.c_str(), receivedClient->portNumber );
+	}
+
+	if( !isRefused )
+		AcknowledgePacketFromClient( receivedPacket, receivedClient );
+}
 
-		receivedClient->secondsSinceLastReceivedPacket = 0.f;
-		numberOfBytesInNetworkQueue = m_serverSocket.GetNumberOfBytesInNetworkQueue();
+//-----------------------------------------------------------------------------------------------
+//Datagrams other workers forwarded to us, including clients they handed over.
+void GameServer::ProcessRoutedDatagrams()
+{
+	m_router->TakeInboxOfWorker( m_workerIndex, m_routedDatagrams );
+	for( unsigned int i = 0; i < m_routedDatagrams.size(); ++i )
+	{
+		RoutedDatagram& routedDatagram = m_routedDatagrams[ i ];
+		if( routedDatagram.handedOffClient != nullptr )
+			AttachClient( routedDatagram.handedOffClient );
+
+		ProcessPacketFromAddress( routedDatagram.packet, routedDatagram.senderAddress );
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+void GameServer::QueuePacketsForClient( ClientInfo* client )
+{
+	Network::OutgoingMessageBuffer& outgoingMessages = client->outgoingMessages;
+	for( unsigned int i = 0; i < outgoingMessages.GetNumberOfDatagrams(); ++i )
+	{
+		outgoingMessages.GetDatagramSegments( i, m_datagramSegments );
+		int queueResult = m_serverSocket->QueueSegmentsForSend( &m_datagramSegments[ 0 ], static_cast< unsigned int >( m_datagramSegments.size() ), client->address );
+		if( queueResult < 0 )
+		{
+			++m_failedSendsSinceLastPrintout;
+			m_lastSendErrorCode = m_serverSocket->GetLastSendErrorCode();
+		}
 	}
 }
 
@@ -471,54 +1192,140 @@ void GameServer::HandleTouchAndResetGame( const MainPacketType& touchPacket )
 }
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::ReceiveUpdateFromClient( const MainPacketType& updatePacket, ClientInfo* client )
+//Moves the client's tank one frame the way its Input says, exactly as the client predicted it. The client only
+//	reports its controls, so it can't put its tank anywhere a frame of movement doesn't take it.
+void GameServer::ReceiveInputFromClient( const MainPacketType& inputPacket, ClientInfo* client )
 {
 	if( client->ownedPlayer == nullptr )
 		return;
 
-	client->ownedPlayer->SetClientPosition( updatePacket.data.updatedGame.xPosition, updatePacket.data.updatedGame.yPosition );
-	client->ownedPlayer->SetClientVelocity( updatePacket.data.updatedGame.xVelocity, updatePacket.data.updatedGame.yVelocity );
-	client->ownedPlayer->SetClientAcceleration( updatePacket.data.updatedGame.xAcceleration, updatePacket.data.updatedGame.yAcceleration );
-	client->ownedPlayer->SetClientOrientation( updatePacket.data.updatedGame.orientationDegrees );
-	//Client doesn't get to set health and score, since we can't trust them.
+	//Inputs can arrive out of order; one older than what we already applied was already overtaken on the client too
+	const InputPacket& input = inputPacket.data.input;
+	if( client->lastInputSequence != INPUT_None && !IsInputSequenceNewer( input.sequence, client->lastInputSequence ) )
+		return;
+
+	client->lastInputSequence = input.sequence;
+
+	//Each Input is one step of World::INPUTS_PER_SECOND. One past the client's allowance would make it faster than
+	//	that, so it only stops the tank; the next snapshot then corrects the client's prediction of it.
+	Entity* player = client->ownedPlayer;
+	FloatVector2 movement( 0.f, 0.f );
+	if( client->inputAllowance >= 1.f )
+	{
+		client->inputAllowance -= 1.f;
+		movement = World::GetTankMovementForInput( input.movementHeadingDegrees, input.movementMagnitude, player->IsIt() );
+	}
+
+	float inputsPerSecond = static_cast< float >( World::INPUTS_PER_SECOND );
+	FloatVector2 newPosition = player->GetCurrentPosition() + movement;
+	player->SetClientPosition( newPosition.x, newPosition.y );
+	player->SetClientVelocity( movement.x * inputsPerSecond, movement.y * inputsPerSecond );
+	player->SetClientAcceleration( 0.f, 0.f );
+	if( input.movementMagnitude > 0.f )
+		player->SetClientOrientation( input.movementHeadingDegrees );
 }
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::RemoveAcknowledgedPacketFromClientQueue( const MainPacketType& ackPacket, ClientInfo* client )
+//Keeps the packet's encoded body for resends until the client acknowledges it.
+void GameServer::RecordUnacknowledgedPacket( const MainPacketType& packet, const char* body, unsigned int bodyBytes, ClientInfo* client )
 {
-	std::set< MainPacketType, FinalPacketComparer >::iterator unackedPacket;
-	for( unackedPacket = client->unacknowledgedPackets.begin(); 
-		 unackedPacket != client->unacknowledgedPackets.end(); 
-		 ++unackedPacket )
+	double currentTimeSeconds = GetCurrentTimeSeconds();
+	double resendTimeSeconds = currentTimeSeconds + client->roundTripTime.GetRetransmissionTimeoutSeconds();
+	InsertResult insertResult = client->unacknowledgedPackets.Insert( packet, body, bodyBytes, currentTimeSeconds, resendTimeSeconds );
+	if( insertResult == INSERT_BodyTooBig )
+		printf( "WARNING: Guaranteed packet %i to client ID %i has a %i-byte body, too big to keep; it won't be resent.\n", packet.number, client->id, bodyBytes );
+	else if( insertResult == INSERT_PushedOutOlderPacket )
+		printf( "WARNING: Client ID %i never acknowledged a guaranteed packet from %i packets ago; it won't be resent.\n", client->id, UnacknowledgedPacketBuffer::CAPACITY );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Every packet from the client acknowledges the latest of ours it received and the ACKNOWLEDGED_BITS before it.
+//The first ack of a packet that was only sent once is also a round-trip sample.
+//Snapshot acks also feed the client's bandwidth budget, which counts snapshot packets never acked as lost.
+void GameServer::RemoveAcknowledgedPacketsFromClientQueue( const MainPacketType& receivedPacket, ClientInfo* client )
+{
+	double currentTimeSeconds = GetCurrentTimeSeconds();
+	for( PacketNumber i = 0; i <= ReceivedPacketWindow::ACKNOWLEDGED_BITS && i < receivedPacket.acknowledgedNumber; ++i )
 	{
-		if( unackedPacket->number == ackPacket.data.acknowledged.number )
+		PacketNumber acknowledgedNumber = receivedPacket.acknowledgedNumber - i;
+		if( !IsPacketAcknowledged( receivedPacket, acknowledgedNumber ) )
+			continue;
+
+		//Snapshots are never resent; the ack only moves this client's delta baseline forward
+		SentSnapshot* sentSnapshot = client->FindSentSnapshot( acknowledgedNumber );
+		if( sentSnapshot != nullptr && !sentSnapshot->isAcknowledged )
 		{
-			printf( "Removing an acknowledged packet from client ID %i.\n", client->id );
-			client->unacknowledgedPackets.erase( unackedPacket );
-			return;
+			sentSnapshot->isAcknowledged = true;
+			client->bandwidth.RecordDeliveredPacket();
+		}
+		if( sentSnapshot != nullptr && sentSnapshot->sequence > client->acknowledgedSnapshot )
+		{
+			client->acknowledgedSnapshot = sentSnapshot->sequence;
+			client->roundTripTime.AddSample( currentTimeSeconds - sentSnapshot->sendTimeSeconds );
 		}
+
+		UnacknowledgedPacketBuffer::UnacknowledgedPacket* unackedPacket = client->unacknowledgedPackets.Find( acknowledgedNumber );
+		if( unackedPacket == nullptr )
+			continue;
+
+		if( unackedPacket->numberOfResends == 0 )
+			client->roundTripTime.AddSample( currentTimeSeconds - unackedPacket->sendTimeSeconds );
+		client->unacknowledgedPackets.Remove( acknowledgedNumber );
 	}
 }
 
 //-----------------------------------------------------------------------------------------------
+//Guaranteed packets go out again with a fresh header when their resend time passes without an ack. Each resend
+//	of the same packet waits twice as long, and after MAXIMUM_GUARANTEED_PACKET_RESENDS the packet is dropped.
 void GameServer::ResendUnacknowledgedPacketsToClient( ClientInfo* client )
 {
-	std::set< MainPacketType, FinalPacketComparer >::iterator unackedPacket;
-	for( unackedPacket = client->unacknowledgedPackets.begin(); unackedPacket != client->unacknowledgedPackets.end(); ++unackedPacket )
+	UnacknowledgedPacketBuffer& unacknowledgedPackets = client->unacknowledgedPackets;
+	if( unacknowledgedPackets.GetNumberOfPackets() == 0 )
+		return;
+
+	double currentTimeSeconds = GetCurrentTimeSeconds();
+	for( PacketNumber number = unacknowledgedPackets.GetOldestNumber(); number <= unacknowledgedPackets.GetNewestNumber(); ++number )
 	{
-		SendPacketToClient( const_cast< MainPacketType& >( *unackedPacket ), client );
+		UnacknowledgedPacketBuffer::UnacknowledgedPacket* unackedPacket = unacknowledgedPackets.Find( number );
+		if( unackedPacket == nullptr || currentTimeSeconds < unackedPacket->resendTimeSeconds )
+			continue;
+
+		if( unackedPacket->numberOfResends >= MAXIMUM_GUARANTEED_PACKET_RESENDS )
+		{
+			printf( "WARNING: Gave up on packet %i to client ID %i after %i resends.\n", number, client->id, MAXIMUM_GUARANTEED_PACKET_RESENDS );
+			unacknowledgedPackets.Remove( number );
+			continue;
+		}
+
+		++unackedPacket->numberOfResends;
+		unackedPacket->header.timestamp = currentTimeSeconds;
+		unackedPacket->sendTimeSeconds = currentTimeSeconds;
+		unackedPacket->resendTimeSeconds = currentTimeSeconds + client->roundTripTime.GetBackedOffTimeoutSeconds( unackedPacket->numberOfResends );
+		client->receivedPackets.WriteAcknowledgements( unackedPacket->header );
+
+		char serializedPacket[ FINAL_PACKET_HEADER_WIRE_BYTES + MAXIMUM_FIXED_BODY_WIRE_BYTES ];
+		Network::ByteWriter packetWriter( serializedPacket, FINAL_PACKET_HEADER_WIRE_BYTES + MAXIMUM_FIXED_BODY_WIRE_BYTES );
+		WritePacketHeader( packetWriter, unackedPacket->header );
+		packetWriter.WriteBytes( unackedPacket->body, unackedPacket->bodyBytes );
+		if( !client->outgoingMessages.AppendMessage( serializedPacket, packetWriter.GetNumberOfBytesWritten() ) )
+		{
+			++m_droppedMessagesSinceLastPrintout;
+			continue;
+		}
+		client->bandwidth.Spend( Network::MESSAGE_LENGTH_PREFIX_BYTES + packetWriter.GetNumberOfBytesWritten() );
 	}
 }
 
 //-----------------------------------------------------------------------------------------------
 void GameServer::ResetClient( ClientInfo* client )
 {
+	std::uniform_real_distribution< float > spawnCoordinate( 0.f, 600.f );
 	Vector2 startingPosition;
-	startingPosition.x = GetRandomFloatBetweenZeroandOne() * 600.f;
+	startingPosition.x = spawnCoordinate( m_randomNumberGenerator );
 	if( client->id == m_itPlayerID )
 		startingPosition.y = 0;
 	else
-		startingPosition.y = GetRandomFloatBetweenZeroandOne() * 600.f;
+		startingPosition.y = spawnCoordinate( m_randomNumberGenerator );
 
 	client->ownedPlayer->SetClientPosition( startingPosition.x, startingPosition.y );
 	client->ownedPlayer->SetClientVelocity( 0.f, 0.f );
@@ -526,6 +1333,8 @@ void GameServer::ResetClient( ClientInfo* client )
 	client->ownedPlayer->SetClientOrientation( 0.f );
 	client->ownedPlayer->SetHealth( World::MAX_HEALTH );
 	client->ownedPlayer->SetScore( 0 );
+	client->lastInputSequence = INPUT_None; //The client numbers its inputs from the start again
+	client->inputAllowance = static_cast< float >( MAXIMUM_BANKED_INPUTS );
 
 	MainPacketType resetPacket;
 	resetPacket.type = TYPE_GameReset;
@@ -541,34 +1350,144 @@ void GameServer::ResetClient( ClientInfo* client )
 }
 
 //-----------------------------------------------------------------------------------------------
+//Only for when nothing else is going to the client; an Ack has no body and no number of its own.
+void GameServer::SendAcknowledgementToClient( ClientInfo* client )
+{
+	MainPacketType ackPacket;
+	ackPacket.type = TYPE_Ack;
+	ackPacket.clientID = client->id;
+	ackPacket.number = 0;
+
+	SendPacketToClient( ackPacket, client );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Everything sent to a client comes out of its bandwidth budget. Nothing here is held back for it, though;
+//	BroadcastSnapshotOfRoom and BroadcastGameStateToClients decide what's worth sending.
 void GameServer::SendPacketToClient( MainPacketType& packet, ClientInfo* client )
 {
 	packet.timestamp = GetCurrentTimeSeconds();
+	client->receivedPackets.WriteAcknowledgements( packet );
+
+	//Goes out with everything else for this client when FlushPacketsToClients runs
+	char serializedPacket[ MAXIMUM_PACKET_WIRE_BYTES ];
+	unsigned int serializedBytes = SerializePacket( packet, serializedPacket, MAXIMUM_PACKET_WIRE_BYTES );
+	if( !client->outgoingMessages.AppendMessage( serializedPacket, serializedBytes ) )
+	{
+		++m_droppedMessagesSinceLastPrintout; //Too big for any datagram, so a resend couldn't go out either
+		return;
+	}
+	client->bandwidth.Spend( Network::MESSAGE_LENGTH_PREFIX_BYTES + serializedBytes );
+
+	if( packet.IsGuaranteed() )
+	{
+		RecordUnacknowledgedPacket( packet, serializedPacket + FINAL_PACKET_HEADER_WIRE_BYTES, serializedBytes - FINAL_PACKET_HEADER_WIRE_BYTES, client );
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+//Only the packet's header is serialized per receiver; the body comes from EncodeSharedBody or EncodeSharedSnapshot.
+//Guaranteed packets keep their own copy of sharedBody for resends.
+//Unlike SendPacketToClient this leaves the timestamp alone, so a broadcast stamps every copy with the same time.
+void GameServer::SendPacketToClientWithSharedBody( MainPacketType& packet, const char* sharedBody, unsigned int bodyBytes, ClientInfo* client )
+{
+	client->receivedPackets.WriteAcknowledgements( packet );
 
-	int sendResult = m_serverSocket.SendBuffer( ( char* )&packet, sizeof( MainPacketType ), client->ipAddress, client->portNumber );
-	if( sendResult < 0 )
+	char serializedHeader[ FINAL_PACKET_HEADER_WIRE_BYTES ];
+	Network::ByteWriter headerWriter( serializedHeader, FINAL_PACKET_HEADER_WIRE_BYTES );
+	WritePacketHeader( headerWriter, packet );
+	if( !client->outgoingMessages.AppendMessageWithSharedBody( serializedHeader, FINAL_PACKET_HEADER_WIRE_BYTES, sharedBody, bodyBytes ) )
 	{
-		int errorCode = WSAGetLastError();
-		printf( "Unable to send packet to client at %s:%i. Error Code:%i.\n", client->ipAddress.c_str(), client->portNumber, errorCode );
-		exit( -42 );
+		++m_droppedMessagesSinceLastPrintout;
+		return;
 	}
+	client->bandwidth.Spend( Network::MESSAGE_LENGTH_PREFIX_BYTES + FINAL_PACKET_HEADER_WIRE_BYTES + bodyBytes );
 
 	if( packet.IsGuaranteed() )
 	{
-		client->unacknowledgedPackets.insert( packet );
+		RecordUnacknowledgedPacket( packet, sharedBody, bodyBytes, client );
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+//The body says when the request arrived and the header's timestamp when the reply was queued. Requests handled
+//	between ticks are flushed right away, so any wait on our side is counted as ours and not the network's.
+void GameServer::SendTimeSyncReplyToClient( const MainPacketType& requestPacket, ClientInfo* client )
+{
+	MainPacketType replyPacket;
+	replyPacket.type = TYPE_TimeSync;
+	replyPacket.clientID = client->id;
+	replyPacket.number = client->GetNextPacketNumber();
+	replyPacket.data.timeSync.originTimestamp = requestPacket.data.timeSync.originTimestamp;
+	replyPacket.data.timeSync.receiveTimestamp = GetCurrentTimeSeconds();
+
+	SendPacketToClient( replyPacket, client );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Also sets the event loop's tick, which has to be set before the loop starts.
+void GameServer::SetTickRates( unsigned int simulationStepsPerSecond, unsigned int snapshotsPerSecond )
+{
+	m_ticksPerSecond = MINIMUM_TICKS_PER_SECOND;
+	if( simulationStepsPerSecond > m_ticksPerSecond )
+		m_ticksPerSecond = simulationStepsPerSecond;
+	if( m_ticksPerSecond > MAXIMUM_SIMULATION_STEPS_PER_SECOND )
+		m_ticksPerSecond = MAXIMUM_SIMULATION_STEPS_PER_SECOND;
+	for( unsigned int i = 0; i < MAXIMUM_NUMBER_OF_GAME_ROOMS; ++i )
+	{
+		SetTickRatesOfRoom( static_cast< RoomID >( i + 1 ), simulationStepsPerSecond, snapshotsPerSecond );
+	}
+	m_lobbyUpdateClock.SetStepsPerSecond( snapshotsPerSecond, GetMaximumStepsPerTick( snapshotsPerSecond ) );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Sending faster than the room simulates would only repeat snapshots, so snapshots are capped at the simulation rate.
+//	Rates outside what the position history and the clients' interpolation delay can cover are clamped.
+ErrorCode GameServer::SetTickRatesOfRoom( RoomID room, unsigned int simulationStepsPerSecond, unsigned int snapshotsPerSecond )
+{
+	if( room > MAXIMUM_NUMBER_OF_GAME_ROOMS || room == ROOM_None || room == ROOM_Lobby )
+	{
+		printf( "WARNING: Tried to set the tick rates of room %i, which isn't a game room!\n", room );
+		return ERROR_BadRoomID;
 	}
+
+	if( simulationStepsPerSecond > MAXIMUM_SIMULATION_STEPS_PER_SECOND )
+		simulationStepsPerSecond = MAXIMUM_SIMULATION_STEPS_PER_SECOND;
+	if( simulationStepsPerSecond < MINIMUM_SNAPSHOTS_PER_SECOND )
+		simulationStepsPerSecond = MINIMUM_SNAPSHOTS_PER_SECOND;
+	if( snapshotsPerSecond > simulationStepsPerSecond )
+		snapshotsPerSecond = simulationStepsPerSecond;
+	if( snapshotsPerSecond < MINIMUM_SNAPSHOTS_PER_SECOND )
+		snapshotsPerSecond = MINIMUM_SNAPSHOTS_PER_SECOND;
+
+	m_simulationClocks[ room - 1 ].SetStepsPerSecond( simulationStepsPerSecond, GetMaximumStepsPerTick( simulationStepsPerSecond ) );
+	m_snapshotClocks[ room - 1 ].SetStepsPerSecond( snapshotsPerSecond, GetMaximumStepsPerTick( snapshotsPerSecond ) );
+	return ERROR_None;
 }
 
 //-----------------------------------------------------------------------------------------------
+//Each room steps at its own fixed rate, however long this tick took. Steps run late in a tick that
+//	catches up are recorded at the times they should have run, so the position history stays evenly spaced.
 void GameServer::UpdateGameState( float deltaSeconds )
 {
+	double currentTimeSeconds = GetCurrentTimeSeconds();
 	for( unsigned int i = 0; i < MAXIMUM_NUMBER_OF_GAME_ROOMS; ++i )
 	{
 		if( m_openRooms[ i ] == nullptr )
 			continue;
 
-		//m_openRooms[ i ].Update( deltaSeconds );
-		m_openRooms[ i ]->UpdateLasers( deltaSeconds );
+		FixedStepClock& simulationClock = m_simulationClocks[ i ];
+		float stepSeconds = simulationClock.GetStepSeconds();
+		unsigned int dueSteps = simulationClock.TakeDueSteps( deltaSeconds );
+		for( unsigned int step = 0; step < dueSteps; ++step )
+		{
+			double stepTimeSeconds = currentTimeSeconds - static_cast< double >( stepSeconds ) * ( dueSteps - 1 - step );
+
+			//m_openRooms[ i ].Update( stepSeconds );
+			m_openRooms[ i ]->UpdateLasers( stepSeconds );
+			m_openRooms[ i ]->RecordPlayerPositions( stepTimeSeconds );
+			ApplyLaserImpactsInRoom( static_cast< RoomID >( i + 1 ) );
+		}
 	}
 // 	for( unsigned int i = 0; i < m_clientList.size(); ++i )
 // 	{
@@ -578,4 +1497,26 @@ void GameServer::UpdateGameState( float deltaSeconds )
 // 		client->yPosition += client->yVelocity * deltaSeconds;
 // 	}
 }
+
+//-----------------------------------------------------------------------------------------------
+//Players come into the client's area of interest inside INTEREST_ENTER_RADIUS and only leave it
+//	past INTEREST_EXIT_RADIUS. Expects m_interestGrid to hold the client's room.
+void GameServer::UpdateNearbyPlayersOfClient( ClientInfo* client )
+{
+	static const float ENTER_RADIUS_SQUARED = INTEREST_ENTER_RADIUS * INTEREST_ENTER_RADIUS;
+
+	const FloatVector2& clientPosition = client->ownedPlayer->GetCurrentPosition();
+	m_nearbyPlayers.clear();
+	m_interestGrid.FindPlayersWithinRadius( clientPosition.x, clientPosition.y, INTEREST_EXIT_RADIUS, m_nearbyPlayers );
+
+	PlayerSet nearbyPlayers;
+	for( unsigned int i = 0; i < m_nearbyPlayers.size(); ++i )
+	{
+		const NearbyPlayer& nearbyPlayer = m_nearbyPlayers[ i ];
+		if( nearbyPlayer.distanceSquared <= ENTER_RADIUS_SQUARED || client->nearbyPlayers.test( nearbyPlayer.id ) )
+			nearbyPlayers.set( nearbyPlayer.id );
+	}
+	nearbyPlayers.set( client->id );
+	client->nearbyPlayers = nearbyPlayers;
+}
 #pragma endregion
@@ -3,39 +3,142 @@
 #define INCLUDED_GAME_SERVER_HPP
 
 //-----------------------------------------------------------------------------------------------
-#include <set>
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstring>
+#include <random>
 #include <vector>
-#include "../../Common/Engine/UDPSocket.hpp"
+#include "../../Common/Engine/DatagramSocket.hpp"
+#include "../../Common/Engine/EndpointTable.hpp"
+#include "../../Common/Engine/MessageFraming.hpp"
+#include "../../Common/Engine/RoundTripEstimator.hpp"
 #include "../../Common/Game/Entity.hpp"
 #include "../../Common/Game/FinalPacket.hpp"
+#include "../../Common/Game/FinalPacketSerialization.hpp"
+#include "../../Common/Game/FixedStepClock.hpp"
 //#include "../../Common/Game/MidtermPacket.hpp"
+#include "../../Common/Game/ReceivedPacketWindow.hpp"
+#include "../../Common/Game/SnapshotHistory.hpp"
+#include "../../Common/Game/UnacknowledgedPacketBuffer.hpp"
 #include "../../Common/Game/World.hpp"
+#include "BandwidthBudget.hpp"
+#include "InterestGrid.hpp"
 
 typedef FinalPacket MainPacketType;
 
+//-----------------------------------------------------------------------------------------------
+enum NetworkEngine
+{
+	ENGINE_Sockets = 0, //Plain socket calls: epoll, recvmmsg and sendmmsg on Linux; Winsock elsewhere
+	ENGINE_IOUring = 1	//Linux only; falls back to ENGINE_Sockets if the kernel can't run it
+};
+
+//-----------------------------------------------------------------------------------------------
+//Which room snapshot a snapshot message sent to a client belonged to, so its ack can be traced back.
+struct SentSnapshot
+{
+	PacketNumber packetNumber;
+	SnapshotSequence sequence;
+	double sendTimeSeconds; //The snapshot message's timestamp, for timing the ack
+	bool isAcknowledged; //Records pushed out without an ack count as lost for the client's bandwidth budget
+};
+
+//-----------------------------------------------------------------------------------------------
+typedef std::bitset< 256 > PlayerSet; //Indexed by ClientID
+
+//-----------------------------------------------------------------------------------------------
+//The players a client's snapshot brought fully up to date. Only those are known to match the server's
+//	room state at that sequence, so only those can be sent as deltas against it.
+struct TrackedPlayers
+{
+	SnapshotSequence sequence;
+	PlayerSet players;
+};
+
 //-----------------------------------------------------------------------------------------------
 struct ClientInfo
 {
+	static const unsigned int SENT_SNAPSHOT_RECORDS = 64;
+
 	unsigned char id;
-	std::string ipAddress;
+	sockaddr_in address;
+	Network::EndpointKey endpoint;
+	std::string ipAddress; //Only used for printouts; the send and receive paths use address and endpoint
 	unsigned short portNumber;
 
 	unsigned int currentPacketNumber;
-	std::set< MainPacketType, FinalPacketComparer > unacknowledgedPackets;
+	UnacknowledgedPacketBuffer unacknowledgedPackets;
+	ReceivedPacketWindow receivedPackets; //Acknowledged in the header of everything we send this client
+	Network::RoundTripEstimator roundTripTime; //Sets how long guaranteed packets wait for an ack before a resend
+	Network::OutgoingMessageBuffer outgoingMessages; //Everything sent to this client since the last flush
+	BandwidthBudget bandwidth;
 	float secondsSinceLastReceivedPacket;
 
+	SnapshotSequence acknowledgedSnapshot; //Baseline for this client's snapshot deltas
+	SentSnapshot sentSnapshots[ SENT_SNAPSHOT_RECORDS ]; //Indexed by packet number modulo SENT_SNAPSHOT_RECORDS
+	TrackedPlayers trackedPlayers[ SnapshotHistory::HISTORY_LENGTH ]; //Indexed by sequence modulo HISTORY_LENGTH
+	PlayerSet nearbyPlayers; //Players inside this client's area of interest as of the last snapshot
+	float playerPriorities[ 256 ]; //Indexed by ClientID; grows every snapshot a changed player is held back
+
 	RoomID currentRoom;
 	bool ownsCurrentRoom;
 	Entity* ownedPlayer;
+	InputSequence lastInputSequence; //Of the latest Input applied to ownedPlayer; snapshots echo it so the client can reconcile
+	float inputAllowance; //Inputs that may still move ownedPlayer; refilled at World::INPUTS_PER_SECOND by our clock
 
 	ClientInfo()
 		: id( 0 )
+		, endpoint( 0 )
+		, portNumber( 0 )
 		, currentPacketNumber( 1 )
 		, secondsSinceLastReceivedPacket( 0.f )
+		, acknowledgedSnapshot( SNAPSHOT_None )
 		, currentRoom( ROOM_None )
 		, ownsCurrentRoom( false )
 		, ownedPlayer( nullptr )
-	{ }
+		, lastInputSequence( INPUT_None )
+		, inputAllowance( 0.f )
+	{
+		memset( &address, 0, sizeof( sockaddr_in ) );
+		memset( sentSnapshots, 0, sizeof( sentSnapshots ) );
+		ForgetTrackedPlayers();
+	}
+
+	SentSnapshot* FindSentSnapshot( PacketNumber packetNumber )
+	{
+		SentSnapshot& sentSnapshot = sentSnapshots[ packetNumber % SENT_SNAPSHOT_RECORDS ];
+		if( packetNumber == 0 || sentSnapshot.packetNumber != packetNumber )
+			return nullptr;
+		return &sentSnapshot;
+	}
+
+	const PlayerSet* FindTrackedPlayers( SnapshotSequence sequence ) const
+	{
+		const TrackedPlayers& tracked = trackedPlayers[ sequence % SnapshotHistory::HISTORY_LENGTH ];
+		if( sequence == SNAPSHOT_None || tracked.sequence != sequence )
+			return nullptr;
+		return &tracked.players;
+	}
+
+	//Snapshot sequences are per room, so a client changing rooms starts over without a baseline
+	void ForgetSnapshots()
+	{
+		acknowledgedSnapshot = SNAPSHOT_None;
+		memset( sentSnapshots, 0, sizeof( sentSnapshots ) );
+		ForgetTrackedPlayers();
+	}
+
+	void ForgetTrackedPlayers()
+	{
+		for( unsigned int i = 0; i < SnapshotHistory::HISTORY_LENGTH; ++i )
+		{
+			trackedPlayers[ i ].sequence = SNAPSHOT_None;
+			trackedPlayers[ i ].players.reset();
+		}
+		nearbyPlayers.reset();
+		memset( playerPriorities, 0, sizeof( playerPriorities ) );
+	}
 
 	unsigned int GetNextPacketNumber()
 	{
@@ -43,69 +146,211 @@ struct ClientInfo
 		++currentPacketNumber;
 		return nextPacketNumber;
 	}
+
+	void RecordSentSnapshot( PacketNumber packetNumber, SnapshotSequence sequence, double sendTimeSeconds )
+	{
+		SentSnapshot& sentSnapshot = sentSnapshots[ packetNumber % SENT_SNAPSHOT_RECORDS ];
+		if( sentSnapshot.packetNumber != 0 && !sentSnapshot.isAcknowledged )
+			bandwidth.RecordLostPacket();
+
+		sentSnapshot.packetNumber = packetNumber;
+		sentSnapshot.sequence = sequence;
+		sentSnapshot.sendTimeSeconds = sendTimeSeconds;
+		sentSnapshot.isAcknowledged = false;
+	}
+
+	void RecordTrackedPlayers( SnapshotSequence sequence, const PlayerSet& players )
+	{
+		TrackedPlayers& tracked = trackedPlayers[ sequence % SnapshotHistory::HISTORY_LENGTH ];
+		tracked.sequence = sequence;
+		tracked.players = players;
+	}
+};
+
+//-----------------------------------------------------------------------------------------------
+//A datagram one worker thread passes to another. If handedOffClient is set, the receiving worker
+//	takes ownership of that client before processing the packet.
+struct RoutedDatagram
+{
+	MainPacketType packet;
+	sockaddr_in senderAddress;
+	ClientInfo* handedOffClient;
 };
 
+class ServerWorkerRouter;
+
 //-----------------------------------------------------------------------------------------------
 class GameServer
 {
-	static const size_t MAXIMUM_NUMBER_OF_GAME_ROOMS = 8;
+	static const unsigned int RECEIVE_BATCH_SIZE = Network::DatagramSocket::MAXIMUM_DATAGRAMS_PER_BATCH;
 	static const float SECONDS_BEFORE_CLIENT_TIMES_OUT;
-	static const float SECONDS_BEFORE_GUARANTEED_PACKET_RESENT;
+	static const unsigned int MAXIMUM_GUARANTEED_PACKET_RESENDS = 8;
 	static const float SECONDS_SINCE_LAST_CLIENT_PRINTOUT;
+	static const float INTEREST_ENTER_RADIUS;
+	static const float INTEREST_EXIT_RADIUS;
+	static const unsigned int SNAPSHOTS_BETWEEN_DISTANT_UPDATES = 10;
+	static const float OWN_PLAYER_PRIORITY;
+	static const float OTHER_PLAYER_PRIORITY;
+	static const unsigned int MAXIMUM_BANKED_INPUTS = 15; //A quarter second of Inputs, so a burst after network jitter isn't mistaken for speeding
+	static const unsigned int MAXIMUM_LATE_STEPS_PER_TICK = 3; //Past this a room falls behind real time instead of further behind the network
+	static const float MAXIMUM_REWIND_SECONDS;
+
+	//One part of a room snapshot, encoded into the shared arena for every receiver with the same baseline
+	struct EncodedSnapshotPart
+	{
+		SnapshotSequence baselineSequence;
+		bool isShared; //Only receivers that track every player can reuse a part
+		unsigned char numberOfParts;
+		const char* body;
+		unsigned int bodyBytes;
+	};
+
+	//A changed player competing for room in one receiver's snapshot
+	struct PrioritizedPlayer
+	{
+		ClientID id;
+		float priority;
+		unsigned int wireBits;
+
+		bool operator<( const PrioritizedPlayer& other ) const { return priority > other.priority; } //Highest first
+	};
 
 public:
+	static const size_t MAXIMUM_NUMBER_OF_GAME_ROOMS = 8;
+	static const unsigned int DEFAULT_SIMULATION_STEPS_PER_SECOND = 60;
+	static const unsigned int DEFAULT_SNAPSHOTS_PER_SECOND = 20;
+	static const unsigned int MAXIMUM_SIMULATION_STEPS_PER_SECOND = PlayerPositionHistory::MAXIMUM_TICKS_PER_SECOND;
+	static const unsigned int MINIMUM_SNAPSHOTS_PER_SECOND = 10; //Any slower and World::INTERPOLATION_DELAY_SECONDS doesn't cover a snapshot interval
+	static const unsigned int MINIMUM_TICKS_PER_SECOND = 60; //Ticks also send resends, acknowledgements and lobby updates
+
 	GameServer();
-	~GameServer() { }
+	~GameServer() { delete m_serverSocket; }
 
-	void Initialize( const std::string& portNumber );
+	void Initialize( const std::string& portNumber, NetworkEngine engine = ENGINE_Sockets, ServerWorkerRouter* router = nullptr, unsigned int workerIndex = 0 );
+	void SetMaximumClientBytesPerSecond( unsigned int bytesPerSecond ) { m_maximumClientBytesPerSecond = bytesPerSecond; }
+	void SetTickRates( unsigned int simulationStepsPerSecond, unsigned int snapshotsPerSecond );
+	ErrorCode SetTickRatesOfRoom( RoomID room, unsigned int simulationStepsPerSecond, unsigned int snapshotsPerSecond );
 	void Update( float deltaSeconds );
 
+	//Event loop support
+	double GetTickSeconds() const { return 1.0 / static_cast< double >( m_ticksPerSecond ); }
+	int GetInboxReadinessDescriptor() const;
+	int GetNetworkReadinessDescriptor() const { return m_serverSocket->GetReadinessDescriptor(); }
+	void HandleIncomingPackets();
+	int WaitForIncomingPackets( int timeoutMilliseconds ) { return m_serverSocket->WaitForIncomingData( timeoutMilliseconds ); }
+
 private:
 	//Utilities
-	ClientInfo* FindClientByAddress( const std::string& ipAddress, unsigned short portNumber );
+	ClientInfo* FindClientByEndpoint( Network::EndpointKey endpoint ) const;
 	ClientInfo* FindClientByID( unsigned short clientID );
+	unsigned int GetMaximumStepsPerTick( unsigned int stepsPerSecond ) const;
 	World* GetRoomWithID( RoomID roomID ) { return m_openRooms[ roomID - 1 ]; } //Rooms start at 1
 
 	//Packet Senders
 	void AcknowledgePacketFromClient( const MainPacketType& packet, ClientInfo* client );
-	void BroadcastGameStateToClients();
+	void BroadcastGameStateToClients( float deltaSeconds );
 	void BroadcastPacketToAllPlayersInRoom( const MainPacketType& packet, RoomID room );
+	void BroadcastSnapshotOfRoom( RoomID room, double timestamp );
 	ErrorCode CreateNewRoomForClient( RoomID room, ClientInfo* client );
 	void HandleTouchAndResetGame( const MainPacketType& touchPacket );
 	ErrorCode MoveClientToRoom( ClientInfo* client, RoomID room, bool ownsRoom );
 	void RefusePacketFromClient( const MainPacketType& packet, ClientInfo* client, ErrorCode errorCode );
 	void ResetClient( ClientInfo* client );
 
-	ClientInfo* AddNewClient( const std::string& ipAddress, unsigned short portNumber );
+	ClientInfo* AddNewClient( const sockaddr_in& address );
+	void ApplyLaserImpactsInRoom( RoomID room );
+	void AttachClient( ClientInfo* client );
 	void CloseRoom( RoomID room );
 	ErrorCode CreateNewWorldAtRoomID( RoomID id );
+	void DetachClient( ClientInfo* client );
+	const char* EncodeSharedBody( const MainPacketType& packet, unsigned int& out_bodyBytes );
+	const char* EncodeSharedSnapshot( const RoomSnapshotPacket& snapshot, unsigned int& out_snapshotBytes );
+	void EncodeSnapshotParts( const RoomState& currentState, SnapshotSequence sequence, const PlayerSet& trackedPlayers, SnapshotSequence baselineSequence, const RoomState* baseline, const PlayerSet* trackedAtBaseline, bool isShared );
+	double EstimateViewTimestampOfShot( const MainPacketType& firePacket, const ClientInfo* client ) const;
+	const QuantizedGameUpdate* FindDeltaBaselineOfPlayer( ClientID player, const RoomState* baseline, const PlayerSet* trackedAtBaseline ) const;
+	void FlushPacketsToClient( ClientInfo* client );
+	void FlushPacketsToClients();
+	bool ForwardDatagramToOwningWorker( const MainPacketType& receivedPacket, const sockaddr_in& receivedAddress );
+	bool HandOffClientToOwningWorker( const MainPacketType& roomRequestPacket, ClientInfo* client );
+	void LimitTrackedPlayersToBudget( ClientInfo* client, const RoomState* baseline, const PlayerSet* trackedAtBaseline, PlayerSet& inout_trackedPlayers );
 	void PrintConnectedClients() const;
+	void PrintDroppedTraffic();
 	void ProcessNetworkQueue();
-	void ReceiveUpdateFromClient( const MainPacketType& updatePacket, ClientInfo* client );
-	void RemoveAcknowledgedPacketFromClientQueue( const MainPacketType& ackPacket, ClientInfo* client );
+	void ProcessPacketFromAddress( const MainPacketType& receivedPacket, const sockaddr_in& receivedAddress );
+	void ProcessRoutedDatagrams();
+	void QueuePacketsForClient( ClientInfo* client );
+	void ReceiveInputFromClient( const MainPacketType& inputPacket, ClientInfo* client );
+	void RecordUnacknowledgedPacket( const MainPacketType& packet, const char* body, unsigned int bodyBytes, ClientInfo* client );
+	void RemoveAcknowledgedPacketsFromClientQueue( const MainPacketType& receivedPacket, ClientInfo* client );
 	void ResendUnacknowledgedPacketsToClient( ClientInfo* client );
+	void SendAcknowledgementToClient( ClientInfo* client );
 	void SendPacketToClient( MainPacketType& packet, ClientInfo* client );
+	void SendPacketToClientWithSharedBody( MainPacketType& packet, const char* sharedBody, unsigned int bodyBytes, ClientInfo* client );
+	void SendTimeSyncReplyToClient( const MainPacketType& requestPacket, ClientInfo* client );
 	void UpdateGameState( float deltaSeconds );
+	void UpdateNearbyPlayersOfClient( ClientInfo* client );
 
 
 	//Data Members
-	Network::UDPSocket m_serverSocket;
+	Network::DatagramSocket* m_serverSocket;
+	char m_receivedDatagramBytes[ RECEIVE_BATCH_SIZE ][ Network::MAXIMUM_DATAGRAM_PAYLOAD_BYTES ];
+	Network::ReceivedDatagram m_receivedDatagrams[ RECEIVE_BATCH_SIZE ];
+	Network::SharedMessageArena m_sharedMessageBodies; //Broadcast bodies, encoded once per tick; reset after each flush
+	std::vector< Network::BufferSegment > m_datagramSegments;
+
+	//Multi-threaded mode only; null when this is the only GameServer in the process
+	ServerWorkerRouter* m_router;
+	unsigned int m_workerIndex;
+	std::mt19937 m_randomNumberGenerator; //Per worker
+	std::vector< RoutedDatagram > m_routedDatagrams;
 
 	unsigned int m_nextClientID;
 	std::vector< ClientInfo* > m_clientList;
+	Network::EndpointTable< ClientInfo* > m_clientsByEndpoint;
+	std::vector< ClientInfo* > m_clientsInRoom[ MAXIMUM_NUMBER_OF_GAME_ROOMS ]; //Rebuilt every broadcast
+	SnapshotHistory m_roomSnapshots[ MAXIMUM_NUMBER_OF_GAME_ROOMS ];
+	InterestGrid m_interestGrid; //The room being snapshotted, rebuilt for each one
+	std::vector< NearbyPlayer > m_nearbyPlayers;
+	RoomState m_currentRoomState;
+	std::vector< PlayerStateDelta > m_playerDeltas;
+	std::vector< PrioritizedPlayer > m_prioritizedPlayers;
+	std::vector< EncodedSnapshotPart > m_encodedSnapshotParts; //This room's parts for this tick, grouped by baseline
+	std::vector< std::pair< const Entity*, const Entity* > > m_laserImpacts; //Target and firer in the room being updated, rebuilt for each one
 
+	unsigned int m_maximumClientBytesPerSecond; //Each new client's bandwidth budget starts here
 	unsigned short m_itPlayerID;
 	World* m_openRooms[ MAXIMUM_NUMBER_OF_GAME_ROOMS ];
+	FixedStepClock m_simulationClocks[ MAXIMUM_NUMBER_OF_GAME_ROOMS ]; //Rates stay with the room ID when a room closes and reopens
+	FixedStepClock m_snapshotClocks[ MAXIMUM_NUMBER_OF_GAME_ROOMS ];
+	FixedStepClock m_lobbyUpdateClock;
+	unsigned int m_ticksPerSecond; //The event loop's rate, fast enough for the fastest simulation rate
+	float m_secondsSinceClientsLastPrinted;
+	unsigned int m_malformedMessagesSinceLastPrintout;
+	unsigned int m_droppedMessagesSinceLastPrintout;
+	unsigned int m_failedSendsSinceLastPrintout;
+	int m_lastSendErrorCode;
 };
 
 inline GameServer::GameServer()
-	: m_nextClientID( 1 )
+	: m_serverSocket( nullptr )
+	, m_router( nullptr )
+	, m_workerIndex( 0 )
+	, m_nextClientID( 1 )
+	, m_interestGrid( INTEREST_EXIT_RADIUS )
+	, m_maximumClientBytesPerSecond( BandwidthBudget::DEFAULT_MAXIMUM_BYTES_PER_SECOND )
 	, m_itPlayerID( 0 )
+	, m_ticksPerSecond( MINIMUM_TICKS_PER_SECOND )
+	, m_secondsSinceClientsLastPrinted( 0.f )
+	, m_malformedMessagesSinceLastPrintout( 0 )
+	, m_droppedMessagesSinceLastPrintout( 0 )
+	, m_failedSendsSinceLastPrintout( 0 )
+	, m_lastSendErrorCode( 0 )
 {
 	for( unsigned char i = 0; i < MAXIMUM_NUMBER_OF_GAME_ROOMS; ++i )
 	{
 		m_openRooms[ i ] = nullptr;
 	}
+	SetTickRates( DEFAULT_SIMULATION_STEPS_PER_SECOND, DEFAULT_SNAPSHOTS_PER_SECOND );
 }
 
 #endif //INCLUDED_GAME_SERVER_HPP
@@ -0,0 +1,110 @@
+#pragma once
+#ifndef INCLUDED_INTEREST_GRID_HPP
+#define INCLUDED_INTEREST_GRID_HPP
+
+//-----------------------------------------------------------------------------------------------
+#include <algorithm>
+#include <math.h>
+#include <vector>
+#include "../../Common/Game/FinalPacket.hpp"
+
+//-----------------------------------------------------------------------------------------------
+struct NearbyPlayer
+{
+	ClientID id;
+	float distanceSquared;
+};
+
+//-----------------------------------------------------------------------------------------------
+//Uniform grid of one room's players, rebuilt every snapshot, for finding who is near whom without
+//	checking every pair. Players are kept sorted by cell, so a query is a few binary searches and
+//	nothing allocates once the entry list has grown to the room's size.
+//Queries only look at the 3x3 cells around the point, so the radius can't be bigger than a cell.
+class InterestGrid
+{
+public:
+	InterestGrid( float cellSize ) : m_cellSize( cellSize ) { }
+
+	void Clear() { m_entries.clear(); }
+	void Insert( ClientID id, float xPosition, float yPosition );
+	void SortEntries(); //Call once after inserting and before querying
+
+	void FindPlayersWithinRadius( float xPosition, float yPosition, float radius, std::vector< NearbyPlayer >& out_nearbyPlayers ) const;
+
+private:
+	struct GridEntry
+	{
+		unsigned long long cellKey;
+		ClientID id;
+		float xPosition;
+		float yPosition;
+
+		bool operator<( const GridEntry& other ) const { return cellKey < other.cellKey; }
+	};
+
+	unsigned long long GetCellKey( int xCell, int yCell ) const;
+	int GetCellIndex( float position ) const { return static_cast< int >( floorf( position / m_cellSize ) ); }
+
+	float m_cellSize;
+	std::vector< GridEntry > m_entries;
+};
+
+
+
+//-----------------------------------------------------------------------------------------------
+inline void InterestGrid::Insert( ClientID id, float xPosition, float yPosition )
+{
+	GridEntry newEntry;
+	newEntry.cellKey = GetCellKey( GetCellIndex( xPosition ), GetCellIndex( yPosition ) );
+	newEntry.id = id;
+	newEntry.xPosition = xPosition;
+	newEntry.yPosition = yPosition;
+	m_entries.push_back( newEntry );
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void InterestGrid::SortEntries()
+{
+	std::sort( m_entries.begin(), m_entries.end() );
+}
+
+//-----------------------------------------------------------------------------------------------
+//Appends to out_nearbyPlayers; the player at the point itself is included too.
+inline void InterestGrid::FindPlayersWithinRadius( float xPosition, float yPosition, float radius, std::vector< NearbyPlayer >& out_nearbyPlayers ) const
+{
+	float radiusSquared = radius * radius;
+	int centerXCell = GetCellIndex( xPosition );
+	int centerYCell = GetCellIndex( yPosition );
+
+	for( int xCell = centerXCell - 1; xCell <= centerXCell + 1; ++xCell )
+	{
+		for( int yCell = centerYCell - 1; yCell <= centerYCell + 1; ++yCell )
+		{
+			GridEntry searchEntry;
+			searchEntry.cellKey = GetCellKey( xCell, yCell );
+
+			std::vector< GridEntry >::const_iterator entry = std::lower_bound( m_entries.begin(), m_entries.end(), searchEntry );
+			for( ; entry != m_entries.end() && entry->cellKey == searchEntry.cellKey; ++entry )
+			{
+				float xDistance = entry->xPosition - xPosition;
+				float yDistance = entry->yPosition - yPosition;
+				float distanceSquared = xDistance * xDistance + yDistance * yDistance;
+				if( distanceSquared > radiusSquared )
+					continue;
+
+				NearbyPlayer nearbyPlayer;
+				nearbyPlayer.id = entry->id;
+				nearbyPlayer.distanceSquared = distanceSquared;
+				out_nearbyPlayers.push_back( nearbyPlayer );
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+inline unsigned long long InterestGrid::GetCellKey( int xCell, int yCell ) const
+{
+	return ( static_cast< unsigned long long >( static_cast< unsigned int >( xCell ) ) << 32 ) | static_cast< unsigned int >( yCell );
+}
+
+#endif //INCLUDED_INTEREST_GRID_HPP
@@ -0,0 +1,161 @@
+#include "ServerEventLoop.hpp"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../Common/Engine/TimeInterface.hpp"
+#include "GameServer.hpp"
+
+#if defined( PLATFORM_LINUX )
+	#include <sys/epoll.h>
+	#include <sys/timerfd.h>
+	#include <unistd.h>
+#endif
+
+//-----------------------------------------------------------------------------------------------
+ServerEventLoop::ServerEventLoop( GameServer* server, double tickSeconds )
+	: m_server( server )
+	, m_tickSeconds( tickSeconds )
+	, m_lastTickTimeSeconds( 0.0 )
+	, m_nextTickTimeSeconds( 0.0 )
+#if defined( PLATFORM_LINUX )
+	, m_epollID( -1 )
+	, m_tickTimerID( -1 )
+#endif
+{
+}
+
+//-----------------------------------------------------------------------------------------------
+ServerEventLoop::~ServerEventLoop()
+{
+#if defined( PLATFORM_LINUX )
+	if( m_tickTimerID >= 0 )
+		close( m_tickTimerID );
+	if( m_epollID >= 0 )
+		close( m_epollID );
+#endif
+}
+
+//-----------------------------------------------------------------------------------------------
+int ServerEventLoop::Initialize()
+{
+	m_lastTickTimeSeconds = GetCurrentTimeSeconds();
+	m_nextTickTimeSeconds = m_lastTickTimeSeconds + m_tickSeconds;
+
+#if defined( PLATFORM_LINUX )
+	m_epollID = epoll_create1( EPOLL_CLOEXEC );
+	if( m_epollID < 0 )
+	{
+		printf( "Failed to create server epoll instance. Error Code: %d\n", errno );
+		return -1;
+	}
+
+	m_tickTimerID = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+	if( m_tickTimerID < 0 )
+	{
+		printf( "Failed to create server tick timer. Error Code: %d\n", errno );
+		return -2;
+	}
+
+	itimerspec tickInterval;
+	tickInterval.it_interval.tv_sec = static_cast< time_t >( m_tickSeconds );
+	tickInterval.it_interval.tv_nsec = static_cast< long >( ( m_tickSeconds - tickInterval.it_interval.tv_sec ) * 1000000000.0 );
+	tickInterval.it_value = tickInterval.it_interval;
+	if( timerfd_settime( m_tickTimerID, 0, &tickInterval, nullptr ) < 0 )
+	{
+		printf( "Failed to start server tick timer. Error Code: %d\n", errno );
+		return -3;
+	}
+
+	//The timer, the server socket, and (in multi-threaded mode) the worker's inbox
+	int watchedDescriptors[ 3 ] = { m_tickTimerID, m_server->GetNetworkReadinessDescriptor(), m_server->GetInboxReadinessDescriptor() };
+	for( unsigned int i = 0; i < 3; ++i )
+	{
+		if( watchedDescriptors[ i ] < 0 )
+			continue;
+
+		epoll_event readableEvent;
+		readableEvent.events = EPOLLIN;
+		readableEvent.data.fd = watchedDescriptors[ i ];
+		if( epoll_ctl( m_epollID, EPOLL_CTL_ADD, watchedDescriptors[ i ], &readableEvent ) < 0 )
+		{
+			printf( "Failed to register descriptor with server epoll instance. Error Code: %d\n", errno );
+			return -4;
+		}
+	}
+#endif
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------------------------
+void ServerEventLoop::Run()
+{
+#if defined( PLATFORM_LINUX )
+	epoll_event readyEvents[ MAXIMUM_EVENTS_PER_WAIT ];
+	while( true )
+	{
+		int numberOfReadyEvents = epoll_wait( m_epollID, readyEvents, MAXIMUM_EVENTS_PER_WAIT, -1 );
+		if( numberOfReadyEvents < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+
+			printf( "Server event loop wait failed. Error Code: %d\n", errno );
+			exit( -20 );
+		}
+
+		bool tickIsDue = false;
+		bool packetsAreWaiting = false;
+		for( int i = 0; i < numberOfReadyEvents; ++i )
+		{
+			if( readyEvents[ i ].data.fd == m_tickTimerID )
+			{
+				unsigned long long numberOfExpirations = 0;
+				if( read( m_tickTimerID, &numberOfExpirations, sizeof( numberOfExpirations ) ) > 0 )
+					tickIsDue = true;
+			}
+			else
+			{
+				packetsAreWaiting = true;
+			}
+		}
+
+		if( packetsAreWaiting )
+			m_server->HandleIncomingPackets();
+		if( tickIsDue )
+			RunTick();
+	}
+#else
+	while( true )
+	{
+		double timeNow = GetCurrentTimeSeconds();
+		if( timeNow >= m_nextTickTimeSeconds )
+		{
+			RunTick();
+
+			//If we fell more than a tick behind, don't try to catch up with a burst of ticks
+			m_nextTickTimeSeconds += m_tickSeconds;
+			if( m_nextTickTimeSeconds < timeNow )
+				m_nextTickTimeSeconds = timeNow + m_tickSeconds;
+			continue;
+		}
+
+		int millisecondsUntilTick = static_cast< int >( ceil( ( m_nextTickTimeSeconds - timeNow ) * 1000.0 ) );
+		if( m_server->WaitForIncomingPackets( millisecondsUntilTick ) > 0 )
+			m_server->HandleIncomingPackets();
+	}
+#endif
+}
+
+//-----------------------------------------------------------------------------------------------
+//The timer can fire late, so the simulation gets the time that actually passed.
+void ServerEventLoop::RunTick()
+{
+	double timeNow = GetCurrentTimeSeconds();
+	float deltaSeconds = static_cast< float >( timeNow - m_lastTickTimeSeconds );
+	m_lastTickTimeSeconds = timeNow;
+
+	m_server->Update( deltaSeconds );
+}
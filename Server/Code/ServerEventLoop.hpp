@@ -0,0 +1,38 @@
+#pragma once
+#ifndef INCLUDED_SERVER_EVENT_LOOP_HPP
+#define INCLUDED_SERVER_EVENT_LOOP_HPP
+
+//-----------------------------------------------------------------------------------------------
+#include "../../Common/Engine/EngineMacros.hpp"
+class GameServer;
+
+//-----------------------------------------------------------------------------------------------
+//Drives one GameServer: handles packets the moment they arrive and runs Update on tick boundaries,
+//	sleeping in between. On Linux it waits in epoll on the server's sockets and a periodic timerfd;
+//	elsewhere it waits on the socket with a timeout that ends at the next tick.
+class ServerEventLoop
+{
+	static const unsigned int MAXIMUM_EVENTS_PER_WAIT = 4;
+
+public:
+	ServerEventLoop( GameServer* server, double tickSeconds );
+	~ServerEventLoop();
+
+	int Initialize();
+	void Run();
+
+private:
+	void RunTick();
+
+	GameServer* m_server;
+	double m_tickSeconds;
+	double m_lastTickTimeSeconds;
+	double m_nextTickTimeSeconds;
+
+#if defined( PLATFORM_LINUX )
+	int m_epollID;
+	int m_tickTimerID;
+#endif
+};
+
+#endif //INCLUDED_SERVER_EVENT_LOOP_HPP
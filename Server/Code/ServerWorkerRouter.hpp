@@ -0,0 +1,163 @@
+#pragma once
+#ifndef INCLUDED_SERVER_WORKER_ROUTER_HPP
+#define INCLUDED_SERVER_WORKER_ROUTER_HPP
+
+//-----------------------------------------------------------------------------------------------
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "../../Common/Engine/EndpointTable.hpp"
+#include "GameServer.hpp"
+
+#if defined( PLATFORM_LINUX )
+	#include <sys/eventfd.h>
+#endif
+
+//-----------------------------------------------------------------------------------------------
+//State shared by every worker thread when the server runs with more than one GameServer.
+//Each worker owns a fixed subset of the game rooms; clients live on the worker that owns their room.
+//The kernel spreads datagrams across the SO_REUSEPORT sockets by address hash, so a worker that
+//	receives a datagram for a client it doesn't own forwards it to the owner's inbox.
+class ServerWorkerRouter
+{
+public:
+	ServerWorkerRouter( unsigned int numberOfWorkers );
+	~ServerWorkerRouter();
+
+	unsigned int GetNumberOfWorkers() const { return m_numberOfWorkers; }
+	unsigned int GetWorkerOwningRoom( RoomID room ) const { return ( room - 1 ) % m_numberOfWorkers; } //Rooms start at 1
+	unsigned char GetNextClientID() { return static_cast< unsigned char >( m_nextClientID++ ); }
+
+	//Endpoint routing
+	bool FindWorkerForEndpoint( Network::EndpointKey endpoint, unsigned int& out_workerIndex );
+	void RemoveEndpoint( Network::EndpointKey endpoint, unsigned int workerIndex );
+	void SetWorkerForEndpoint( Network::EndpointKey endpoint, unsigned int workerIndex );
+
+	//Worker inboxes
+	void PushToWorker( unsigned int workerIndex, const RoutedDatagram& datagram );
+	void TakeInboxOfWorker( unsigned int workerIndex, std::vector< RoutedDatagram >& out_datagrams );
+	int GetInboxReadinessDescriptor( unsigned int workerIndex ) const { return m_inboxes[ workerIndex ].wakeID; }
+
+	//Lobby counts (each room's count is written only by its owning worker)
+	char GetPlayersInRoom( RoomID room ) const { return m_playersInRoom[ room - 1 ].load( std::memory_order_relaxed ); }
+	void SetPlayersInRoom( RoomID room, char numberOfPlayers ) { m_playersInRoom[ room - 1 ].store( numberOfPlayers, std::memory_order_relaxed ); }
+
+private:
+	struct WorkerInbox
+	{
+		std::mutex lock;
+		std::vector< RoutedDatagram > datagrams;
+		int wakeID; //eventfd that's readable while the inbox has datagrams; -1 where there are no eventfds
+	};
+
+	ServerWorkerRouter( const ServerWorkerRouter& );
+	ServerWorkerRouter& operator=( const ServerWorkerRouter& );
+
+	unsigned int m_numberOfWorkers;
+	std::atomic< unsigned int > m_nextClientID;
+
+	std::mutex m_endpointLock;
+	Network::EndpointTable< unsigned int > m_workersByEndpoint;
+
+	std::vector< WorkerInbox > m_inboxes;
+	std::atomic< char > m_playersInRoom[ GameServer::MAXIMUM_NUMBER_OF_GAME_ROOMS ];
+};
+
+
+
+//-----------------------------------------------------------------------------------------------
+inline ServerWorkerRouter::ServerWorkerRouter( unsigned int numberOfWorkers )
+	: m_numberOfWorkers( numberOfWorkers )
+	, m_inboxes( numberOfWorkers )
+{
+	m_nextClientID.store( 1 );
+	for( unsigned int i = 0; i < GameServer::MAXIMUM_NUMBER_OF_GAME_ROOMS; ++i )
+	{
+		m_playersInRoom[ i ].store( 0 );
+	}
+
+	for( unsigned int i = 0; i < m_numberOfWorkers; ++i )
+	{
+	#if defined( PLATFORM_LINUX )
+		m_inboxes[ i ].wakeID = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	#else
+		m_inboxes[ i ].wakeID = -1;
+	#endif
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+inline ServerWorkerRouter::~ServerWorkerRouter()
+{
+#if defined( PLATFORM_LINUX )
+	for( unsigned int i = 0; i < m_numberOfWorkers; ++i )
+	{
+		if( m_inboxes[ i ].wakeID >= 0 )
+			close( m_inboxes[ i ].wakeID );
+	}
+#endif
+}
+
+//-----------------------------------------------------------------------------------------------
+inline bool ServerWorkerRouter::FindWorkerForEndpoint( Network::EndpointKey endpoint, unsigned int& out_workerIndex )
+{
+	std::lock_guard< std::mutex > endpointGuard( m_endpointLock );
+
+	unsigned int* foundWorker = m_workersByEndpoint.Find( endpoint );
+	if( foundWorker == nullptr )
+		return false;
+
+	out_workerIndex = *foundWorker;
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+//Only removes the entry if it still points at workerIndex, so a stale removal can't undo a handoff.
+inline void ServerWorkerRouter::RemoveEndpoint( Network::EndpointKey endpoint, unsigned int workerIndex )
+{
+	std::lock_guard< std::mutex > endpointGuard( m_endpointLock );
+
+	unsigned int* foundWorker = m_workersByEndpoint.Find( endpoint );
+	if( foundWorker != nullptr && *foundWorker == workerIndex )
+		m_workersByEndpoint.Remove( endpoint );
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void ServerWorkerRouter::SetWorkerForEndpoint( Network::EndpointKey endpoint, unsigned int workerIndex )
+{
+	std::lock_guard< std::mutex > endpointGuard( m_endpointLock );
+	m_workersByEndpoint.Insert( endpoint, workerIndex );
+}
+
+//-----------------------------------------------------------------------------------------------
+inline void ServerWorkerRouter::PushToWorker( unsigned int workerIndex, const RoutedDatagram& datagram )
+{
+	WorkerInbox& inbox = m_inboxes[ workerIndex ];
+	std::lock_guard< std::mutex > inboxGuard( inbox.lock );
+	inbox.datagrams.push_back( datagram );
+
+#if defined( PLATFORM_LINUX )
+	//Only the first datagram needs to wake the worker; it takes the whole inbox at once
+	if( inbox.datagrams.size() == 1 && inbox.wakeID >= 0 )
+		eventfd_write( inbox.wakeID, 1 );
+#endif
+}
+
+//-----------------------------------------------------------------------------------------------
+//Swaps the inbox out under the lock so the worker processes it without holding anything.
+inline void ServerWorkerRouter::TakeInboxOfWorker( unsigned int workerIndex, std::vector< RoutedDatagram >& out_datagrams )
+{
+	out_datagrams.clear();
+
+	WorkerInbox& inbox = m_inboxes[ workerIndex ];
+	std::lock_guard< std::mutex > inboxGuard( inbox.lock );
+	out_datagrams.swap( inbox.datagrams );
+
+#if defined( PLATFORM_LINUX )
+	eventfd_t numberOfWakes = 0;
+	if( !out_datagrams.empty() && inbox.wakeID >= 0 )
+		eventfd_read( inbox.wakeID, &numberOfWakes );
+#endif
+}
+
+#endif //INCLUDED_SERVER_WORKER_ROUTER_HPP
@@ -1,11 +1,15 @@
 #include <iostream>
+#include <thread>
+#include <vector>
 #pragma comment( lib, "opengl32" ) // Link in the OpenGL32.lib static library
 
 #include "../../Common/Engine/TimeInterface.hpp"
 #include "GameServer.hpp"
+#include "ServerEventLoop.hpp"
+#include "ServerWorkerRouter.hpp"
 
-static const double LOCKED_FRAME_RATE_SECONDS = 1.0 / 60.0;
 static const unsigned int MESSAGE_BUFFER_LENGTH = 512;
+static const unsigned int MAXIMUM_WORKER_THREADS = GameServer::MAXIMUM_NUMBER_OF_GAME_ROOMS; //More would own no rooms
 
 //-----------------------------------------------------------------------------------------------
 enum ConnectionMode
@@ -18,36 +22,99 @@ enum ConnectionMode
 };
 
 //-----------------------------------------------------------------------------------------------
-double WaitUntilNextFrameThenGiveFrameTime()
+int HandleCommandLine( int argc, char** argv, std::string& out_portNumber, NetworkEngine& out_networkEngine, unsigned int& out_numberOfWorkers, unsigned int& out_clientBytesPerSecond,
+	unsigned int& out_simulationStepsPerSecond, unsigned int& out_snapshotsPerSecond )
 {
-	static double targetTime = 0.0;
-	double timeNow = GetCurrentTimeSeconds();
+	if( argc < 2 || argc > 7 )
+	{
+		std::cout << "Incorrect number of arguments!" << std::endl;
+		std::cout << "Usage: " << argv[0] << " [Port Number] [Network Engine: sockets (default) | iouring] [Worker Threads (default 1)]"
+			<< " [Bandwidth Per Client in KB/s (default " << BandwidthBudget::DEFAULT_MAXIMUM_BYTES_PER_SECOND / 1024 << ")]"
+			<< " [Simulation Steps Per Second (default " << GameServer::DEFAULT_SIMULATION_STEPS_PER_SECOND << ")]"
+			<< " [Snapshots Per Second (default " << GameServer::DEFAULT_SNAPSHOTS_PER_SECOND << ")]" << std::endl;
+		return -1;
+	}
 
-	while( timeNow < targetTime )
+	//Address
+	out_portNumber = argv[ 1 ];
+
+	//Network Engine
+	out_networkEngine = ENGINE_Sockets;
+	if( argc >= 3 )
 	{
-		timeNow = GetCurrentTimeSeconds();
+		std::string engineName = argv[ 2 ];
+		if( engineName.compare( "iouring" ) == 0 )
+			out_networkEngine = ENGINE_IOUring;
+		else if( engineName.compare( "sockets" ) != 0 )
+		{
+			std::cout << "Unknown network engine \"" << engineName << "\"! Expected sockets or iouring." << std::endl;
+			return -1;
+		}
 	}
-	targetTime = timeNow + LOCKED_FRAME_RATE_SECONDS;
 
-	return LOCKED_FRAME_RATE_SECONDS;
-}
+	//Worker Threads
+	out_numberOfWorkers = 1;
+	if( argc >= 4 )
+	{
+		out_numberOfWorkers = strtoul( argv[ 3 ], 0, 10 );
+		if( out_numberOfWorkers == 0 || out_numberOfWorkers > MAXIMUM_WORKER_THREADS )
+		{
+			std::cout << "Worker thread count must be between 1 and " << MAXIMUM_WORKER_THREADS << "!" << std::endl;
+			return -1;
+		}
+	}
 
-//-----------------------------------------------------------------------------------------------
-int HandleCommandLine( int argc, char** argv, std::string& out_portNumber )
-{
-	if( argc != 2 )
+	//Bandwidth Per Client
+	out_clientBytesPerSecond = BandwidthBudget::DEFAULT_MAXIMUM_BYTES_PER_SECOND;
+	if( argc >= 5 )
 	{
-		std::cout << "Incorrect number of arguments!" << std::endl;
-		std::cout << "Usage: " << argv[0] << " [Port Number]" << std::endl;
-		return -1;
+		out_clientBytesPerSecond = strtoul( argv[ 4 ], 0, 10 ) * 1024;
+		if( out_clientBytesPerSecond < BandwidthBudget::MINIMUM_BYTES_PER_SECOND )
+		{
+			std::cout << "Bandwidth per client must be at least " << BandwidthBudget::MINIMUM_BYTES_PER_SECOND / 1024 << " KB/s!" << std::endl;
+			return -1;
+		}
 	}
 
-	//Address
-	out_portNumber = argv[ 1 ];
+	//Simulation Rate
+	out_simulationStepsPerSecond = GameServer::DEFAULT_SIMULATION_STEPS_PER_SECOND;
+	if( argc >= 6 )
+	{
+		out_simulationStepsPerSecond = strtoul( argv[ 5 ], 0, 10 );
+		if( out_simulationStepsPerSecond < GameServer::MINIMUM_SNAPSHOTS_PER_SECOND || out_simulationStepsPerSecond > GameServer::MAXIMUM_SIMULATION_STEPS_PER_SECOND )
+		{
+			std::cout << "Simulation steps per second must be between " << GameServer::MINIMUM_SNAPSHOTS_PER_SECOND << " and " << GameServer::MAXIMUM_SIMULATION_STEPS_PER_SECOND << "!" << std::endl;
+			return -1;
+		}
+	}
+
+	//Snapshot Rate
+	out_snapshotsPerSecond = GameServer::DEFAULT_SNAPSHOTS_PER_SECOND;
+	if( out_snapshotsPerSecond > out_simulationStepsPerSecond )
+		out_snapshotsPerSecond = out_simulationStepsPerSecond;
+	if( argc == 7 )
+	{
+		out_snapshotsPerSecond = strtoul( argv[ 6 ], 0, 10 );
+		if( out_snapshotsPerSecond < GameServer::MINIMUM_SNAPSHOTS_PER_SECOND || out_snapshotsPerSecond > out_simulationStepsPerSecond )
+		{
+			std::cout << "Snapshots per second must be between " << GameServer::MINIMUM_SNAPSHOTS_PER_SECOND << " and the simulation steps per second!" << std::endl;
+			return -1;
+		}
+	}
 
 	return 0;
 }
 
+//-----------------------------------------------------------------------------------------------
+void RunServerLoop( GameServer* server )
+{
+	ServerEventLoop eventLoop( server, server->GetTickSeconds() );
+	if( eventLoop.Initialize() < 0 )
+		exit( -19 );
+
+	eventLoop.Run();
+}
+
 //-----------------------------------------------------------------------------------------------
 int main( int argc, char** argv )
 {
@@ -58,21 +125,48 @@ int main( int argc, char** argv )
 	std::string ipAddress = "127.0.0.1"; //localhost
 	Network::Protocol netProtocol = Network::PROTOCOL_TCP;
 	std::string portNumber = "22"; //telnet
+	NetworkEngine networkEngine = ENGINE_Sockets;
+	unsigned int numberOfWorkers = 1;
+	unsigned int clientBytesPerSecond = BandwidthBudget::DEFAULT_MAXIMUM_BYTES_PER_SECOND;
+	unsigned int simulationStepsPerSecond = GameServer::DEFAULT_SIMULATION_STEPS_PER_SECOND;
+	unsigned int snapshotsPerSecond = GameServer::DEFAULT_SNAPSHOTS_PER_SECOND;
 	
-	int commandLineResult = HandleCommandLine( argc, argv, portNumber );
+	int commandLineResult = HandleCommandLine( argc, argv, portNumber, networkEngine, numberOfWorkers, clientBytesPerSecond, simulationStepsPerSecond, snapshotsPerSecond );
 	if( commandLineResult != 0 )
 		return -1;
 
-	GameServer server;
-	printf( "Initializing game server on UDP port %s...\n\n", portNumber.c_str() );
-	server.Initialize( portNumber );
+	if( numberOfWorkers == 1 )
+	{
+		GameServer server;
+		printf( "Initializing game server on UDP port %s...\n\n", portNumber.c_str() );
+		server.Initialize( portNumber, networkEngine );
+		server.SetMaximumClientBytesPerSecond( clientBytesPerSecond );
+		server.SetTickRates( simulationStepsPerSecond, snapshotsPerSecond );
+
+		RunServerLoop( &server );
+		return 0;
+	}
 
-	static double timeSpentLastFrameSeconds = 0.0;
-	while( true )
+	//Each worker owns every Nth room and runs its own socket on the shared port
+	printf( "Initializing game server on UDP port %s with %i worker threads...\n\n", portNumber.c_str(), numberOfWorkers );
+	ServerWorkerRouter router( numberOfWorkers );
+	std::vector< GameServer* > workers;
+	for( unsigned int i = 0; i < numberOfWorkers; ++i )
 	{
-		server.Update( static_cast< float >( timeSpentLastFrameSeconds ) );
+		workers.push_back( new GameServer() );
+		workers.back()->Initialize( portNumber, networkEngine, &router, i );
+		workers.back()->SetMaximumClientBytesPerSecond( clientBytesPerSecond );
+		workers.back()->SetTickRates( simulationStepsPerSecond, snapshotsPerSecond );
+	}
 
-		timeSpentLastFrameSeconds = WaitUntilNextFrameThenGiveFrameTime();
+	std::vector< std::thread > workerThreads;
+	for( unsigned int i = 0; i < numberOfWorkers; ++i )
+	{
+		workerThreads.push_back( std::thread( RunServerLoop, workers[ i ] ) );
+	}
+	for( unsigned int i = 0; i < numberOfWorkers; ++i )
+	{
+		workerThreads[ i ].join();
 	}
 
 	return 0;